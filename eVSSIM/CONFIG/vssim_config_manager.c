@@ -130,7 +130,7 @@ void INIT_SSD_CONFIG(void)
     if (NULL == inverse_mappings_manager)
         RERR(, "inverse_mappings_manager allocation failed!\n");
 
-    mapping_table = (uint64_t**)calloc(sizeof(uint64_t*) * device_count, 1);
+    mapping_table = (void**)calloc(sizeof(void*) * device_count, 1);
     if (NULL == mapping_table)
         RERR(, "mapping_table allocation failed!\n");
 
@@ -150,13 +150,57 @@ void INIT_SSD_CONFIG(void)
     if (NULL == gc_threads)
         RERR(, "gc_threads allocation failed!\n");
 
+    mapping_mmaps = calloc(device_count, sizeof(*mapping_mmaps));
+    if (NULL == mapping_mmaps)
+        RERR(, "mapping_mmaps allocation failed!\n");
+
+    mapping_caches = calloc(device_count, sizeof(*mapping_caches));
+    if (NULL == mapping_caches)
+        RERR(, "mapping_caches allocation failed!\n");
+
+    mapping_extents = calloc(device_count, sizeof(*mapping_extents));
+    if (NULL == mapping_extents)
+        RERR(, "mapping_extents allocation failed!\n");
+
+    write_heats = calloc(device_count, sizeof(*write_heats));
+    if (NULL == write_heats)
+        RERR(, "write_heats allocation failed!\n");
+
+    wa_counters = calloc(device_count, sizeof(*wa_counters));
+    if (NULL == wa_counters)
+        RERR(, "wa_counters allocation failed!\n");
+
+    perf_checkers = calloc(device_count, sizeof(*perf_checkers));
+    if (NULL == perf_checkers)
+        RERR(, "perf_checkers allocation failed!\n");
+
+    g_device_locks = calloc(device_count, sizeof(*g_device_locks));
+    if (NULL == g_device_locks)
+        RERR(, "g_device_locks allocation failed!\n");
+
+    for (i = 0; i < device_count; i++)
+    {
+        pthread_rwlock_init(&g_device_locks[i], NULL);
+        pthread_mutex_init(&perf_checkers[i].lock, NULL);
+        pthread_mutex_init(&ssds_manager[i].timing_lock, NULL);
+    }
+
     pthread_mutex_unlock(&g_lock);
 }
 
 void TERM_SSD_CONFIG(void)
 {
+    uint32_t i;
+
     pthread_mutex_lock(&g_lock);
 
+    for (i = 0; i < device_count; i++)
+    {
+        pthread_rwlock_destroy(&g_device_locks[i]);
+        pthread_mutex_destroy(&perf_checkers[i].lock);
+        pthread_mutex_destroy(&ssds_manager[i].timing_lock);
+    }
+
     free(inverse_mappings_manager);
     inverse_mappings_manager = NULL;
 
@@ -175,6 +219,27 @@ void TERM_SSD_CONFIG(void)
     free(gc_threads);
     gc_threads = NULL;
 
+    free(mapping_mmaps);
+    mapping_mmaps = NULL;
+
+    free(mapping_caches);
+    mapping_caches = NULL;
+
+    free(mapping_extents);
+    mapping_extents = NULL;
+
+    free(write_heats);
+    write_heats = NULL;
+
+    free(wa_counters);
+    wa_counters = NULL;
+
+    free(perf_checkers);
+    perf_checkers = NULL;
+
+    free(g_device_locks);
+    g_device_locks = NULL;
+
     free(devices);
     devices = NULL;
 
@@ -188,6 +253,9 @@ bool parse_config_line(const char* key, FILE* file, ssd_config_t* device) {
     if (strcmp(key, "FILE_NAME") == 0) {
         return fscanf(file, "%s", device->file_name) == 1;
     }
+    if (strcmp(key, "IMAGE_MMAP") == 0) {
+        return fscanf(file, "%d", &device->image_mmap) == 1;
+    }
     if (strcmp(key, "PAGE_SIZE") == 0) {
         return fscanf(file, "%" SCNu32, &device->page_size) == 1;
     }
@@ -233,6 +301,12 @@ bool parse_config_line(const char* key, FILE* file, ssd_config_t* device) {
     if (strcmp(key, "IO_PARALLELISM") == 0) {
         return fscanf(file, "%d", &device->io_parallelism) == 1;
     }
+    if (strcmp(key, "COPYBACK_CROSS_PLANE") == 0) {
+        return fscanf(file, "%d", &device->copyback_cross_plane) == 1;
+    }
+    if (strcmp(key, "COPYBACK_MULTI_PLANE_PAGE_NB") == 0) {
+        return fscanf(file, "%d", &device->copyback_multi_plane_page_nb) == 1;
+    }
     if (strcmp(key, "CHANNEL_NB") == 0) {
         return fscanf(file, "%" SCNu32, &device->channel_nb) == 1;
     }
@@ -251,6 +325,56 @@ bool parse_config_line(const char* key, FILE* file, ssd_config_t* device) {
     if (strcmp(key, "GC_HI_THR") == 0) {
         return fscanf(file, "%d", &device->gc_hi_thr) == 1;
     }
+#ifdef PAGE_MAP
+    if (strcmp(key, "MAPPING_TABLE_MMAP") == 0) {
+        return fscanf(file, "%d", &device->mapping_table_mmap) == 1;
+    }
+    if (strcmp(key, "MAPPING_FLUSH_INTERVAL") == 0) {
+        return fscanf(file, "%d", &device->mapping_flush_interval_sec) == 1;
+    }
+    if (strcmp(key, "MAPPING_CACHE_SIZE") == 0) {
+        return fscanf(file, "%" SCNu64, &device->mapping_cache_entry_nb) == 1;
+    }
+    if (strcmp(key, "MAPPING_EXTENTS") == 0) {
+        return fscanf(file, "%d", &device->mapping_extents) == 1;
+    }
+    if (strcmp(key, "MAPPING_WIDE_ENTRIES") == 0) {
+        return fscanf(file, "%d", &device->mapping_wide_entries) == 1;
+    }
+    if (strcmp(key, "FTL_SNAPSHOT") == 0) {
+        return fscanf(file, "%d", &device->ftl_snapshot) == 1;
+    }
+    if (strcmp(key, "GC_INCREMENTAL_PAGE_NB") == 0) {
+        return fscanf(file, "%d", &device->gc_incremental_page_nb) == 1;
+    }
+    if (strcmp(key, "GC_IDLE_USEC") == 0) {
+        return fscanf(file, "%d", &device->gc_idle_usec) == 1;
+    }
+    if (strcmp(key, "GC_IDLE_BUDGET_USEC") == 0) {
+        return fscanf(file, "%d", &device->gc_idle_budget_usec) == 1;
+    }
+    if (strcmp(key, "GC_PARALLEL_VICTIM_NB") == 0) {
+        return fscanf(file, "%d", &device->gc_parallel_victim_nb) == 1;
+    }
+    if (strcmp(key, "GC_VICTIM_POLICY") == 0) {
+        return fscanf(file, "%d", &device->gc_victim_policy) == 1;
+    }
+    if (strcmp(key, "GC_VICTIM_CANDIDATE_NB") == 0) {
+        return fscanf(file, "%d", &device->gc_victim_candidate_nb) == 1;
+    }
+    if (strcmp(key, "WRITE_STREAM_SEPARATION") == 0) {
+        return fscanf(file, "%d", &device->write_stream_separation) == 1;
+    }
+    if (strcmp(key, "WRITE_STREAM_HOT_WRITE_NB") == 0) {
+        return fscanf(file, "%d", &device->write_stream_hot_write_nb) == 1;
+    }
+    if (strcmp(key, "WEAR_LEVELING_DYNAMIC") == 0) {
+        return fscanf(file, "%d", &device->wear_leveling_dynamic) == 1;
+    }
+    if (strcmp(key, "WEAR_LEVELING_THRESHOLD") == 0) {
+        return fscanf(file, "%d", &device->wear_leveling_threshold) == 1;
+    }
+#endif
 
 #if defined FTL_MAP_CACHE
     if (strcmp(key, "CACHE_IDX_SIZE") == 0) {
@@ -324,6 +448,17 @@ ssd_config_t* GET_DEVICES(void){
     return devices;
 }
 
+static void init_geometry_divisor(geometry_divisor_t* d, uint64_t divisor) {
+    memset(d, 0, sizeof(*d));
+    d->divisor = divisor;
+    if (divisor != 0 && (divisor & (divisor - 1)) == 0) {
+        d->pow2 = true;
+        d->shift = __builtin_ctzll(divisor);
+    } else if (divisor != 0 && divisor <= UINT32_MAX) {
+        d->reciprocal = UINT64_MAX / divisor + 1;
+    }
+}
+
 void calculate_derived_values(ssd_config_t* device) {
     // Exception Handler
     if (device->flash_nb < device->channel_nb)
@@ -338,6 +473,17 @@ void calculate_derived_values(ssd_config_t* device) {
     device->block_mapping_entry_nb = (uint64_t)device->block_nb * device->flash_nb;
     device->pages_in_ssd = device->page_nb * device->block_nb * device->flash_nb;
 
+    init_geometry_divisor(&device->geometry.page_nb, device->page_nb);
+    init_geometry_divisor(&device->geometry.block_nb, device->block_nb);
+    init_geometry_divisor(&device->geometry.planes_per_flash, device->planes_per_flash);
+    init_geometry_divisor(&device->geometry.channel_nb, device->channel_nb);
+
+    // a multi-plane command programs one page per plane
+    if (device->copyback_multi_plane_page_nb < 1)
+        device->copyback_multi_plane_page_nb = 1;
+    if ((uint32_t)device->copyback_multi_plane_page_nb > device->planes_per_flash)
+        device->copyback_multi_plane_page_nb = device->planes_per_flash;
+
     // reserve one block for GC
     device->sectors_in_ssd = device->sectors_per_page * (device->pages_in_ssd - device->page_nb);
 
@@ -355,6 +501,40 @@ void calculate_derived_values(ssd_config_t* device) {
 
     double gc_l2_threshold = 0.1;
     device->gc_l2_threshold_block_nb = (int)((1-gc_l2_threshold) * (double)device->block_mapping_entry_nb);
+
+    // at most one victim per flash chip
+    if (device->gc_parallel_victim_nb < 1)
+        device->gc_parallel_victim_nb = 1;
+    if ((uint32_t)device->gc_parallel_victim_nb > device->flash_nb)
+        device->gc_parallel_victim_nb = device->flash_nb;
+
+    if (device->gc_victim_policy < GC_VICTIM_GREEDY || device->gc_victim_policy >= GC_VICTIM_POLICY_NB) {
+        PERR("Unknown GC_VICTIM_POLICY %d, using greedy\n", device->gc_victim_policy);
+        device->gc_victim_policy = GC_VICTIM_GREEDY;
+    }
+    if (device->gc_victim_candidate_nb <= 0)
+        device->gc_victim_candidate_nb = 8;
+    if ((uint64_t)device->gc_victim_candidate_nb > device->block_mapping_entry_nb)
+        device->gc_victim_candidate_nb = device->block_mapping_entry_nb;
+    if (device->gc_idle_usec < 0)
+        device->gc_idle_usec = 0;
+    if (device->gc_idle_budget_usec < 0)
+        device->gc_idle_budget_usec = 0;
+    if (device->wear_leveling_threshold < 0)
+        device->wear_leveling_threshold = 0;
+    if (device->write_stream_hot_write_nb <= 0)
+        device->write_stream_hot_write_nb = 2;
+    if (device->write_stream_hot_write_nb > UINT8_MAX)
+        device->write_stream_hot_write_nb = UINT8_MAX;
+
+    if (device->mapping_flush_interval_sec <= 0)
+        device->mapping_flush_interval_sec = 5;
+
+    // MAPPING_COMPACT_INIT_VAL must stay free to mark unmapped entries
+    if (!device->mapping_wide_entries && device->page_mapping_entry_nb < MAPPING_COMPACT_INIT_VAL)
+        device->mapping_entry_size = sizeof(uint32_t);
+    else
+        device->mapping_entry_size = sizeof(uint64_t);
 #endif // PAGE_MAP
 
     device->gc_low_thr_page_nb = device->page_nb * (100 - device->gc_low_thr) * device->block_mapping_entry_nb / 100;
@@ -6,6 +6,52 @@
 #ifndef _CONFIG_MANAGER_H_
 #define _CONFIG_MANAGER_H_
 
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Divisor of the flash geometry with a precomputed fast path: a shift for
+ * powers of two, otherwise a 64 bit reciprocal that is exact for dividends
+ * that fit in 32 bits (Lemire's direct division). Larger dividends fall back
+ * to a plain division.
+ */
+typedef struct geometry_divisor {
+	uint64_t divisor;
+	uint64_t reciprocal;
+	uint32_t shift;
+	bool pow2;
+} geometry_divisor_t;
+
+typedef struct ssd_geometry {
+	geometry_divisor_t page_nb;
+	geometry_divisor_t block_nb;
+	geometry_divisor_t planes_per_flash;
+	geometry_divisor_t channel_nb;
+} ssd_geometry_t;
+
+static inline uint64_t GEOMETRY_DIV(const geometry_divisor_t* d, uint64_t n)
+{
+	if (d->pow2)
+		return n >> d->shift;
+	if (n <= UINT32_MAX && d->reciprocal != 0)
+		return (uint64_t)(((unsigned __int128)d->reciprocal * n) >> 64);
+	return n / d->divisor;
+}
+
+static inline uint64_t GEOMETRY_DIVMOD(const geometry_divisor_t* d, uint64_t n, uint64_t* rem)
+{
+	uint64_t quotient = GEOMETRY_DIV(d, n);
+	*rem = n - quotient * d->divisor;
+	return quotient;
+}
+
+static inline uint64_t GEOMETRY_MOD(const geometry_divisor_t* d, uint64_t n)
+{
+	if (d->pow2)
+		return n & (d->divisor - 1);
+	return n - GEOMETRY_DIV(d, n) * d->divisor;
+}
+
 #include "common.h"
 #include <limits.h>
 
@@ -43,8 +89,28 @@ typedef struct ssd_config {
 
 	uint64_t empty_table_entry_nb;
 	uint64_t victim_table_entry_nb;
+
+	// Back the mapping table by an mmap'ed file instead of a heap copy
+	int mapping_table_mmap;
+	int mapping_flush_interval_sec;
+
+	// Cached mapping table (CMT) size in entries, 0 keeps the whole table resident
+	uint64_t mapping_cache_entry_nb;
+
+	// Keep the mapping as extents of sequential runs instead of a flat table
+	int mapping_extents;
+
+	// Size of a mapping table entry, 32 bit entries are used when every ppn fits
+	int mapping_wide_entries;
+	uint32_t mapping_entry_size;
+
+	// Save the FTL state on shutdown and resume from it on the next start
+	int ftl_snapshot;
 #endif
 
+	// Divisors used to decode physical page numbers
+	ssd_geometry_t geometry;
+
 	// NAND Flash Delay
 	int reg_write_delay;
 	int cell_program_delay;
@@ -57,6 +123,14 @@ typedef struct ssd_config {
 	int dsm_trim_enable;
 	int io_parallelism;
 
+	// Access the image file through a shared memory mapping instead of pread and pwrite
+	int image_mmap;
+
+	// Copyback to another plane of the same flash through the controller buffer, instead of a read and a
+	// write over the host path, and valid pages of a GC victim moved by one multi-plane copyback command
+	int copyback_cross_plane;
+	int copyback_multi_plane_page_nb;
+
 	// Garbage Collection
 #ifdef PAGE_MAP
 	double gc_threshold;
@@ -64,6 +138,32 @@ typedef struct ssd_config {
 	int gc_threshold_block_nb_each;
 	int gc_victim_nb;
 	int gc_l2_threshold_block_nb;
+
+	// Valid pages foreground GC may copy per host write, 0 collects whole blocks when the device is full
+	int gc_incremental_page_nb;
+
+	// Simulated time the host must leave the device alone before background operations run in the
+	// gap (0 keeps the wall clock cadence of the GC thread), and how much of every gap they may use
+	// (0 for all of it)
+	int gc_idle_usec;
+	int gc_idle_budget_usec;
+
+	// Victims on distinct flash chips collected together by a whole block collection
+	int gc_parallel_victim_nb;
+
+	// Victim selection policy (GC_VICTIM_*) and the candidates it samples, or its window
+	int gc_victim_policy;
+	int gc_victim_candidate_nb;
+
+	// Host writes, split by update frequency, and GC relocations each write to their own block of
+	// a plane. A page is hot once written hot_write_nb times lately.
+	int write_stream_separation;
+	int write_stream_hot_write_nb;
+
+	// Wear leveling: allocate the least erased free block of a plane first, and move cold data
+	// off a block whose erase count lags the most erased block by more than the threshold (0 = off)
+	int wear_leveling_dynamic;
+	int wear_leveling_threshold;
 #endif
 
 	int gc_low_thr;
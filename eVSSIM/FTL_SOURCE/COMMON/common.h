@@ -27,12 +27,21 @@
 #define DEL_QEMU_OVERHEAD
 
 #define MAPPING_TABLE_INIT_VAL UINT64_MAX
+/* Unmapped entry of a mapping table stored in 32 bit entries */
+#define MAPPING_COMPACT_INIT_VAL UINT32_MAX
 
 #define MAX_NUMBER_OF_NAMESPACES 32
 
 // INVALID_DEVICE_INDEX is 0xFF because the type of the device index is uint8_t
 #define INVALID_DEVICE_INDEX 0xFF
 
+/* Portable thread-local keyword */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+  #define TLS _Thread_local
+#else
+  #define TLS __thread
+#endif
+
 #include "vssim_config_manager.h"
 #include "ftl.h"
 #include "ftl_inverse_mapping_manager.h"
@@ -72,6 +81,13 @@
 #define VICTIM_INCHIP_GC	45
 #define VICTIM_NOPARAL_GC	46
 
+/* GC Victim Selection Policy */
+#define GC_VICTIM_GREEDY	0	/* fewest valid pages */
+#define GC_VICTIM_COST_BENEFIT	1	/* age * (1 - u) / (1 + u) of the last invalidation */
+#define GC_VICTIM_D_CHOICES	2	/* greedy among d random victims */
+#define GC_VICTIM_WINDOWED	3	/* greedy among the w oldest victims */
+#define GC_VICTIM_POLICY_NB	4
+
 /* Page Type */
 #define PAGE_VALID		'V'
 #define PAGE_INVALID		'I'
@@ -100,6 +116,8 @@
 #define GC_WRITE		805
 #define COPYBACK		820
 #define WRITE_COMMIT	822
+#define MAPPING_READ	823
+#define MAPPING_WRITE	824
 #define GC_READ_BACKGROUND		806
 #define GC_WRITE_BACKGROUND		807
 #define COPYBACK_BACKGROUND		808
@@ -5,18 +5,95 @@
 #include <string.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <unistd.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SSD_FILE_X86
+#endif
 
 #define BUFFER_SIZE (4096)
 
-static size_t ssd_get_capacity(const char *path);
+// Program compatibility kernels: a write only switches 1 to 0 when no bit set in `new_data` is clear in `existing`.
+// They stop at the first incompatible word.
+typedef bool (*program_compatible_kernel)(const unsigned char *existing, const unsigned char *new_data, size_t length);
 
-static size_t ssd_get_capacity(const char *path) {
-    if (path == NULL) return 0;
-    struct stat st;
-    if (stat(path, &st) != 0) return 0;
-    return st.st_size;
+static bool program_compatible_scalar(const unsigned char *existing, const unsigned char *new_data, size_t length) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t existing_word, new_word;
+        memcpy(&existing_word, existing + i, sizeof(existing_word));
+        memcpy(&new_word, new_data + i, sizeof(new_word));
+        if (new_word & ~existing_word) return false;
+    }
+    for (; i < length; i++) {
+        if (new_data[i] & ~existing[i]) return false;
+    }
+    return true;
+}
+
+#ifdef SSD_FILE_X86
+__attribute__((target("sse2")))
+static bool program_compatible_sse2(const unsigned char *existing, const unsigned char *new_data, size_t length) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + sizeof(__m128i) <= length; i += sizeof(__m128i)) {
+        __m128i existing_vec = _mm_loadu_si128((const __m128i *)(existing + i));
+        __m128i new_vec = _mm_loadu_si128((const __m128i *)(new_data + i));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_andnot_si128(existing_vec, new_vec), zero)) != 0xFFFF) return false;
+    }
+    return program_compatible_scalar(existing + i, new_data + i, length - i);
+}
+
+__attribute__((target("avx2")))
+static bool program_compatible_avx2(const unsigned char *existing, const unsigned char *new_data, size_t length) {
+    size_t i = 0;
+    for (; i + sizeof(__m256i) <= length; i += sizeof(__m256i)) {
+        __m256i existing_vec = _mm256_loadu_si256((const __m256i *)(existing + i));
+        __m256i new_vec = _mm256_loadu_si256((const __m256i *)(new_data + i));
+        // testc is set when (~existing & new) == 0
+        if (!_mm256_testc_si256(existing_vec, new_vec)) return false;
+    }
+    return program_compatible_scalar(existing + i, new_data + i, length - i);
+}
+
+__attribute__((target("avx512f")))
+static bool program_compatible_avx512(const unsigned char *existing, const unsigned char *new_data, size_t length) {
+    size_t i = 0;
+    for (; i + sizeof(__m512i) <= length; i += sizeof(__m512i)) {
+        __m512i existing_vec = _mm512_loadu_si512((const void *)(existing + i));
+        __m512i new_vec = _mm512_loadu_si512((const void *)(new_data + i));
+        __m512i flipped = _mm512_andnot_si512(existing_vec, new_vec);
+        if (_mm512_test_epi64_mask(flipped, flipped)) return false;
+    }
+    return program_compatible_scalar(existing + i, new_data + i, length - i);
+}
+#endif
+
+static program_compatible_kernel program_compatible_impl = program_compatible_scalar;
+static pthread_once_t program_compatible_once = PTHREAD_ONCE_INIT;
+
+// Picks the widest kernel the cpu supports
+static void program_compatible_dispatch(void) {
+#ifdef SSD_FILE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        program_compatible_impl = program_compatible_avx512;
+    } else if (__builtin_cpu_supports("avx2")) {
+        program_compatible_impl = program_compatible_avx2;
+    } else if (__builtin_cpu_supports("sse2")) {
+        program_compatible_impl = program_compatible_sse2;
+    }
+#endif
+}
+
+static bool program_compatible(const unsigned char *existing, const unsigned char *new_data, size_t length) {
+    pthread_once(&program_compatible_once, program_compatible_dispatch);
+    return program_compatible_impl(existing, new_data, length);
 }
 
 ssd_file_ops_ret_val ssd_create(const char *path, size_t capacity_size) {
@@ -44,93 +121,152 @@ ssd_file_ops_ret_val ssd_create(const char *path, size_t capacity_size) {
     return SSD_FILE_OPS_SUCCESS;
 }
 
-bool is_program_compatible(const char *path, size_t offset, size_t length, const unsigned char *buff) {
-    if (path == NULL || buff == NULL) return SSD_FILE_OPS_ERROR;
-    const unsigned char* new_data = (const unsigned char*)buff;
-    unsigned char existing_data[BUFFER_SIZE];
+ssd_file_ops_ret_val ssd_open(ssd_file *file, const char *path, ssd_file_mode mode) {
+    if (file == NULL || path == NULL) return SSD_FILE_OPS_ERROR;
+    memset(file, 0, sizeof(*file));
 
-    size_t i = 0;
+    int fd = open(path, O_RDWR);
+    if (fd < 0) return SSD_FILE_OPS_ERROR;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return SSD_FILE_OPS_ERROR;
+    }
+
+    if (mode == SSD_FILE_MMAP) {
+        void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return SSD_FILE_OPS_ERROR;
+        }
+        file->map = map;
+    }
+
+    file->fd = fd;
+    file->capacity = st.st_size;
+    file->mode = mode;
+    file->is_open = true;
+    return SSD_FILE_OPS_SUCCESS;
+}
+
+void ssd_close(ssd_file *file) {
+    if (file == NULL || !file->is_open) return;
+    if (file->map != NULL) munmap(file->map, file->capacity);
+    close(file->fd);
+    memset(file, 0, sizeof(*file));
+}
+
+static bool ssd_file_in_range(const ssd_file *file, size_t offset, size_t length) {
+    return file != NULL && file->is_open && offset + length <= file->capacity;
+}
+
+bool ssd_file_is_program_compatible(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff) {
+    if (buff == NULL || !ssd_file_in_range(file, offset, length)) return false;
 
+    // a mapped file is checked in place
+    if (file->mode == SSD_FILE_MMAP) {
+        return program_compatible(file->map + offset, buff, length);
+    }
+
+    unsigned char existing_data[BUFFER_SIZE];
     size_t processed = 0;
     while (processed < length) {
         size_t to_check = (length - processed < BUFFER_SIZE) ? (length - processed) : BUFFER_SIZE;
 
-        if (ssd_read(path, offset + processed, to_check, existing_data) != SSD_FILE_OPS_SUCCESS) return false;
+        if (ssd_file_read(file, offset + processed, to_check, existing_data) != SSD_FILE_OPS_SUCCESS) return false;
+        if (!program_compatible(existing_data, buff + processed, to_check)) return false;
 
-        for (i = 0; i < to_check; i++) {
-            if ((existing_data[i] & new_data[processed + i]) != new_data[processed + i]) {
-                return false;
-            }
-        }
         processed += to_check;
     }
     return true;
-
 }
 
-ssd_file_ops_ret_val ssd_write(const char *path, size_t offset, size_t length, const unsigned char *buff) {
-    if (path == NULL || buff == NULL) return SSD_FILE_OPS_ERROR;
-    size_t capacity = ssd_get_capacity(path);
-    if (capacity == 0) return SSD_FILE_OPS_ERROR;
-
-    if (offset + length > capacity) return SSD_FILE_OPS_ERROR;
+bool ssd_file_program_in_place(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff) {
+    if (!ssd_file_is_program_compatible(file, offset, length, buff)) return false;
+    return ssd_file_write(file, offset, length, buff) == SSD_FILE_OPS_SUCCESS;
+}
 
-    int fd = open(path, O_WRONLY);
-    if (fd < 0) return SSD_FILE_OPS_ERROR;
+ssd_file_ops_ret_val ssd_file_write(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff) {
+    if (buff == NULL || !ssd_file_in_range(file, offset, length)) return SSD_FILE_OPS_ERROR;
 
-    ssize_t written = pwrite(fd, buff, length, offset);
-    close(fd);
+    if (file->mode == SSD_FILE_MMAP) {
+        memcpy(file->map + offset, buff, length);
+        return SSD_FILE_OPS_SUCCESS;
+    }
 
+    ssize_t written = pwrite(file->fd, buff, length, offset);
     return (written == (ssize_t)length) ? SSD_FILE_OPS_SUCCESS : SSD_FILE_OPS_ERROR;
 }
 
-ssd_file_ops_ret_val ssd_read(const char *path, size_t offset, size_t length, unsigned char *buff) {
-    if (path == NULL || buff == NULL) return SSD_FILE_OPS_ERROR;
-    size_t capacity = ssd_get_capacity(path);
-    if (capacity == 0) return SSD_FILE_OPS_ERROR;
-
-    if (offset + length > capacity) return SSD_FILE_OPS_ERROR;
-
-
-    int fd = open(path, O_RDONLY);
-    if (fd < 0) return SSD_FILE_OPS_ERROR;
+ssd_file_ops_ret_val ssd_file_read(const ssd_file *file, size_t offset, size_t length, unsigned char *buff) {
+    if (buff == NULL || !ssd_file_in_range(file, offset, length)) return SSD_FILE_OPS_ERROR;
 
-    ssize_t read_bytes = pread(fd, buff, length, offset);
-    close(fd);
+    if (file->mode == SSD_FILE_MMAP) {
+        memcpy(buff, file->map + offset, length);
+        return SSD_FILE_OPS_SUCCESS;
+    }
 
+    ssize_t read_bytes = pread(file->fd, buff, length, offset);
     return (read_bytes == (ssize_t)length) ? SSD_FILE_OPS_SUCCESS : SSD_FILE_OPS_ERROR;
 }
 
-ssd_file_ops_ret_val ssd_erase(const char *path, size_t offset, size_t length) {
-    if (path == NULL) return SSD_FILE_OPS_ERROR;
-    size_t capacity = ssd_get_capacity(path);
-    if (capacity == 0) return SSD_FILE_OPS_ERROR;
-
-    if (offset + length > capacity) return SSD_FILE_OPS_ERROR;
-
-    int fd = open(path, O_WRONLY);
-    if (fd < 0) return SSD_FILE_OPS_ERROR;
+ssd_file_ops_ret_val ssd_file_erase(const ssd_file *file, size_t offset, size_t length) {
+    if (!ssd_file_in_range(file, offset, length)) return SSD_FILE_OPS_ERROR;
 
+    // Fill with 1s like a real ssd
+    if (file->mode == SSD_FILE_MMAP) {
+        memset(file->map + offset, 0xFF, length);
+        return SSD_FILE_OPS_SUCCESS;
+    }
 
     unsigned char buffer[BUFFER_SIZE];
-
-    // Fill with 1s like a real ssd
     memset(buffer, 0xFF, sizeof(buffer));
 
     size_t written = 0;
     while (written < length) {
         size_t to_write = (length - written < sizeof(buffer)) ? (length - written) : sizeof(buffer);
-        ssize_t w = pwrite(fd, buffer, to_write, offset);
+        ssize_t w = pwrite(file->fd, buffer, to_write, offset);
         if (w <= 0) {
-            close(fd);
             return SSD_FILE_OPS_ERROR;
         }
         written += w;
         offset += w;
     }
 
-    
-    close(fd);
     return SSD_FILE_OPS_SUCCESS;
 }
 
+// The path based functions open the file for a single operation
+
+bool is_program_compatible(const char *path, size_t offset, size_t length, const unsigned char *buff) {
+    ssd_file file;
+    if (buff == NULL || ssd_open(&file, path, SSD_FILE_PREAD) != SSD_FILE_OPS_SUCCESS) return false;
+    bool ret = ssd_file_is_program_compatible(&file, offset, length, buff);
+    ssd_close(&file);
+    return ret;
+}
+
+ssd_file_ops_ret_val ssd_write(const char *path, size_t offset, size_t length, const unsigned char *buff) {
+    ssd_file file;
+    if (buff == NULL || ssd_open(&file, path, SSD_FILE_PREAD) != SSD_FILE_OPS_SUCCESS) return SSD_FILE_OPS_ERROR;
+    ssd_file_ops_ret_val ret = ssd_file_write(&file, offset, length, buff);
+    ssd_close(&file);
+    return ret;
+}
+
+ssd_file_ops_ret_val ssd_read(const char *path, size_t offset, size_t length, unsigned char *buff) {
+    ssd_file file;
+    if (buff == NULL || ssd_open(&file, path, SSD_FILE_PREAD) != SSD_FILE_OPS_SUCCESS) return SSD_FILE_OPS_ERROR;
+    ssd_file_ops_ret_val ret = ssd_file_read(&file, offset, length, buff);
+    ssd_close(&file);
+    return ret;
+}
+
+ssd_file_ops_ret_val ssd_erase(const char *path, size_t offset, size_t length) {
+    ssd_file file;
+    if (ssd_open(&file, path, SSD_FILE_PREAD) != SSD_FILE_OPS_SUCCESS) return SSD_FILE_OPS_ERROR;
+    ssd_file_ops_ret_val ret = ssd_file_erase(&file, offset, length);
+    ssd_close(&file);
+    return ret;
+}
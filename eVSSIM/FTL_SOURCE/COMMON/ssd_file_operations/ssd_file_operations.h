@@ -8,6 +8,19 @@
 
 typedef enum {SSD_FILE_OPS_ERROR, SSD_FILE_OPS_SUCCESS} ssd_file_ops_ret_val;
 
+// How an open SSD file is accessed.
+typedef enum {SSD_FILE_PREAD, SSD_FILE_MMAP} ssd_file_mode;
+
+// A SSD file kept open between operations, so they cost a single syscall (or none when mapped).
+// A zeroed handle is closed.
+typedef struct {
+    bool is_open;
+    int fd;
+    size_t capacity;
+    ssd_file_mode mode;
+    unsigned char *map;     // the whole file, in SSD_FILE_MMAP mode
+} ssd_file;
+
 // Creates a file that simulated a SSD with a fiven size.
 // The function fills the SSD file with 1s like a real SSD that all its memory is erased.
 ssd_file_ops_ret_val ssd_create(const char *path, size_t capacity_size);
@@ -24,4 +37,20 @@ ssd_file_ops_ret_val ssd_read(const char *path, size_t offset, size_t length, un
 // Erases SSD file content from the given `offset` for `length` bytes.
 ssd_file_ops_ret_val ssd_erase(const char *path, size_t offset, size_t length);
 
+// Opens an existing SSD file, its size is the capacity of the SSD.
+ssd_file_ops_ret_val ssd_open(ssd_file *file, const char *path, ssd_file_mode mode);
+
+// Closes an open SSD file, does nothing on a closed one.
+void ssd_close(ssd_file *file);
+
+// The functions above, on an open SSD file.
+bool ssd_file_is_program_compatible(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff);
+ssd_file_ops_ret_val ssd_file_write(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff);
+ssd_file_ops_ret_val ssd_file_read(const ssd_file *file, size_t offset, size_t length, unsigned char *buff);
+ssd_file_ops_ret_val ssd_file_erase(const ssd_file *file, size_t offset, size_t length);
+
+// Writes `buff` over the current content only if it is program compatible, without erasing.
+// Returns whether it was written, nothing is written otherwise.
+bool ssd_file_program_in_place(const ssd_file *file, size_t offset, size_t length, const unsigned char *buff);
+
 #endif
\ No newline at end of file
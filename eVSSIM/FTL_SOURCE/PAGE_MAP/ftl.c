@@ -15,11 +15,11 @@
 
 int* g_init_ftl = NULL;
 uint8_t g_device_index = 0;
-extern double ssd_util;
 int gatherStats = 0;
 // Hold statistics information
 uint32_t** mapping_stats_table;
 pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_rwlock_t* g_device_locks = NULL;
 
 static void _verify_onfi_device(uint8_t device_index)
 {
@@ -38,7 +38,7 @@ static void _verify_onfi_device(uint8_t device_index)
 
 void FTL_INIT(uint8_t device_index)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
 	if (g_init_ftl[device_index] == 0) {
 		PINFO("start\n");
 
@@ -49,8 +49,10 @@ void FTL_INIT(uint8_t device_index)
 		INIT_VALID_ARRAY(device_index);
 		INIT_EMPTY_BLOCK_LIST(device_index);
 		INIT_VICTIM_BLOCK_LIST(device_index);
+		if (devices[device_index].ftl_snapshot)
+			LOAD_FTL_SNAPSHOT(device_index);
 
-		INIT_PERF_CHECKER();
+		INIT_PERF_CHECKER(device_index);
         INIT_GC_MANAGER(device_index);
 
 		// Initialize The Statistics gathering component.
@@ -64,14 +66,19 @@ void FTL_INIT(uint8_t device_index)
 
 		PINFO("complete\n");
 	}
-	pthread_mutex_unlock(&g_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 }
 
 void FTL_TERM(uint8_t device_index)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
 	PINFO("start\n");
 
+	if (devices[device_index].ftl_snapshot) {
+		RELEASE_GC_VICTIM(device_index);
+		SAVE_FTL_SNAPSHOT(device_index);
+	}
+
 	TERM_MAPPING_TABLE(device_index);
 
 	TERM_INVERSE_PAGE_MAPPING(device_index);
@@ -80,7 +87,7 @@ void FTL_TERM(uint8_t device_index)
 	TERM_EMPTY_BLOCK_LIST(device_index);
 	TERM_VICTIM_BLOCK_LIST(device_index);
 
-	TERM_PERF_CHECKER();
+	TERM_PERF_CHECKER(device_index);
 	TERM_GC_MANAGER(device_index);
 	FTL_TERM_STATS();
 
@@ -89,7 +96,7 @@ void FTL_TERM(uint8_t device_index)
 	g_init_ftl[device_index] = 0;
 
 	PINFO("complete\n");
-	pthread_mutex_unlock(&g_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 }
 
 void FTL_INIT_STATS(void)
@@ -16,9 +16,15 @@ extern uint32_t** mapping_stats_table;
 extern uint8_t g_device_index;
 extern int* g_init_ftl;
 
-// FTL global lock. Does not allow the GC thread to do work while the main thread is inside FTL code.
+// Global configuration lock. Guards the device tables while INIT_SSD_CONFIG / TERM_SSD_CONFIG (re)allocate them.
 extern pthread_mutex_t g_lock;
 
+// Per-device FTL locks. Writes, GC and the mapping flush take a device's lock exclusively, so its GC
+// and flush threads never work while another thread is inside that device's FTL code. Sector reads
+// take it shared and run alongside each other; I/O to different devices runs in parallel.
+extern pthread_rwlock_t* g_device_locks;
+#define DEVICE_LOCK(device_index) (&g_device_locks[(device_index)])
+
 void FTL_INIT(uint8_t device_index);
 void FTL_TERM(uint8_t device_index);
 
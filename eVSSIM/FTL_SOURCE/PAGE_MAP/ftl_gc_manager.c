@@ -6,12 +6,12 @@
 #include "common.h"
 #include "ftl_sect_strategy.h"
 #include "ftl_obj_strategy.h"
+#include "test_context.h"
 #include <time.h>
 
 int fail_cnt = 0;
-extern double ssd_util;
 
-write_amplification_counters wa_counters;
+write_amplification_counters *wa_counters = NULL;
 extern ssd_disk ssd;
 GCAlgorithm gc_algo = {
     &DEFAULT_GC_COLLECTION_ALGO,
@@ -20,20 +20,54 @@ GCAlgorithm gc_algo = {
 
 gc_thread_t *gc_threads;
 
+/* Free blocks (the GC reserve included) below which incremental GC starts collecting */
+#define GC_INCREMENTAL_START_BLOCK_NB 3
+
+/*
+ * Sleep until woken up, or until ts when one is given. A condition variable can't wait on the
+ * device rwlock, so the thread parks on its own signal lock. That lock is taken before the device
+ * lock is dropped, so a wake-up sent by a writer in between is not lost.
+ */
+static void _GC_WAIT(gc_thread_t *gc_thread, const struct timespec *ts) {
+    uint8_t device_index = gc_thread->device_index;
+
+    pthread_mutex_lock(&gc_thread->gc_signal_lock);
+    pthread_rwlock_unlock(DEVICE_LOCK(device_index));
+    // gc_stop_flag is only set under the signal lock
+    if (!gc_thread->gc_stop_flag) {
+        if (ts == NULL) {
+            pthread_cond_wait(&gc_thread->gc_signal_cond, &gc_thread->gc_signal_lock);
+        } else {
+            pthread_cond_timedwait(&gc_thread->gc_signal_cond, &gc_thread->gc_signal_lock, ts);
+        }
+    }
+    pthread_mutex_unlock(&gc_thread->gc_signal_lock);
+    pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+}
+
 static void *GC_BACKGROUND_LOOP(void *arg) {
     gc_thread_t *gc_thread = arg;
     uint8_t device_index = gc_thread->device_index;
 
-    pthread_mutex_lock(&g_lock);
+    pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
     while (!gc_thread->gc_stop_flag) {
         gc_thread->gc_loop_count++;
         bool collected;
         uint64_t total_zero_page_nb;
         do {
-            collected = GC_CHECK(gc_thread->device_index, false, true);
+            if (devices[device_index].storage_strategy == STRATEGY_OBJECT)
+                collected = FTL_OBJ_GC_CHECK(device_index, false, true);
+            else
+                collected = GC_CHECK(device_index, false, true);
             total_zero_page_nb = inverse_mappings_manager[device_index].total_zero_page_nb;
         } while (collected && total_zero_page_nb < devices[device_index].gc_hi_thr_page_nb);
 
+        if (devices[device_index].gc_idle_usec > 0) {
+            // Anything beyond the collection above waits for the idle periods of the host
+            _GC_WAIT(gc_thread, NULL);
+            continue;
+        }
+
         struct timespec ts;
         clock_gettime(CLOCK_REALTIME, &ts);
         if (total_zero_page_nb >= devices[device_index].gc_low_thr_page_nb) {
@@ -41,32 +75,29 @@ static void *GC_BACKGROUND_LOOP(void *arg) {
         } else if (total_zero_page_nb >= devices[device_index].gc_hi_thr_page_nb) {
             ts.tv_sec += devices[device_index].gc_hi_thr_interval_sec;
         } else {
-            pthread_cond_wait(&gc_thread->gc_signal_cond, &g_lock);
+            _GC_WAIT(gc_thread, NULL);
             // gc_stop_flag must be rechecked immediately
             continue;
         }
 
-        if (!gc_thread->gc_stop_flag) {
-            pthread_cond_timedwait(&gc_thread->gc_signal_cond, &g_lock, &ts);
-            // gc_stop_flag must be rechecked immediately
-        }
+        _GC_WAIT(gc_thread, &ts);
+        // gc_stop_flag must be rechecked immediately
     }
-    pthread_mutex_unlock(&g_lock);
+    pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 
     return NULL;
 }
 
 void INIT_GC_MANAGER(uint8_t device_index) {
-    if (devices[device_index].storage_strategy == STRATEGY_OBJECT) {
-        DEV_PINFO(device_index, "GC of object strategy is not currently supported.\n");
-        return;
-    }
-
     gc_thread_t *gc_thread = &gc_threads[device_index];
     gc_thread->device_index = device_index;
+    pthread_mutex_init(&gc_thread->gc_signal_lock, NULL);
     pthread_cond_init(&gc_thread->gc_signal_cond, NULL);
     gc_thread->gc_stop_flag = false;
     gc_thread->gc_loop_count = 0;
+    gc_thread->victim_in_progress = false;
+    gc_thread->victim_seed = device_index + 1;
+    gc_thread->last_host_io_us = get_usec();
 
     if (0 != pthread_create(&gc_thread->tid, NULL, GC_BACKGROUND_LOOP, gc_thread)) {
         DEV_RERR(, device_index, "failed to create GC background thread\n");
@@ -74,21 +105,28 @@ void INIT_GC_MANAGER(uint8_t device_index) {
 }
 
 void TERM_GC_MANAGER(uint8_t device_index) {
-    if (devices[device_index].storage_strategy == STRATEGY_OBJECT) {
-        return;
-    }
-
     gc_thread_t *gc_thread = &gc_threads[device_index];
 
+    pthread_mutex_lock(&gc_thread->gc_signal_lock);
     gc_thread->gc_stop_flag = true;
     pthread_cond_signal(&gc_thread->gc_signal_cond);
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&gc_thread->gc_signal_lock);
+    pthread_rwlock_unlock(DEVICE_LOCK(device_index));
     if (0 != pthread_join(gc_thread->tid, NULL)) {
         DEV_PERR(device_index, "failed to join GC background thread\n");
     }
-    pthread_mutex_lock(&g_lock);
+    pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
 
     pthread_cond_destroy(&gc_thread->gc_signal_cond);
+    pthread_mutex_destroy(&gc_thread->gc_signal_lock);
+}
+
+void WAKE_GC_THREAD(uint8_t device_index) {
+    gc_thread_t *gc_thread = &gc_threads[device_index];
+
+    pthread_mutex_lock(&gc_thread->gc_signal_lock);
+    pthread_cond_signal(&gc_thread->gc_signal_cond);
+    pthread_mutex_unlock(&gc_thread->gc_signal_lock);
 }
 
 bool GC_CHECK(uint8_t device_index, bool force, bool background)
@@ -106,48 +144,90 @@ bool GC_CHECK(uint8_t device_index, bool force, bool background)
 			collected = true;
 		}
 	}
+
+	/* Idle background passes are used to even out the wear */
+	if(background && !collected)
+		WEAR_LEVELING_CHECK(device_index, background);
+
 	return collected;
 }
 
+void GC_NOTE_HOST_IO(uint8_t device_index)
+{
+	// readers share the device lock
+	__atomic_store_n(&gc_threads[device_index].last_host_io_us, get_usec(), __ATOMIC_RELAXED);
+}
+
+void GC_IDLE(uint8_t device_index, int64_t usec)
+{
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+
+	int64_t until_us = get_usec() + usec;
+	if (devices[device_index].gc_idle_usec > 0) {
+		if (devices[device_index].storage_strategy == STRATEGY_OBJECT)
+			FTL_OBJ_GC_IDLE_WORK(device_index, until_us);
+		else
+			GC_IDLE_WORK(device_index, until_us);
+	}
+	wait_until(until_us);
+
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
+}
+
 ftl_ret_val GARBAGE_COLLECTION(uint8_t device_index, int l2, bool background)
 {
     return gc_algo.collection(device_index, l2, background);
 }
 
-ftl_ret_val DEFAULT_GC_COLLECTION_ALGO(uint8_t device_index, int l2, bool background)
+/* Point the owner of a moved page, a logical page or an object page, to its new location */
+static void _GC_REMAP_PAGE(uint8_t device_index, uint64_t old_ppn, uint64_t new_ppn)
 {
-	uint64_t i;
-	int ret;
 	uint64_t lpn;
-	uint64_t old_ppn;
-	uint64_t new_ppn;
 
-	unsigned int victim_phy_flash_nb = devices[device_index].flash_nb;
-	uint64_t victim_phy_block_nb = 0;
+	if (devices[device_index].storage_strategy == STRATEGY_OBJECT) {
+		_FTL_OBJ_RELOCATE_PAGE(device_index, old_ppn, new_ppn);
+		return;
+	}
 
-	char* valid_array;
-    int valid_page_nb;
-	int copy_page_nb = 0;
+	GET_INVERSE_MAPPING_INFO(device_index, old_ppn, &lpn);
+	UPDATE_OLD_PAGE_MAPPING(device_index, lpn);
+	UPDATE_NEW_PAGE_MAPPING(device_index, lpn, new_ppn);
+}
 
-	inverse_block_mapping_entry* inverse_block_entry;
+/* Move one valid page of a victim block to new_ppn, by copyback when the flash allows it, or else over the host path */
+static void _GC_MOVE_PAGE(uint8_t device_index, bool background, unsigned int victim_phy_flash_nb, uint64_t victim_phy_block_nb, uint64_t i, uint64_t new_ppn, bool copyback)
+{
+	int ret = FTL_FAILURE;
+	uint64_t old_ppn = victim_phy_flash_nb * devices[device_index].pages_per_flash + victim_phy_block_nb * devices[device_index].page_nb + i;
+	ppn_coords_t new_coords;
+
+	if (copyback) {
+		if (devices[device_index].storage_strategy == STRATEGY_SECTOR)
+			ret = _FTL_COPYBACK(device_index, old_ppn, new_ppn, background ? COPYBACK_BACKGROUND : COPYBACK);
+		else if (devices[device_index].storage_strategy == STRATEGY_OBJECT)
+			ret = _FTL_OBJ_COPYBACK(device_index, old_ppn, new_ppn, background ? COPYBACK_BACKGROUND : COPYBACK);
+
+		if (ret == FTL_SUCCESS)
+			return;
+		PDBG_FTL("failed to copyback\n");
+	}
 
-	ret = SELECT_VICTIM_BLOCK(device_index, &victim_phy_flash_nb, &victim_phy_block_nb);
+	SSD_PAGE_READ(device_index, victim_phy_flash_nb, victim_phy_block_nb, i, i, background ? GC_READ_BACKGROUND : GC_READ);
+	DECODE_PPN(device_index, new_ppn, &new_coords);
+	SSD_PAGE_WRITE(device_index, new_coords.flash, new_coords.block, new_coords.page, i, background ? GC_WRITE_BACKGROUND : GC_WRITE);
+	_GC_REMAP_PAGE(device_index, old_ppn, new_ppn);
+}
 
-	if (ret == FTL_FAILURE)
-		RDBG_FTL(FTL_FAILURE, "There is no available victim block\n");
+/* Move one valid page out of a victim block, by copyback when a page on the same plane is free */
+static ftl_ret_val _GC_COPY_PAGE(uint8_t device_index, int l2, bool background, unsigned int victim_phy_flash_nb, uint64_t victim_phy_block_nb, uint64_t i)
+{
+	int ret;
+	uint64_t new_ppn;
 
 	// attempt to find new pages in the same flash as the victim block, for copyback
-	int victim_phy_plane_nb = victim_phy_block_nb % devices[device_index].planes_per_flash;
+	int victim_phy_plane_nb = GEOMETRY_MOD(&devices[device_index].geometry.planes_per_flash, victim_phy_block_nb);
 	uint64_t mapping_index = victim_phy_plane_nb * devices[device_index].flash_nb + victim_phy_flash_nb;
 
-	inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, victim_phy_flash_nb, victim_phy_block_nb);
-	valid_array = inverse_block_entry->valid_array;
-    valid_page_nb = inverse_block_entry->valid_page_nb;
-
-	for (i = 0; i < devices[device_index].page_nb; i++){
-		if (valid_array[i] == PAGE_VALID){
-
-
 // This is original vssim code without copyback
 //            ret = GET_NEW_PAGE(VICTIM_OVERALL, mapping_index, &new_ppn);
 //            if(ret == FAIL){
@@ -165,62 +245,88 @@ ftl_ret_val DEFAULT_GC_COLLECTION_ALGO(uint8_t device_index, int l2, bool backgr
 
 
 
-			ret = GET_NEW_PAGE(device_index, VICTIM_INCHIP_GC, mapping_index, &new_ppn);
-
-            if(ret == FTL_FAILURE){
-                if (!l2)
-				    RERR(FTL_FAILURE, "GET_NEW_PAGE(VICTIM_INCHIP_GC, %lx): failed\n", mapping_index);
-                // l2 threshold reached. let's re-write the page
-                ret = GET_NEW_PAGE(device_index, VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb, &new_ppn);
-                if(ret == FTL_FAILURE)
-				    RERR(FTL_FAILURE, "GET_NEW_PAGE(VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb): failed\n");
-
-                SSD_PAGE_READ(device_index, victim_phy_flash_nb, victim_phy_block_nb, i, i, background ? GC_READ_BACKGROUND : GC_READ);
-                SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, new_ppn), CALC_BLOCK(device_index, new_ppn), CALC_PAGE(device_index, new_ppn), i, background ? GC_WRITE_BACKGROUND : GC_WRITE);
-                old_ppn = victim_phy_flash_nb * devices[device_index].pages_per_flash + victim_phy_block_nb * devices[device_index].page_nb + i;
-                GET_INVERSE_MAPPING_INFO(device_index, old_ppn, &lpn);
-                UPDATE_NEW_PAGE_MAPPING(device_index, lpn, new_ppn);
-            }else{
-                // Got new page on-chip, can do copy back
-
-                if (devices[device_index].storage_strategy == STRATEGY_SECTOR)
-                {
-                    ret = _FTL_COPYBACK(device_index, victim_phy_flash_nb * devices[device_index].pages_per_flash + victim_phy_block_nb * devices[device_index].page_nb + i , new_ppn, background ? COPYBACK_BACKGROUND : COPYBACK);
-                }
-                else if (devices[device_index].storage_strategy == STRATEGY_OBJECT)
-                {
-                    ret = _FTL_OBJ_COPYBACK(device_index, victim_phy_flash_nb * devices[device_index].pages_per_flash + victim_phy_block_nb * devices[device_index].page_nb + i , new_ppn);
-                }
-                else
-                {
-                    ret = FTL_FAILURE;
-                }
-
-                if(ret == FTL_FAILURE){
-                    PDBG_FTL("failed to copyback\n");
-                    SSD_PAGE_READ(device_index, victim_phy_flash_nb, victim_phy_block_nb, i, i, background ? GC_READ_BACKGROUND : GC_READ);
-                    SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, new_ppn), CALC_BLOCK(device_index, new_ppn), CALC_PAGE(device_index, new_ppn), i, background ? GC_WRITE_BACKGROUND : GC_WRITE);
-                    old_ppn = victim_phy_flash_nb*devices[device_index].pages_per_flash + victim_phy_block_nb* devices[device_index].page_nb + i;
-                    GET_INVERSE_MAPPING_INFO(device_index, old_ppn, &lpn);
-                    UPDATE_NEW_PAGE_MAPPING(device_index, lpn, new_ppn);
-                }
-            }
-
-			copy_page_nb++;
-			//if we got this far, it means we copied the page from the victim block to a new one -> meaning, we wrote to that new block so we need to update the relevant counter
-			wa_counters.physical_block_write_counter++;
+	ret = GET_NEW_STREAM_PAGE(device_index, VICTIM_INCHIP_GC, mapping_index, WRITE_STREAM_GC, &new_ppn);
+
+    if(ret == FTL_FAILURE){
+        if (!l2)
+		    RERR(FTL_FAILURE, "GET_NEW_PAGE(VICTIM_INCHIP_GC, %lx): failed\n", mapping_index);
+        // l2 threshold reached. let's re-write the page
+        ret = GET_NEW_STREAM_PAGE(device_index, VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb, WRITE_STREAM_GC, &new_ppn);
+        if(ret == FTL_FAILURE)
+		    RERR(FTL_FAILURE, "GET_NEW_PAGE(VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb): failed\n");
+
+        // another plane of the same flash is still in reach of copyback, through the controller buffer
+        _GC_MOVE_PAGE(device_index, background, victim_phy_flash_nb, victim_phy_block_nb, i, new_ppn,
+                devices[device_index].copyback_cross_plane && CALC_FLASH(device_index, new_ppn) == victim_phy_flash_nb);
+    }else{
+        // Got new page on-chip, can do copy back
+        _GC_MOVE_PAGE(device_index, background, victim_phy_flash_nb, victim_phy_block_nb, i, new_ppn, true);
+    }
+
+	//if we got this far, it means we copied the page from the victim block to a new one -> meaning, we wrote to that new block so we need to update the relevant counter
+	wa_counters[device_index].physical_block_write_counter++;
 
+	return FTL_SUCCESS;
+}
+
+/*
+ * Move several valid pages of a victim block by one multi-plane copyback: the first page stays on the
+ * plane of the victim, every other one goes to the next plane of the same flash through the controller
+ * buffer. Pages a plane has no free page for are moved one at a time.
+ */
+static ftl_ret_val _GC_COPY_PAGE_BATCH(uint8_t device_index, int l2, bool background, unsigned int victim_phy_flash_nb, uint64_t victim_phy_block_nb, const uint64_t* pages, unsigned int page_nb)
+{
+	uint64_t sources[page_nb];
+	uint64_t destinations[page_nb];
+	unsigned int k, planned_page_nb;
+	int ret;
+
+	int victim_phy_plane_nb = GEOMETRY_MOD(&devices[device_index].geometry.planes_per_flash, victim_phy_block_nb);
+
+	for (k = 0; k < page_nb; k++) {
+		uint64_t mapping_index = ((victim_phy_plane_nb + k) % devices[device_index].planes_per_flash) * devices[device_index].flash_nb + victim_phy_flash_nb;
+		if (GET_NEW_STREAM_PAGE(device_index, VICTIM_INCHIP_GC, mapping_index, WRITE_STREAM_GC, &destinations[k]) == FTL_FAILURE)
+			break;
+		sources[k] = victim_phy_flash_nb * devices[device_index].pages_per_flash + victim_phy_block_nb * devices[device_index].page_nb + pages[k];
+	}
+	planned_page_nb = k;
+
+	if (planned_page_nb > 1) {
+		if (devices[device_index].storage_strategy == STRATEGY_SECTOR)
+			ret = _FTL_MULTI_PLANE_COPYBACK(device_index, sources, destinations, planned_page_nb, background ? COPYBACK_BACKGROUND : COPYBACK);
+		else
+			ret = _FTL_OBJ_MULTI_PLANE_COPYBACK(device_index, sources, destinations, planned_page_nb, background ? COPYBACK_BACKGROUND : COPYBACK);
+
+		if (ret == FTL_FAILURE) {
+			for (k = 0; k < planned_page_nb; k++)
+				_GC_MOVE_PAGE(device_index, background, victim_phy_flash_nb, victim_phy_block_nb, pages[k], destinations[k], true);
 		}
 	}
+	else if (planned_page_nb == 1) {
+		_GC_MOVE_PAGE(device_index, background, victim_phy_flash_nb, victim_phy_block_nb, pages[0], destinations[0], true);
+	}
+	wa_counters[device_index].physical_block_write_counter += planned_page_nb;
 
-	if (copy_page_nb != valid_page_nb)
+	for (k = planned_page_nb; k < page_nb; k++) {
+		if (_GC_COPY_PAGE(device_index, l2, background, victim_phy_flash_nb, victim_phy_block_nb, pages[k]) == FTL_FAILURE)
+			return FTL_FAILURE;
+	}
+
+	return FTL_SUCCESS;
+}
 
-		RERR(FTL_FAILURE, "The number of valid page is not correct copy_page_nb (%d) != valid_page_nb (%d)\n", copy_page_nb, valid_page_nb);
+/* Erase a victim block whose valid pages were all moved and return it to the empty pool */
+static ftl_ret_val _GC_ERASE_VICTIM(uint8_t device_index, bool background, unsigned int victim_phy_flash_nb, uint64_t victim_phy_block_nb)
+{
+	inverse_block_mapping_entry* inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, victim_phy_flash_nb, victim_phy_block_nb);
 
+	// every copied page was invalidated, and so were the ones the host rewrote in between
+	if (inverse_block_entry->valid_page_nb != 0)
+		RERR(FTL_FAILURE, "The number of valid page is not correct, %" PRIu64 " valid pages left in the victim\n", inverse_block_entry->valid_page_nb);
 
 	SSD_BLOCK_ERASE(device_index, victim_phy_flash_nb, victim_phy_block_nb, background ? ERASE_BACKGROUND : ERASE);
 	//update the physical block write counter as we're deleting the victim block which we're freeing during the GC procedure
-	wa_counters.physical_block_write_counter++;
+	wa_counters[device_index].physical_block_write_counter++;
 	UPDATE_INVERSE_BLOCK_MAPPING(device_index, victim_phy_flash_nb, victim_phy_block_nb, EMPTY_BLOCK);
 	INSERT_EMPTY_BLOCK(device_index, victim_phy_flash_nb, victim_phy_block_nb);
 
@@ -229,43 +335,501 @@ ftl_ret_val DEFAULT_GC_COLLECTION_ALGO(uint8_t device_index, int l2, bool backgr
 	return FTL_SUCCESS;
 }
 
+/*
+ * Copy at most max_copy_page_nb valid pages out of the current victim, selecting a new victim when
+ * none is in progress. The victim is erased once it holds no valid pages, *erased tells whether
+ * that happened in this call.
+ */
+static ftl_ret_val _GC_COLLECT_PAGES(uint8_t device_index, int l2, bool background, uint64_t max_copy_page_nb, uint64_t* copy_page_nb, bool* erased)
+{
+	uint64_t i;
+	int ret;
+
+	gc_thread_t* gc_thread = &gc_threads[device_index];
+	uint64_t* valid_bitmap;
+	uint64_t bitmap_word_nb = inverse_mappings_manager[device_index].page_bitmap_word_nb;
 
-/* Greedy Garbage Collection Algorithm */
-ftl_ret_val SELECT_VICTIM_BLOCK(uint8_t device_index, unsigned int* phy_flash_nb, uint64_t* phy_block_nb)
+	*copy_page_nb = 0;
+	*erased = false;
+
+	if (!gc_thread->victim_in_progress) {
+		unsigned int victim_phy_flash_nb = devices[device_index].flash_nb;
+		uint64_t victim_phy_block_nb = 0;
+
+		ret = SELECT_VICTIM_BLOCK(device_index, &victim_phy_flash_nb, &victim_phy_block_nb);
+
+		if (ret == FTL_FAILURE)
+			RDBG_FTL(FTL_FAILURE, "There is no available victim block\n");
+
+		gc_thread->victim_in_progress = true;
+		gc_thread->victim_flash_nb = victim_phy_flash_nb;
+		gc_thread->victim_block_nb = victim_phy_block_nb;
+		gc_thread->victim_next_page_nb = 0;
+	}
+
+	unsigned int victim_phy_flash_nb = gc_thread->victim_flash_nb;
+	uint64_t victim_phy_block_nb = gc_thread->victim_block_nb;
+
+	valid_bitmap = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, victim_phy_flash_nb, victim_phy_block_nb)->valid_bitmap;
+
+	/* Pages moved by a single multi-plane copyback, which needs the controller buffer to change planes */
+	unsigned int batch_page_nb = devices[device_index].copyback_cross_plane ? devices[device_index].copyback_multi_plane_page_nb : 1;
+	uint64_t pages[batch_page_nb];
+
+	/* Only the valid pages are visited, a word of the bitmap at a time */
+	for (i = NEXT_SET_BIT(valid_bitmap, bitmap_word_nb, gc_thread->victim_next_page_nb); i < devices[device_index].page_nb; ){
+
+		if (*copy_page_nb == max_copy_page_nb)
+			return FTL_SUCCESS;
+
+		unsigned int page_nb = 0;
+		do {
+			pages[page_nb++] = i;
+			i = NEXT_SET_BIT(valid_bitmap, bitmap_word_nb, i + 1);
+		} while (page_nb < batch_page_nb && i < devices[device_index].page_nb && *copy_page_nb + page_nb < max_copy_page_nb);
+
+		if (page_nb == 1)
+			ret = _GC_COPY_PAGE(device_index, l2, background, victim_phy_flash_nb, victim_phy_block_nb, pages[0]);
+		else
+			ret = _GC_COPY_PAGE_BATCH(device_index, l2, background, victim_phy_flash_nb, victim_phy_block_nb, pages, page_nb);
+		if (ret == FTL_FAILURE)
+			return FTL_FAILURE;
+
+		*copy_page_nb += page_nb;
+		gc_thread->victim_next_page_nb = pages[page_nb - 1] + 1;
+	}
+
+	gc_thread->victim_in_progress = false;
+	if (_GC_ERASE_VICTIM(device_index, background, victim_phy_flash_nb, victim_phy_block_nb) == FTL_FAILURE)
+		return FTL_FAILURE;
+
+	*erased = true;
+	return FTL_SUCCESS;
+}
+
+/* File a block that is no longer collected back into the victim index */
+static void _REFILE_VICTIM(uint8_t device_index, unsigned int victim_phy_flash_nb, uint64_t victim_phy_block_nb)
 {
-	uint32_t i;
+	empty_block_entry victim_block = {
+		.phy_flash_nb = victim_phy_flash_nb,
+		.phy_block_nb = victim_phy_block_nb,
+		.curr_phy_page_nb = devices[device_index].page_nb,
+	};
+	INSERT_VICTIM_BLOCK(device_index, &victim_block);
+}
 
-	victim_block_root* curr_root;
-	victim_block_entry* curr_victim_entry = NULL;
-	victim_block_entry* victim_block = NULL;
+typedef victim_block_entry* (*gc_victim_policy_algo)(uint8_t device_index);
 
-	if (inverse_mappings_manager[device_index].total_victim_block_nb == 0)
+static victim_block_entry* _GREEDY_VICTIM(uint8_t device_index)
+{
+	return GET_MIN_VICTIM_BLOCK(device_index, &inverse_mappings_manager[device_index].victim_block_index);
+}
 
-		RDBG_FTL(FTL_FAILURE, "[SELECT_VICTIM_BLOCK] There is no victim block\n");
+/*
+ * Cost-benefit of LFS: the free fraction gained, weighted by how long the block has been left alone
+ * since its last invalidation, over the cost of reading and rewriting the valid pages. Without
+ * emulated time all the ages are equal and this falls back to greedy.
+ */
+static victim_block_entry* _COST_BENEFIT_VICTIM(uint8_t device_index)
+{
+	inverse_block_mapping_entry* entries = inverse_mappings_manager[device_index].inverse_block_mapping_table_start;
+	uint64_t page_nb = devices[device_index].page_nb;
+	int64_t now = get_usec();
+	victim_block_entry* best = NULL;
+	double best_score = -1;
+	uint64_t i;
 
+	for (i = 0; i < devices[device_index].block_mapping_entry_nb; i++) {
+		victim_block_entry* victim = entries[i].victim;
+		if (victim == NULL)
+			continue;
+
+		int64_t age = now - entries[i].last_invalidation_time;
+		uint64_t valid_page_nb = *(victim->valid_page_nb);
+		double score = (double)(age > 0 ? age + 1 : 1) * (page_nb - valid_page_nb) / (page_nb + valid_page_nb);
+		if (score > best_score || (score == best_score && valid_page_nb < *(best->valid_page_nb))) {
+			best = victim;
+			best_score = score;
+		}
+	}
 
-	/* if GC_TRIGGER_OVERALL is defined, then */
-	curr_root = inverse_mappings_manager[device_index].victim_block_table_start;
+	return best;
+}
 
-	for (i=0;i<devices[device_index].victim_table_entry_nb;i++) {
+/*
+ * Greedy among d victims sampled at random. Block ids are drawn from the whole device and the ones
+ * that aren't victims or have nothing to reclaim are skipped, which is cheap since most blocks are
+ * victims when GC runs.
+ */
+static victim_block_entry* _D_CHOICES_VICTIM(uint8_t device_index)
+{
+	inverse_block_mapping_entry* entries = inverse_mappings_manager[device_index].inverse_block_mapping_table_start;
+	unsigned int* seed = &gc_threads[device_index].victim_seed;
+	int choice_nb = devices[device_index].gc_victim_candidate_nb;
+	int draw_nb = 16 * choice_nb;
+	victim_block_entry* best = NULL;
+
+	while (choice_nb > 0 && draw_nb-- > 0) {
+		victim_block_entry* victim = entries[rand_r(seed) % devices[device_index].block_mapping_entry_nb].victim;
+		if (victim == NULL || *(victim->valid_page_nb) == devices[device_index].page_nb)
+			continue;
+
+		choice_nb--;
+		if (best == NULL || *(victim->valid_page_nb) < *(best->valid_page_nb))
+			best = victim;
+	}
 
-		if(curr_root->victim_block_nb != 0){
-			curr_victim_entry = curr_root->next;
-			if(victim_block == NULL){
-				victim_block = curr_root->next;
-			}
-			if(*(victim_block->valid_page_nb) == 0){ // evict dead block
-				break;
+	return best != NULL ? best : _GREEDY_VICTIM(device_index);
+}
+
+/*
+ * Greedy among the w blocks with invalid pages that filled up first, which keeps recently written
+ * blocks, whose pages may still be invalidated, out of reach.
+ */
+static victim_block_entry* _WINDOWED_VICTIM(uint8_t device_index)
+{
+	inverse_block_mapping_entry* entries = inverse_mappings_manager[device_index].inverse_block_mapping_table_start;
+	int window_nb = devices[device_index].gc_victim_candidate_nb;
+	victim_block_entry* window[window_nb];
+	victim_block_entry* best = NULL;
+	int filled_nb = 0;
+	int k;
+	uint64_t i;
+
+	/* Keep the window sorted by fill order, oldest first */
+	for (i = 0; i < devices[device_index].block_mapping_entry_nb; i++) {
+		victim_block_entry* victim = entries[i].victim;
+		if (victim == NULL || *(victim->valid_page_nb) == devices[device_index].page_nb)
+			continue;
+		if (filled_nb == window_nb && victim->seq >= window[window_nb - 1]->seq)
+			continue;
+
+		k = filled_nb < window_nb ? filled_nb++ : window_nb - 1;
+		for (; k > 0 && window[k - 1]->seq > victim->seq; k--)
+			window[k] = window[k - 1];
+		window[k] = victim;
+	}
+
+	for (k = 0; k < filled_nb; k++) {
+		if (best == NULL || *(window[k]->valid_page_nb) < *(best->valid_page_nb))
+			best = window[k];
+	}
+
+	return best != NULL ? best : _GREEDY_VICTIM(device_index);
+}
+
+static const gc_victim_policy_algo gc_victim_policies[GC_VICTIM_POLICY_NB] = {
+	[GC_VICTIM_GREEDY] = &_GREEDY_VICTIM,
+	[GC_VICTIM_COST_BENEFIT] = &_COST_BENEFIT_VICTIM,
+	[GC_VICTIM_D_CHOICES] = &_D_CHOICES_VICTIM,
+	[GC_VICTIM_WINDOWED] = &_WINDOWED_VICTIM,
+};
+
+/* The victim the policy of the device picks, it is left in the index */
+static victim_block_entry* _POLICY_VICTIM(uint8_t device_index)
+{
+	return gc_victim_policies[devices[device_index].gc_victim_policy](device_index);
+}
+
+/*
+ * Pick victims on distinct flash chips, the one of the victim policy first. Another chip joins
+ * when its least valid victim frees at least half as many pages as that one, so the batch doesn't
+ * pay much in write amplification for the parallelism.
+ */
+static int _SELECT_PARALLEL_VICTIMS(uint8_t device_index, int max_victim_nb, unsigned int* phy_flash_nbs, uint64_t* phy_block_nbs)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	victim_block_entry* victims[max_victim_nb];
+	uint64_t page_nb = devices[device_index].page_nb;
+	unsigned int flash_nb;
+	uint64_t plane_nb;
+	int victim_nb = 0;
+	int k;
+
+	if (manager->total_victim_block_nb == 0)
+		RDBG_FTL(0, "[_SELECT_PARALLEL_VICTIMS] There is no victim block\n");
+
+	victims[0] = _POLICY_VICTIM(device_index);
+	if (victims[0] == NULL)
+		RERR(0, "[_SELECT_PARALLEL_VICTIMS] Victim index is out of sync\n");
+	if (*(victims[0]->valid_page_nb) == page_nb) {
+		fail_cnt++;
+		return 0;
+	}
+	victim_nb = 1;
+
+	uint64_t min_free_page_nb = page_nb - *(victims[0]->valid_page_nb);
+	for (flash_nb = 0; flash_nb < devices[device_index].flash_nb && victim_nb < max_victim_nb; flash_nb++) {
+		if (flash_nb == victims[0]->phy_flash_nb)
+			continue;
+
+		victim_block_entry* best = NULL;
+		for (plane_nb = 0; plane_nb < devices[device_index].planes_per_flash; plane_nb++) {
+			victim_block_entry* victim = GET_MIN_VICTIM_BLOCK(device_index, manager->victim_block_table_start + plane_nb * devices[device_index].flash_nb + flash_nb);
+			if (victim != NULL && (best == NULL || *(victim->valid_page_nb) < *(best->valid_page_nb)))
+				best = victim;
+		}
+
+		if (best != NULL && 2 * (page_nb - *(best->valid_page_nb)) >= min_free_page_nb)
+			victims[victim_nb++] = best;
+	}
+
+	for (k = 0; k < victim_nb; k++) {
+		phy_flash_nbs[k] = victims[k]->phy_flash_nb;
+		phy_block_nbs[k] = victims[k]->phy_block_nb;
+		EJECT_VICTIM_BLOCK(device_index, victims[k]);
+	}
+
+	return victim_nb;
+}
+
+/*
+ * Collect victims on several flash chips at once. The pages are moved one chip after the other,
+ * and since the timing model only waits for the previous operation of the same register, the
+ * copybacks and erases of different chips overlap in emulated time.
+ */
+static ftl_ret_val _GC_COLLECT_PARALLEL(uint8_t device_index, int l2, bool background)
+{
+	int max_victim_nb = devices[device_index].gc_parallel_victim_nb;
+	unsigned int phy_flash_nbs[max_victim_nb];
+	uint64_t phy_block_nbs[max_victim_nb];
+	uint64_t next_page_nbs[max_victim_nb];
+	uint64_t* valid_bitmaps[max_victim_nb];
+	uint64_t page_nb = devices[device_index].page_nb;
+	uint64_t bitmap_word_nb = inverse_mappings_manager[device_index].page_bitmap_word_nb;
+	ftl_ret_val ret = FTL_SUCCESS;
+	int victim_nb;
+	int left_nb;
+	int k;
+
+	victim_nb = _SELECT_PARALLEL_VICTIMS(device_index, max_victim_nb, phy_flash_nbs, phy_block_nbs);
+	if (victim_nb == 0)
+		RDBG_FTL(FTL_FAILURE, "There is no available victim block\n");
+
+	for (k = 0; k < victim_nb; k++) {
+		valid_bitmaps[k] = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, phy_flash_nbs[k], phy_block_nbs[k])->valid_bitmap;
+		next_page_nbs[k] = NEXT_SET_BIT(valid_bitmaps[k], bitmap_word_nb, 0);
+	}
+
+	left_nb = victim_nb;
+	while (left_nb > 0) {
+		for (k = 0; k < victim_nb; k++) {
+			if (next_page_nbs[k] == UINT64_MAX)
+				continue;
+
+			if (next_page_nbs[k] >= page_nb) {
+				// nothing left to copy, the erase overlaps with the copies of the other chips
+				if (_GC_ERASE_VICTIM(device_index, background, phy_flash_nbs[k], phy_block_nbs[k]) == FTL_FAILURE)
+					ret = FTL_FAILURE;
+				next_page_nbs[k] = UINT64_MAX;
+				left_nb--;
+				continue;
 			}
 
-			if(*(victim_block->valid_page_nb) > *(curr_victim_entry->valid_page_nb)){ // list is sorted by valid_page_nb
-				victim_block = curr_victim_entry;
+			if (_GC_COPY_PAGE(device_index, l2, background, phy_flash_nbs[k], phy_block_nbs[k], next_page_nbs[k]) == FTL_FAILURE) {
+				// give the victims that were not erased back to the index
+				for (k = 0; k < victim_nb; k++) {
+					if (next_page_nbs[k] != UINT64_MAX)
+						_REFILE_VICTIM(device_index, phy_flash_nbs[k], phy_block_nbs[k]);
+				}
+				return FTL_FAILURE;
 			}
-			curr_victim_entry = curr_victim_entry->next;
+			next_page_nbs[k] = NEXT_SET_BIT(valid_bitmaps[k], bitmap_word_nb, next_page_nbs[k] + 1);
+		}
+	}
+
+	return ret;
+}
+
+ftl_ret_val DEFAULT_GC_COLLECTION_ALGO(uint8_t device_index, int l2, bool background)
+{
+	uint64_t copy_page_nb;
+	bool erased;
+
+	if (!gc_threads[device_index].victim_in_progress && devices[device_index].gc_parallel_victim_nb > 1)
+		return _GC_COLLECT_PARALLEL(device_index, l2, background);
+
+	/* A partly collected victim is finished first */
+	return _GC_COLLECT_PAGES(device_index, l2, background, UINT64_MAX, &copy_page_nb, &erased);
+}
+
+bool GC_INCREMENTAL_STEP(uint8_t device_index)
+{
+	gc_thread_t* gc_thread = &gc_threads[device_index];
+	uint64_t page_nb = devices[device_index].page_nb;
+	uint64_t budget = devices[device_index].gc_incremental_page_nb;
+	uint64_t copy_page_nb;
+	bool erased;
+	bool collected = false;
+
+	/*
+	 * Start while there are still a couple of free blocks besides the GC reserve, so a victim can
+	 * be collected a few pages per write before the host needs the reserve.
+	 */
+	if (!gc_thread->victim_in_progress && inverse_mappings_manager[device_index].total_zero_page_nb >= GC_INCREMENTAL_START_BLOCK_NB * page_nb)
+		return false;
+
+	int l2 = inverse_mappings_manager[device_index].total_zero_page_nb < devices[device_index].gc_l2_threshold_block_nb * page_nb;
+	while (budget > 0) {
+		if (_GC_COLLECT_PAGES(device_index, l2, false, budget, &copy_page_nb, &erased) == FTL_FAILURE)
+			return collected;
+		budget -= copy_page_nb;
+		if (!erased)
+			break;
+		collected = true;
+		if (inverse_mappings_manager[device_index].total_zero_page_nb >= GC_INCREMENTAL_START_BLOCK_NB * page_nb)
+			break;
+	}
+
+	/* The copies must not depend on the GC reserve, finish the victim while there is room for it */
+	if (gc_thread->victim_in_progress) {
+		inverse_block_mapping_entry* inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, gc_thread->victim_flash_nb, gc_thread->victim_block_nb);
+		if (inverse_mappings_manager[device_index].total_zero_page_nb < inverse_block_entry->valid_page_nb + page_nb) {
+			if (_GC_COLLECT_PAGES(device_index, l2, false, UINT64_MAX, &copy_page_nb, &erased) == FTL_SUCCESS)
+				collected = true;
+		}
+	}
+
+	return collected;
+}
+
+bool WEAR_LEVELING_CHECK(uint8_t device_index, bool background)
+{
+	gc_thread_t* gc_thread = &gc_threads[device_index];
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	inverse_block_mapping_entry* entries = manager->inverse_block_mapping_table_start;
+	inverse_block_mapping_entry* coldest = NULL;
+	unsigned int max_erase_count = 0;
+	uint64_t copy_page_nb;
+	bool erased;
+	uint64_t i;
+
+	if (devices[device_index].wear_leveling_threshold <= 0 || gc_thread->victim_in_progress)
+		return false;
+
+	/* The coldest block is the least erased full block, its data has not been rewritten since */
+	for (i = 0; i < devices[device_index].block_mapping_entry_nb; i++) {
+		if (entries[i].erase_count > max_erase_count)
+			max_erase_count = entries[i].erase_count;
+		if (entries[i].victim != NULL && (coldest == NULL || entries[i].erase_count < coldest->erase_count))
+			coldest = entries + i;
+	}
+
+	if (coldest == NULL || max_erase_count - coldest->erase_count <= (unsigned int)devices[device_index].wear_leveling_threshold)
+		return false;
+
+	/* The moved pages must fit besides the GC reserve */
+	if (manager->total_zero_page_nb < coldest->valid_page_nb + 2 * devices[device_index].page_nb)
+		return false;
+
+	victim_block_entry* victim_block = coldest->victim;
+	unsigned int phy_flash_nb = victim_block->phy_flash_nb;
+	uint64_t phy_block_nb = victim_block->phy_block_nb;
+	unsigned int erase_count = coldest->erase_count;
+
+	int64_t start = get_usec();
+
+	/* Collect it like a GC victim, its pages go to the write block of its plane */
+	EJECT_VICTIM_BLOCK(device_index, victim_block);
+	gc_thread->victim_in_progress = true;
+	gc_thread->victim_flash_nb = phy_flash_nb;
+	gc_thread->victim_block_nb = phy_block_nb;
+	gc_thread->victim_next_page_nb = 0;
+
+	if (_GC_COLLECT_PAGES(device_index, 1, background, UINT64_MAX, &copy_page_nb, &erased) == FTL_FAILURE) {
+		DEV_PERR(device_index, "wear leveling of block %u:%" PRIu64 " failed\n", phy_flash_nb, phy_block_nb);
+		RELEASE_GC_VICTIM(device_index);
+		return false;
+	}
 
+	LOG_WEAR_LEVELING(GET_LOGGER(device_index, phy_flash_nb), (WearLevelingLog) {
+		.die = phy_flash_nb, .block = phy_block_nb, .erase_count = erase_count,
+		.max_erase_count = max_erase_count, .moved_page_nb = copy_page_nb,
+		.background = background,
+		.metadata = LOG_META(device_index, start, get_usec())
+	});
+
+	return true;
+}
+
+bool GC_IDLE_WORK(uint8_t device_index, int64_t until_us)
+{
+	gc_thread_t* gc_thread = &gc_threads[device_index];
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t copy_page_nb;
+	bool erased;
+	bool worked = false;
+
+	/* The gap only counts as idle once the host stayed away for gc_idle_usec */
+	int64_t start_us = __atomic_load_n(&gc_thread->last_host_io_us, __ATOMIC_RELAXED) + devices[device_index].gc_idle_usec;
+	if (start_us < get_usec())
+		start_us = get_usec();
+	if (start_us >= until_us)
+		return false;
+	wait_until(start_us);
+
+	int64_t end_us = until_us;
+	if (devices[device_index].gc_idle_budget_usec > 0 && start_us + devices[device_index].gc_idle_budget_usec < end_us)
+		end_us = start_us + devices[device_index].gc_idle_budget_usec;
+
+	/*
+	 * A flash operation is only waited for by the next one on its register, so the clock hardly moves
+	 * while the work is issued. The budget is charged with the nominal cost of every operation instead.
+	 */
+	const int64_t page_cost_us = devices[device_index].reg_read_delay + devices[device_index].cell_read_delay
+		+ devices[device_index].reg_write_delay + devices[device_index].cell_program_delay;
+	int64_t busy_us = start_us;
+
+	while (busy_us < end_us) {
+		unsigned long write_nb = wa_counters[device_index].physical_block_write_counter;
+
+		if ((gc_thread->victim_in_progress || manager->total_zero_page_nb < devices[device_index].gc_low_thr_page_nb)
+				&& _GC_COLLECT_PAGES(device_index, manager->total_zero_page_nb < devices[device_index].gc_l2_threshold_block_nb * devices[device_index].page_nb,
+						true, 1, &copy_page_nb, &erased) == FTL_SUCCESS) {
+			busy_us += copy_page_nb * page_cost_us + (erased ? devices[device_index].block_erase_delay : 0);
+		} else if (WEAR_LEVELING_CHECK(device_index, true)) {
+			/* the erase is counted as a physical write as well */
+			busy_us += (wa_counters[device_index].physical_block_write_counter - write_nb - 1) * page_cost_us
+				+ devices[device_index].block_erase_delay;
+		} else {
+			break;
 		}
-		curr_root += 1;
+		worked = true;
+
+		if (busy_us < get_usec())
+			busy_us = get_usec();
 	}
+
+	return worked;
+}
+
+void RELEASE_GC_VICTIM(uint8_t device_index)
+{
+	gc_thread_t* gc_thread = &gc_threads[device_index];
+
+	if (!gc_thread->victim_in_progress)
+		return;
+
+	_REFILE_VICTIM(device_index, gc_thread->victim_flash_nb, gc_thread->victim_block_nb);
+	gc_thread->victim_in_progress = false;
+}
+
+
+/* Greedy Garbage Collection Algorithm */
+ftl_ret_val SELECT_VICTIM_BLOCK(uint8_t device_index, unsigned int* phy_flash_nb, uint64_t* phy_block_nb)
+{
+	victim_block_entry* victim_block = NULL;
+
+	if (inverse_mappings_manager[device_index].total_victim_block_nb == 0)
+
+		RDBG_FTL(FTL_FAILURE, "[SELECT_VICTIM_BLOCK] There is no victim block\n");
+
+
+	/* Greedy takes the device wide index, the other policies scan the victims */
+	victim_block = _POLICY_VICTIM(device_index);
+	if (victim_block == NULL)
+		RERR(FTL_FAILURE, "[SELECT_VICTIM_BLOCK] Victim index is out of sync\n");
+
 	if (*(victim_block->valid_page_nb) == devices[device_index].page_nb) {
 		fail_cnt++;
 		return FTL_FAILURE;
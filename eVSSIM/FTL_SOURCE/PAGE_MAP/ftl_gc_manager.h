@@ -9,14 +9,27 @@
 #include "ftl.h"
 
 typedef ftl_ret_val (*gc_collection_algo)(uint8_t, int, bool background);
-typedef ftl_ret_val (*gc_next_page_algo)(uint8_t, int, int, uint64_t*);
+typedef ftl_ret_val (*gc_next_page_algo)(uint8_t, int, int, int, uint64_t*);
 
 typedef struct gc_thread {
     pthread_t tid;
     uint8_t device_index;
+    pthread_mutex_t gc_signal_lock;
     pthread_cond_t gc_signal_cond;
     bool gc_stop_flag;
     uint64_t gc_loop_count;
+
+    // Victim block that was only partly collected, the next collection resumes it
+    bool victim_in_progress;
+    unsigned int victim_flash_nb;
+    uint64_t victim_block_nb;
+    uint64_t victim_next_page_nb;
+
+    // rand_r state of the d-choices victim policy
+    unsigned int victim_seed;
+
+    // Simulated time the last host request finished, idle periods are counted from it
+    int64_t last_host_io_us;
 } gc_thread_t;
 
 extern gc_thread_t *gc_threads;
@@ -27,8 +40,51 @@ extern gc_thread_t *gc_threads;
 void INIT_GC_MANAGER(uint8_t device_index);
 void TERM_GC_MANAGER(uint8_t device_index);
 
+/**
+ * Wake up the background GC thread, e.g. after pages were invalidated
+ */
+void WAKE_GC_THREAD(uint8_t device_index);
+
 bool GC_CHECK(uint8_t device_index, bool force, bool background);
 
+/**
+ * Called when a host request finishes, the device is busy until then
+ */
+void GC_NOTE_HOST_IO(uint8_t device_index);
+
+/**
+ * The host leaves the device alone for usec of simulated time, e.g. the think time between two
+ * requests of a trace. Once the device has been idle for gc_idle_usec, background operations run in
+ * the gap, and the clock then moves on to the end of the gap. Called without the device lock.
+ */
+void GC_IDLE(uint8_t device_index, int64_t usec);
+
+/**
+ * Background operations of an idle period that lasts until until_us: garbage collection while the
+ * free pages are below the low threshold, then wear leveling. Runs a page at a time and stops after
+ * gc_idle_budget_usec, a partly collected victim is resumed later. Returns whether any work was done.
+ */
+bool GC_IDLE_WORK(uint8_t device_index, int64_t until_us);
+
+/**
+ * Foreground GC of the incremental mode, called after every host write.
+ * Copies at most gc_incremental_page_nb valid pages, unless that would leave the GC reserve
+ * too small to finish the victim.
+ */
+bool GC_INCREMENTAL_STEP(uint8_t device_index);
+
+/**
+ * Static wear leveling. When the erase counts of the device spread by more than wear_leveling_threshold,
+ * moves the valid pages off the least erased full block and erases it, so the block joins the
+ * write rotation. Returns whether a block was migrated.
+ */
+bool WEAR_LEVELING_CHECK(uint8_t device_index, bool background);
+
+/**
+ * Put a partly collected victim back into the victim index, e.g. before saving a snapshot
+ */
+void RELEASE_GC_VICTIM(uint8_t device_index);
+
 /**
  * Default garbage collection algorithm
  */
@@ -46,7 +102,7 @@ typedef struct write_amplification_counters
 	unsigned long physical_block_write_counter;
 }write_amplification_counters;
 
-extern write_amplification_counters wa_counters;
+extern write_amplification_counters *wa_counters;
 
 /**
  * GC collection algorithm struct
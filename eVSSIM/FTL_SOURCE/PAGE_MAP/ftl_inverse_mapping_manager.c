@@ -5,13 +5,17 @@
 
 #include "common.h"
 #include "ftl_inverse_mapping_manager.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 inverse_mapping_manager_t* inverse_mappings_manager = NULL;
 
 void INIT_INVERSE_PAGE_MAPPING(uint8_t device_index)
 {
 	/* Allocation Memory for Inverse Page Mapping Table */
-	inverse_mappings_manager[device_index].inverse_page_mapping_table = calloc(devices[device_index].page_mapping_entry_nb, sizeof(uint64_t));
+	inverse_mappings_manager[device_index].inverse_page_mapping_table = calloc(devices[device_index].page_mapping_entry_nb, devices[device_index].mapping_entry_size);
 	if (inverse_mappings_manager[device_index].inverse_page_mapping_table == NULL)
 		RERR(, "Calloc mapping table fail\n");
 
@@ -23,15 +27,13 @@ void INIT_INVERSE_PAGE_MAPPING(uint8_t device_index)
 	FILE* fp = fopen(filename, "r");
 	free(filename);
 	if (READ_MAPPING_INFO_FROM_FILES && fp != NULL) {
-		if(fread(inverse_mappings_manager[device_index].inverse_page_mapping_table, sizeof(uint64_t), devices[device_index].page_mapping_entry_nb, fp) <= 0)
+		if(fread(inverse_mappings_manager[device_index].inverse_page_mapping_table, devices[device_index].mapping_entry_size, devices[device_index].page_mapping_entry_nb, fp) <= 0)
 			PERR("fread\n");
 		fclose(fp);
 	}
 	else{
-		uint64_t i;
-		for(i=0;i < devices[device_index].page_mapping_entry_nb;i++){
-			inverse_mappings_manager[device_index].inverse_page_mapping_table[i] = -1;
-		}
+		RESET_MAPPING_ENTRIES(inverse_mappings_manager[device_index].inverse_page_mapping_table,
+			devices[device_index].mapping_entry_size, devices[device_index].page_mapping_entry_nb);
 	}
 }
 
@@ -63,6 +65,7 @@ void INIT_INVERSE_BLOCK_MAPPING(uint8_t device_index)
 			curr_mapping_entry->valid_page_nb	= 0;
 			curr_mapping_entry->dirty_page_nb = 0;
 			curr_mapping_entry->erase_count		= 0;
+			curr_mapping_entry->last_invalidation_time = 0;
 			curr_mapping_entry->victim = NULL;
 			curr_mapping_entry += 1;
 		}
@@ -72,8 +75,21 @@ void INIT_INVERSE_BLOCK_MAPPING(uint8_t device_index)
 void INIT_VALID_ARRAY(uint8_t device_index)
 {
 	uint64_t i;
-	inverse_block_mapping_entry* curr_mapping_entry = inverse_mappings_manager[device_index].inverse_block_mapping_table_start;
-	char* valid_array;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	inverse_block_mapping_entry* curr_mapping_entry = manager->inverse_block_mapping_table_start;
+	uint64_t block_word_nb;
+
+	/* Two bits per page: valid, and programmed since the last erase */
+	manager->page_bitmap_word_nb = (devices[device_index].page_nb + 63) / 64;
+	block_word_nb = 2 * manager->page_bitmap_word_nb;
+	manager->page_state_bitmaps = calloc(devices[device_index].block_mapping_entry_nb * block_word_nb, sizeof(uint64_t));
+	if (manager->page_state_bitmaps == NULL)
+		RERR(, "Calloc mapping table fail\n");
+
+	for(i=0;i<devices[device_index].block_mapping_entry_nb;i++){
+		curr_mapping_entry->valid_bitmap = manager->page_state_bitmaps + i * block_word_nb;
+		curr_mapping_entry += 1;
+	}
 
 	char* filename = GET_DATA_FILENAME(device_index, "valid_array.dat");
 	if (filename == NULL)
@@ -82,25 +98,50 @@ void INIT_VALID_ARRAY(uint8_t device_index)
 	FILE* fp = fopen(filename, "r");
 	free(filename);
 	if(READ_MAPPING_INFO_FROM_FILES && fp != NULL){
-		for(i=0;i<devices[device_index].block_mapping_entry_nb;i++){
-			valid_array = calloc(devices[device_index].page_nb, sizeof(char));
-			if(fread(valid_array, sizeof(char), devices[device_index].page_nb, fp) <= 0)
-				PERR("fread\n");
-			curr_mapping_entry->valid_array = valid_array;
-
-			curr_mapping_entry += 1;
-		}
+		if(fread(manager->page_state_bitmaps, sizeof(uint64_t), devices[device_index].block_mapping_entry_nb * block_word_nb, fp) <= 0)
+			PERR("fread\n");
 		fclose(fp);
 	}
-	else{
-		for(i=0;i<devices[device_index].block_mapping_entry_nb;i++){
-			valid_array = calloc(devices[device_index].page_nb, sizeof(char));
-			memset(valid_array,0,devices[device_index].page_nb);
-			curr_mapping_entry->valid_array = valid_array;
+}
 
-			curr_mapping_entry += 1;
-		}
-	}
+static uint64_t _BLOCK_ID(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb)
+{
+	return phy_flash_nb * devices[device_index].block_nb + phy_block_nb;
+}
+
+static void _PUSH_EMPTY_BLOCK(uint8_t device_index, empty_block_root* root, uint64_t block_id)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t mapping_index = root - manager->empty_block_table_start;
+
+	root->ring[(root->head + root->empty_block_nb) % root->capacity] = block_id;
+	root->empty_block_nb++;
+	manager->free_plane_bitmap[mapping_index / 64] |= 1ULL << (mapping_index % 64);
+}
+
+/* No write stream has claimed a block of the plane yet */
+static void _RESET_STREAM_BLOCKS(empty_block_root* root)
+{
+	int stream;
+
+	for(stream=0; stream<WRITE_STREAM_NB; stream++)
+		root->stream_block[stream] = NO_STREAM_BLOCK;
+}
+
+/* First plane with free blocks in [start, end) and then in [begin, start), or UINT64_MAX */
+static uint64_t _FIND_FREE_PLANE(uint8_t device_index, uint64_t begin, uint64_t start, uint64_t end)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t mapping_index = NEXT_SET_BIT(manager->free_plane_bitmap, manager->free_plane_word_nb, start);
+
+	if (mapping_index < end)
+		return mapping_index;
+
+	mapping_index = NEXT_SET_BIT(manager->free_plane_bitmap, manager->free_plane_word_nb, begin);
+	if (mapping_index < start)
+		return mapping_index;
+
+	return UINT64_MAX;
 }
 
 void INIT_EMPTY_BLOCK_LIST(uint8_t device_index)
@@ -109,11 +150,20 @@ void INIT_EMPTY_BLOCK_LIST(uint8_t device_index)
 
 	empty_block_entry* curr_entry;
 	empty_block_root* curr_root;
-
-	inverse_mappings_manager[device_index].empty_block_table_start = calloc(devices[device_index].planes_per_flash * devices[device_index].flash_nb, sizeof(empty_block_root));
-	if (inverse_mappings_manager[device_index].empty_block_table_start == NULL)
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+
+	manager->empty_block_table_start = calloc(devices[device_index].planes_per_flash * devices[device_index].flash_nb, sizeof(empty_block_root));
+	manager->empty_block_entries = calloc(devices[device_index].block_mapping_entry_nb, sizeof(empty_block_entry));
+	manager->empty_block_ring = calloc(devices[device_index].block_mapping_entry_nb, sizeof(uint64_t));
+	manager->free_plane_word_nb = (devices[device_index].planes_per_flash * devices[device_index].flash_nb + 63) / 64;
+	manager->free_plane_bitmap = calloc(manager->free_plane_word_nb, sizeof(uint64_t));
+	if (manager->empty_block_table_start == NULL || manager->empty_block_entries == NULL ||
+			manager->empty_block_ring == NULL || manager->free_plane_bitmap == NULL)
 		RERR(, "Calloc mapping table fail\n");
 
+	/* Every plane owns a ring slice large enough for all of its blocks */
+	uint64_t plane_capacity = (devices[device_index].block_nb + devices[device_index].planes_per_flash - 1) / devices[device_index].planes_per_flash;
+
 	char* filename = GET_DATA_FILENAME(device_index, "empty_block_list.dat");
 	if (filename == NULL)
 		RERR(, "GET_DATA_FILENAME failed\n");
@@ -121,84 +171,134 @@ void INIT_EMPTY_BLOCK_LIST(uint8_t device_index)
 	FILE* fp = fopen(filename, "r");
 	free(filename);
 	if(READ_MAPPING_INFO_FROM_FILES && fp != NULL){
-		inverse_mappings_manager[device_index].total_zero_page_nb = 0;
-		if(fread(inverse_mappings_manager[device_index].empty_block_table_start,sizeof(empty_block_root),devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
+		manager->total_zero_page_nb = 0;
+		if(fread(manager->empty_block_table_start,sizeof(empty_block_root),devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
 			PERR("fread\n");
-		curr_root = inverse_mappings_manager[device_index].empty_block_table_start;
+		curr_root = manager->empty_block_table_start;
 
 		for(i=0;i<devices[device_index].planes_per_flash;i++){
 
 			for(j=0;j<devices[device_index].flash_nb;j++){
 
+				/* The ring layout on disk is stale; rebuild it from the entries */
 				k = curr_root->empty_block_nb;
+				curr_root->ring = manager->empty_block_ring + (i * devices[device_index].flash_nb + j) * plane_capacity;
+				curr_root->capacity = plane_capacity;
+				curr_root->head = 0;
+				curr_root->empty_block_nb = 0;
+				_RESET_STREAM_BLOCKS(curr_root);
 				while(k > 0){
-					curr_entry = calloc(1, sizeof(empty_block_entry));
-					if(curr_entry == NULL){
-						PERR("Calloc fail\n");
+					empty_block_entry entry;
+					if(fread(&entry, sizeof(empty_block_entry), 1, fp) <= 0){
+						PERR("fread\n");
 						break;
 					}
 
-					if(fread(curr_entry, sizeof(empty_block_entry), 1, fp) <= 0)
-						PERR("fread\n");
-					curr_entry->next = NULL;
-
-					if(k == curr_root->empty_block_nb){
-						curr_root->next = curr_entry;
-						curr_root->tail = curr_entry;
-					}
-					else{
-						curr_root->tail->next = curr_entry;
-						curr_root->tail = curr_entry;
-					}
-					inverse_mappings_manager[device_index].total_zero_page_nb += curr_entry->curr_phy_page_nb;
+					uint64_t block_id = _BLOCK_ID(device_index, entry.phy_flash_nb, entry.phy_block_nb);
+					manager->empty_block_entries[block_id] = entry;
+					_PUSH_EMPTY_BLOCK(device_index, curr_root, block_id);
+					manager->total_zero_page_nb += entry.curr_phy_page_nb;
 					k--;
 				}
 				curr_root += 1;
 			}
 		}
-		inverse_mappings_manager[device_index].empty_block_table_index = 0;
+		manager->empty_block_table_index = 0;
 		fclose(fp);
 	}
 	else{
-		curr_root = inverse_mappings_manager[device_index].empty_block_table_start;
+		curr_root = manager->empty_block_table_start;
 
 		for(i=0;i<devices[device_index].planes_per_flash;i++){
 
 			for(j=0;j<devices[device_index].flash_nb;j++){
 
-				for(k=i; k < devices[device_index].block_nb; k+=devices[device_index].planes_per_flash){
-
-					curr_entry = calloc(1, sizeof(empty_block_entry));
-					if(curr_entry == NULL){
-						PERR("Calloc fail\n");
-						break;
-					}
+				curr_root->ring = manager->empty_block_ring + (i * devices[device_index].flash_nb + j) * plane_capacity;
+				curr_root->capacity = plane_capacity;
+				curr_root->head = 0;
+				_RESET_STREAM_BLOCKS(curr_root);
 
-					if(k==i){
-						curr_root->next = curr_entry;
-						curr_root->tail = curr_entry;
+				for(k=i; k < devices[device_index].block_nb; k+=devices[device_index].planes_per_flash){
 
-						curr_root->tail->phy_flash_nb = j;
-						curr_root->tail->phy_block_nb = k;
-						curr_root->tail->curr_phy_page_nb = 0;
-					}
-					else{
-						curr_root->tail->next = curr_entry;
-						curr_root->tail = curr_entry;
+					uint64_t block_id = _BLOCK_ID(device_index, j, k);
+					curr_entry = manager->empty_block_entries + block_id;
+					curr_entry->phy_flash_nb = j;
+					curr_entry->phy_block_nb = k;
+					curr_entry->curr_phy_page_nb = 0;
+					_PUSH_EMPTY_BLOCK(device_index, curr_root, block_id);
 
-						curr_root->tail->phy_flash_nb = j;
-						curr_root->tail->phy_block_nb = k;
-						curr_root->tail->curr_phy_page_nb = 0;
-					}
 					UPDATE_INVERSE_BLOCK_MAPPING(device_index, j, k, EMPTY_BLOCK);
 				}
-				curr_root->empty_block_nb = (unsigned int)devices[device_index].each_empty_table_entry_nb;
 				curr_root += 1;
 			}
 		}
-		inverse_mappings_manager[device_index].total_zero_page_nb = devices[device_index].pages_in_ssd;
-		inverse_mappings_manager[device_index].empty_block_table_index = 0;
+		manager->total_zero_page_nb = devices[device_index].pages_in_ssd;
+		manager->empty_block_table_index = 0;
+	}
+}
+
+static victim_block_root* _GET_VICTIM_ROOT(uint8_t device_index, victim_block_entry* victim_block, int link)
+{
+	if(link == VICTIM_GLOBAL_LINK)
+		return &inverse_mappings_manager[device_index].victim_block_index;
+
+	uint64_t plane_nb = victim_block->phy_block_nb % devices[device_index].planes_per_flash;
+	return inverse_mappings_manager[device_index].victim_block_table_start + plane_nb * devices[device_index].flash_nb + victim_block->phy_flash_nb;
+}
+
+static void _LINK_VICTIM_BLOCK(victim_block_root* root, victim_block_entry* victim_block, int link)
+{
+	uint64_t bucket = victim_block->bucket;
+	victim_block_entry* head = root->buckets[bucket];
+
+	victim_block->links[link].prev = NULL;
+	victim_block->links[link].next = head;
+	if(head != NULL)
+		head->links[link].prev = victim_block;
+	root->buckets[bucket] = victim_block;
+	root->bucket_bitmap[bucket / 64] |= 1ULL << (bucket % 64);
+}
+
+static void _UNLINK_VICTIM_BLOCK(victim_block_root* root, victim_block_entry* victim_block, int link)
+{
+	uint64_t bucket = victim_block->bucket;
+	victim_block_link* curr_link = &victim_block->links[link];
+
+	if(curr_link->prev != NULL)
+		curr_link->prev->links[link].next = curr_link->next;
+	else
+		root->buckets[bucket] = curr_link->next;
+	if(curr_link->next != NULL)
+		curr_link->next->links[link].prev = curr_link->prev;
+
+	if(root->buckets[bucket] == NULL)
+		root->bucket_bitmap[bucket / 64] &= ~(1ULL << (bucket % 64));
+
+	curr_link->prev = NULL;
+	curr_link->next = NULL;
+}
+
+/* Hand every victim index its own slice of the bucket storage */
+static void _INIT_VICTIM_ROOT(uint8_t device_index, victim_block_root* root, uint64_t root_nb)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+
+	root->buckets = manager->victim_buckets + root_nb * (devices[device_index].page_nb + 1);
+	root->bucket_bitmap = manager->victim_bucket_bitmaps + root_nb * manager->victim_bucket_word_nb;
+	root->victim_block_nb = 0;
+}
+
+static void _ADD_VICTIM_BLOCK(uint8_t device_index, victim_block_entry* victim_block)
+{
+	int link;
+
+	victim_block->bucket = *(victim_block->valid_page_nb);
+	for(link=0;link<VICTIM_LINK_NB;link++){
+		victim_block_root* root = _GET_VICTIM_ROOT(device_index, victim_block, link);
+		_LINK_VICTIM_BLOCK(root, victim_block, link);
+		root->victim_block_nb++;
 	}
+	inverse_mappings_manager[device_index].total_victim_block_nb++;
 }
 
 void INIT_VICTIM_BLOCK_LIST(uint8_t device_index)
@@ -207,9 +307,16 @@ void INIT_VICTIM_BLOCK_LIST(uint8_t device_index)
 
 	victim_block_entry* curr_entry;
 	victim_block_root* curr_root;
-
-	inverse_mappings_manager[device_index].victim_block_table_start = calloc(devices[device_index].planes_per_flash * devices[device_index].flash_nb, sizeof(victim_block_root));
-	if (inverse_mappings_manager[device_index].victim_block_table_start == NULL)
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t root_nb = devices[device_index].planes_per_flash * devices[device_index].flash_nb;
+
+	manager->victim_bucket_word_nb = (devices[device_index].page_nb + 1 + 63) / 64;
+	manager->victim_block_table_start = calloc(root_nb, sizeof(victim_block_root));
+	manager->victim_block_entries = calloc(devices[device_index].block_mapping_entry_nb, sizeof(victim_block_entry));
+	manager->victim_buckets = calloc((root_nb + 1) * (devices[device_index].page_nb + 1), sizeof(victim_block_entry*));
+	manager->victim_bucket_bitmaps = calloc((root_nb + 1) * manager->victim_bucket_word_nb, sizeof(uint64_t));
+	if (manager->victim_block_table_start == NULL || manager->victim_block_entries == NULL ||
+			manager->victim_buckets == NULL || manager->victim_bucket_bitmaps == NULL)
 		RERR(, "Calloc mapping table fail\n");
 
 	char* filename = GET_DATA_FILENAME(device_index, "victim_block_list.dat");
@@ -219,38 +326,45 @@ void INIT_VICTIM_BLOCK_LIST(uint8_t device_index)
 	FILE* fp = fopen(filename, "r");
 	free(filename);
 	if(READ_MAPPING_INFO_FROM_FILES && fp != NULL){
-		inverse_mappings_manager[device_index].total_victim_block_nb = 0;
-		if(fread(inverse_mappings_manager[device_index].victim_block_table_start, sizeof(victim_block_root), devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
+		if(fread(manager->victim_block_table_start, sizeof(victim_block_root), root_nb, fp) <= 0)
 			PERR("fread\n");
-		curr_root = inverse_mappings_manager[device_index].victim_block_table_start;
+	}
+
+	/* The bucket pointers on disk are stale, only the block counts are kept */
+	uint64_t* saved_block_nb = calloc(root_nb, sizeof(uint64_t));
+	if (saved_block_nb == NULL)
+		RERR(, "Calloc fail\n");
+	for(i=0;i<root_nb;i++){
+		if(READ_MAPPING_INFO_FROM_FILES && fp != NULL)
+			saved_block_nb[i] = manager->victim_block_table_start[i].victim_block_nb;
+		_INIT_VICTIM_ROOT(device_index, manager->victim_block_table_start + i, i);
+	}
+	_INIT_VICTIM_ROOT(device_index, &manager->victim_block_index, root_nb);
+	manager->total_victim_block_nb = 0;
+	manager->victim_block_seq = 0;
+
+	if(READ_MAPPING_INFO_FROM_FILES && fp != NULL){
+		curr_root = manager->victim_block_table_start;
 
 		for(i=0;i<devices[device_index].planes_per_flash;i++){
 
 			for(j=0;j<devices[device_index].flash_nb;j++){
 
-				inverse_mappings_manager[device_index].total_victim_block_nb += curr_root->victim_block_nb;
-				k = curr_root->victim_block_nb;
+				k = saved_block_nb[curr_root - manager->victim_block_table_start];
 				while(k > 0){
-					curr_entry = calloc(1, sizeof(victim_block_entry));
-					if(curr_entry == NULL){
-						PERR("Calloc fail\n");
+					victim_block_entry entry;
+					if(fread(&entry, sizeof(victim_block_entry), 1, fp) <= 0){
+						PERR("fread\n");
 						break;
 					}
 
-					if(fread(curr_entry, sizeof(victim_block_entry), 1, fp) <= 0)
-						PERR("fread\n");
-					curr_entry->next = NULL;
-					curr_entry->prev = NULL;
-
-					if(k == curr_root->victim_block_nb){
-						curr_root->next = curr_entry;
-						curr_root->tail = curr_entry;
-					}
-					else{
-						curr_root->tail->next = curr_entry;
-						curr_entry->prev = curr_root->tail;
-						curr_root->tail = curr_entry;
-					}
+					inverse_block_mapping_entry* inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, entry.phy_flash_nb, entry.phy_block_nb);
+					curr_entry = manager->victim_block_entries + _BLOCK_ID(device_index, entry.phy_flash_nb, entry.phy_block_nb);
+					curr_entry->phy_flash_nb = entry.phy_flash_nb;
+					curr_entry->phy_block_nb = entry.phy_block_nb;
+					curr_entry->valid_page_nb = &(inverse_block_entry->valid_page_nb);
+					inverse_block_entry->victim = curr_entry;
+					_ADD_VICTIM_BLOCK(device_index, curr_entry);
 					k--;
 				}
 				curr_root += 1;
@@ -258,22 +372,7 @@ void INIT_VICTIM_BLOCK_LIST(uint8_t device_index)
 		}
 		fclose(fp);
 	}
-	else{
-		curr_root = inverse_mappings_manager[device_index].victim_block_table_start;
-
-		for(i=0;i<devices[device_index].planes_per_flash;i++){
-
-			for(j=0;j<devices[device_index].flash_nb;j++){
-
-				curr_root->next = NULL;
-				curr_root->tail = NULL;
-				curr_root->victim_block_nb = 0;
-
-				curr_root += 1;
-			}
-		}
-		inverse_mappings_manager[device_index].total_victim_block_nb = 0;
-	}
+	free(saved_block_nb);
 }
 
 void TERM_INVERSE_PAGE_MAPPING(uint8_t device_index)
@@ -288,7 +387,7 @@ void TERM_INVERSE_PAGE_MAPPING(uint8_t device_index)
 		RERR(, "File open fail\n");
 
 	/* Write The inverse page table to file */
-	if(fwrite(inverse_mappings_manager[device_index].inverse_page_mapping_table, sizeof(uint64_t), devices[device_index].page_mapping_entry_nb, fp) <= 0)
+	if(fwrite(inverse_mappings_manager[device_index].inverse_page_mapping_table, devices[device_index].mapping_entry_size, devices[device_index].page_mapping_entry_nb, fp) <= 0)
 		PERR("fwrite\n");
 	fclose(fp);
 
@@ -318,9 +417,7 @@ void TERM_INVERSE_BLOCK_MAPPING(uint8_t device_index)
 
 void TERM_VALID_ARRAY(uint8_t device_index)
 {
-	uint64_t i;
-	inverse_block_mapping_entry* curr_mapping_entry = inverse_mappings_manager[device_index].inverse_block_mapping_table_start;
-	char* valid_array;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
 
 	char* filename = GET_DATA_FILENAME(device_index, "valid_array.dat");
 	if (filename == NULL)
@@ -331,22 +428,18 @@ void TERM_VALID_ARRAY(uint8_t device_index)
     if (fp == NULL)
 		RERR(, "File open fail\n");
 
-	for(i=0;i<devices[device_index].block_mapping_entry_nb;i++){
-		valid_array = curr_mapping_entry->valid_array;
-		if(fwrite(valid_array, sizeof(char), devices[device_index].page_nb, fp) <= 0)
-			PERR("fwrite\n");
-		curr_mapping_entry += 1;
-		free(valid_array);
-	}
+	if(fwrite(manager->page_state_bitmaps, sizeof(uint64_t), devices[device_index].block_mapping_entry_nb * 2 * manager->page_bitmap_word_nb, fp) <= 0)
+		PERR("fwrite\n");
 	fclose(fp);
+	free(manager->page_state_bitmaps);
 }
 
 void TERM_EMPTY_BLOCK_LIST(uint8_t device_index)
 {
 	uint64_t i, j, k;
 
-	empty_block_entry* curr_entry, *tmp_entry;
 	empty_block_root* curr_root;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
 
 	char* filename = GET_DATA_FILENAME(device_index, "empty_block_list.dat");
 	if (filename == NULL)
@@ -357,41 +450,37 @@ void TERM_EMPTY_BLOCK_LIST(uint8_t device_index)
 	if (fp == NULL)
 		RERR(, "File open fail\n");
 
-	if(fwrite(inverse_mappings_manager[device_index].empty_block_table_start,sizeof(empty_block_root),devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
+	if(fwrite(manager->empty_block_table_start,sizeof(empty_block_root),devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
 		PERR("fwrite\n");
 
-	curr_root = inverse_mappings_manager[device_index].empty_block_table_start;
+	curr_root = manager->empty_block_table_start;
 	for(i=0;i<devices[device_index].planes_per_flash;i++){
 
 		for(j=0;j<devices[device_index].flash_nb;j++){
 
-			k = curr_root->empty_block_nb;
-			if(k != 0){
-				curr_entry = curr_root->next;
-			}
-			while(k > 0){
-
-				if(fwrite(curr_entry, sizeof(empty_block_entry), 1, fp) <= 0)
+			/* Entries are written in allocation order so a reload keeps the FIFO */
+			for(k=0;k<curr_root->empty_block_nb;k++){
+				uint64_t block_id = curr_root->ring[(curr_root->head + k) % curr_root->capacity];
+				if(fwrite(manager->empty_block_entries + block_id, sizeof(empty_block_entry), 1, fp) <= 0)
 					PERR("fwrite\n");
-
-				tmp_entry = curr_entry->next;
-				free(curr_entry);
-				curr_entry = tmp_entry;
-				k--;
 			}
 			curr_root += 1;
 		}
 	}
 	fclose(fp);
-	free(inverse_mappings_manager[device_index].empty_block_table_start);
+	free(manager->free_plane_bitmap);
+	free(manager->empty_block_ring);
+	free(manager->empty_block_entries);
+	free(manager->empty_block_table_start);
 }
 
 void TERM_VICTIM_BLOCK_LIST(uint8_t device_index)
 {
 	uint64_t i, j, k;
 
-	victim_block_entry* curr_entry, *tmp_entry;
+	victim_block_entry* curr_entry;
 	victim_block_root* curr_root;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
 
 	char* filename = GET_DATA_FILENAME(device_index, "victim_block_list.dat");
 	if (filename == NULL)
@@ -402,33 +491,320 @@ void TERM_VICTIM_BLOCK_LIST(uint8_t device_index)
 	if (fp == NULL)
 		RERR(, "File open fail\n");
 
-	if(fwrite(inverse_mappings_manager[device_index].victim_block_table_start, sizeof(victim_block_root), devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
+	if(fwrite(manager->victim_block_table_start, sizeof(victim_block_root), devices[device_index].planes_per_flash*devices[device_index].flash_nb, fp) <= 0)
 		PERR("fwrite\n");
 
-	curr_root = inverse_mappings_manager[device_index].victim_block_table_start;
+	curr_root = manager->victim_block_table_start;
 	for(i=0;i<devices[device_index].planes_per_flash;i++){
 
 		for(j=0;j<devices[device_index].flash_nb;j++){
 
-			k = curr_root->victim_block_nb;
-			if(k != 0){
-				curr_entry = curr_root->next;
-			}
-			while(k > 0){
-
-				if(fwrite(curr_entry, sizeof(victim_block_entry), 1, fp) <= 0)
-					PERR("fwrite\n");
+			for(k=0;k<=devices[device_index].page_nb;k++){
 
-				tmp_entry = curr_entry->next;
-				free(curr_entry);
-				curr_entry = tmp_entry;
-				k--;
+				for(curr_entry = curr_root->buckets[k]; curr_entry != NULL; curr_entry = curr_entry->links[VICTIM_PLANE_LINK].next){
+					if(fwrite(curr_entry, sizeof(victim_block_entry), 1, fp) <= 0)
+						PERR("fwrite\n");
+				}
 			}
 			curr_root += 1;
 		}
 	}
 	fclose(fp);
-	free(inverse_mappings_manager[device_index].victim_block_table_start);
+	free(manager->victim_bucket_bitmaps);
+	free(manager->victim_buckets);
+	free(manager->victim_block_entries);
+	free(manager->victim_block_table_start);
+}
+
+static uint64_t _SNAPSHOT_ALIGN(uint64_t offset)
+{
+	return (offset + FTL_SNAPSHOT_ALIGN - 1) & ~(uint64_t)(FTL_SNAPSHOT_ALIGN - 1);
+}
+
+/* Fills in the identity and the section layout of the snapshot of a device */
+static void _SNAPSHOT_LAYOUT(uint8_t device_index, ftl_snapshot_header_t* header)
+{
+	ssd_config_t* device = &devices[device_index];
+	uint64_t root_nb = device->planes_per_flash * device->flash_nb;
+
+	memset(header, 0, sizeof(*header));
+	header->magic = FTL_SNAPSHOT_MAGIC;
+	header->version = FTL_SNAPSHOT_VERSION;
+	header->mapping_entry_size = device->mapping_entry_size;
+	header->flash_nb = device->flash_nb;
+	header->block_nb = device->block_nb;
+	header->page_nb = device->page_nb;
+	header->planes_per_flash = device->planes_per_flash;
+	header->page_mapping_entry_nb = device->page_mapping_entry_nb;
+
+	header->inverse_page_offset = _SNAPSHOT_ALIGN(sizeof(*header));
+	header->block_offset = _SNAPSHOT_ALIGN(header->inverse_page_offset + device->page_mapping_entry_nb * device->mapping_entry_size);
+	header->page_state_offset = _SNAPSHOT_ALIGN(header->block_offset + device->block_mapping_entry_nb * sizeof(ftl_snapshot_block_t));
+	header->empty_list_offset = _SNAPSHOT_ALIGN(header->page_state_offset +
+			device->block_mapping_entry_nb * 2 * inverse_mappings_manager[device_index].page_bitmap_word_nb * sizeof(uint64_t));
+	/* Free block counts of every plane, then the block ids of all planes in FIFO order */
+	header->file_size = header->empty_list_offset + (root_nb + device->block_mapping_entry_nb) * sizeof(uint64_t);
+}
+
+ftl_ret_val SAVE_FTL_SNAPSHOT(uint8_t device_index)
+{
+	uint64_t i, k;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t root_nb = devices[device_index].planes_per_flash * devices[device_index].flash_nb;
+	ftl_snapshot_header_t header;
+
+	_SNAPSHOT_LAYOUT(device_index, &header);
+	header.total_zero_page_nb = manager->total_zero_page_nb;
+	header.empty_block_table_index = manager->empty_block_table_index;
+
+	char* filename = GET_DATA_FILENAME(device_index, "ftl_snapshot.dat");
+	if (filename == NULL)
+		RERR(FTL_FAILURE, "GET_DATA_FILENAME failed\n");
+
+	int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	free(filename);
+	if (fd < 0)
+		RERR(FTL_FAILURE, "File open fail\n");
+
+	if (ftruncate(fd, header.file_size) != 0){
+		close(fd);
+		RERR(FTL_FAILURE, "ftruncate failed\n");
+	}
+
+	uint8_t* image = mmap(NULL, header.file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (image == MAP_FAILED)
+		RERR(FTL_FAILURE, "mmap failed\n");
+
+	memcpy(image + header.inverse_page_offset, manager->inverse_page_mapping_table, devices[device_index].page_mapping_entry_nb * devices[device_index].mapping_entry_size);
+
+	ftl_snapshot_block_t* blocks = (ftl_snapshot_block_t*)(image + header.block_offset);
+	for (i = 0; i < devices[device_index].block_mapping_entry_nb; i++){
+		inverse_block_mapping_entry* entry = manager->inverse_block_mapping_table_start + i;
+
+		blocks[i].valid_page_nb = entry->valid_page_nb;
+		blocks[i].dirty_page_nb = entry->dirty_page_nb;
+		blocks[i].curr_phy_page_nb = manager->empty_block_entries[i].curr_phy_page_nb;
+		blocks[i].type = entry->type;
+		blocks[i].erase_count = entry->erase_count;
+		blocks[i].flags = entry->victim != NULL ? FTL_SNAPSHOT_BLOCK_VICTIM : 0;
+		blocks[i].last_invalidation_time = entry->last_invalidation_time;
+		blocks[i].victim_seq = entry->victim != NULL ? entry->victim->seq : 0;
+	}
+
+	memcpy(image + header.page_state_offset, manager->page_state_bitmaps, devices[device_index].block_mapping_entry_nb * 2 * manager->page_bitmap_word_nb * sizeof(uint64_t));
+
+	uint64_t* empty_counts = (uint64_t*)(image + header.empty_list_offset);
+	uint64_t* empty_ids = empty_counts + root_nb;
+	for (i = 0; i < root_nb; i++){
+		empty_block_root* root = manager->empty_block_table_start + i;
+
+		empty_counts[i] = root->empty_block_nb;
+		for (k = 0; k < root->empty_block_nb; k++)
+			*empty_ids++ = root->ring[(root->head + k) % root->capacity];
+	}
+
+	/* The header goes last, so a torn snapshot is never taken for a valid one */
+	memcpy(image, &header, sizeof(header));
+	if (msync(image, header.file_size, MS_SYNC) != 0)
+		PERR("msync failed\n");
+	munmap(image, header.file_size);
+
+	return FTL_SUCCESS;
+}
+
+static bool _SNAPSHOT_IS_VALID(uint8_t device_index, const uint8_t* image, uint64_t size)
+{
+	ftl_snapshot_header_t expected;
+	const ftl_snapshot_header_t* header = (const ftl_snapshot_header_t*)image;
+	uint64_t root_nb = devices[device_index].planes_per_flash * devices[device_index].flash_nb;
+	uint64_t i, empty_block_nb = 0;
+
+	if (size < sizeof(expected))
+		return false;
+
+	_SNAPSHOT_LAYOUT(device_index, &expected);
+	expected.total_zero_page_nb = header->total_zero_page_nb;
+	expected.empty_block_table_index = header->empty_block_table_index;
+	if (memcmp(&expected, header, sizeof(expected)) != 0 || size < header->file_size)
+		return false;
+
+	const uint64_t* empty_counts = (const uint64_t*)(image + header->empty_list_offset);
+	const uint64_t* empty_ids = empty_counts + root_nb;
+	for (i = 0; i < root_nb; i++){
+		empty_block_nb += empty_counts[i];
+		if (empty_counts[i] > inverse_mappings_manager[device_index].empty_block_table_start[i].capacity)
+			return false;
+	}
+	if (empty_block_nb > devices[device_index].block_mapping_entry_nb)
+		return false;
+	for (i = 0; i < empty_block_nb; i++){
+		if (empty_ids[i] >= devices[device_index].block_mapping_entry_nb)
+			return false;
+	}
+
+	/* The snapshot is only good together with the forward table it was taken with */
+	struct stat st;
+	char* filename = GET_DATA_FILENAME(device_index, devices[device_index].mapping_table_mmap ? "mapping_table.map" : "mapping_table.dat");
+	if (filename == NULL)
+		return false;
+	int ret = stat(filename, &st);
+	free(filename);
+
+	return ret == 0 && (uint64_t)st.st_size == devices[device_index].page_mapping_entry_nb * devices[device_index].mapping_entry_size;
+}
+
+ftl_ret_val LOAD_FTL_SNAPSHOT(uint8_t device_index)
+{
+	uint64_t i, k;
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t root_nb = devices[device_index].planes_per_flash * devices[device_index].flash_nb;
+
+	char* filename = GET_DATA_FILENAME(device_index, "ftl_snapshot.dat");
+	if (filename == NULL)
+		RERR(FTL_FAILURE, "GET_DATA_FILENAME failed\n");
+
+	int fd = open(filename, O_RDONLY);
+	if (fd < 0){
+		free(filename);
+		return FTL_FAILURE;
+	}
+
+	struct stat st;
+	uint8_t* image = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (image == MAP_FAILED || !_SNAPSHOT_IS_VALID(device_index, image, st.st_size)){
+		if (image != MAP_FAILED)
+			munmap(image, st.st_size);
+		free(filename);
+		DEV_PINFO(device_index, "ignoring a stale or foreign FTL snapshot\n");
+		return FTL_FAILURE;
+	}
+
+	const ftl_snapshot_header_t* header = (const ftl_snapshot_header_t*)image;
+
+	memcpy(manager->inverse_page_mapping_table, image + header->inverse_page_offset, devices[device_index].page_mapping_entry_nb * devices[device_index].mapping_entry_size);
+	memcpy(manager->page_state_bitmaps, image + header->page_state_offset, devices[device_index].block_mapping_entry_nb * 2 * manager->page_bitmap_word_nb * sizeof(uint64_t));
+
+	/* Rebuild the victim index from scratch */
+	memset(manager->victim_buckets, 0, (root_nb + 1) * (devices[device_index].page_nb + 1) * sizeof(victim_block_entry*));
+	memset(manager->victim_bucket_bitmaps, 0, (root_nb + 1) * manager->victim_bucket_word_nb * sizeof(uint64_t));
+	for (i = 0; i < root_nb; i++)
+		manager->victim_block_table_start[i].victim_block_nb = 0;
+	manager->victim_block_index.victim_block_nb = 0;
+	manager->total_victim_block_nb = 0;
+	manager->victim_block_seq = 0;
+
+	const ftl_snapshot_block_t* blocks = (const ftl_snapshot_block_t*)(image + header->block_offset);
+	for (i = 0; i < devices[device_index].block_mapping_entry_nb; i++){
+		inverse_block_mapping_entry* entry = manager->inverse_block_mapping_table_start + i;
+		unsigned int phy_flash_nb = i / devices[device_index].block_nb;
+		uint64_t phy_block_nb = i % devices[device_index].block_nb;
+
+		entry->valid_page_nb = blocks[i].valid_page_nb;
+		entry->dirty_page_nb = blocks[i].dirty_page_nb;
+		entry->type = blocks[i].type;
+		entry->erase_count = blocks[i].erase_count;
+		entry->last_invalidation_time = blocks[i].last_invalidation_time;
+		entry->victim = NULL;
+
+		manager->empty_block_entries[i].phy_flash_nb = phy_flash_nb;
+		manager->empty_block_entries[i].phy_block_nb = phy_block_nb;
+		manager->empty_block_entries[i].curr_phy_page_nb = blocks[i].curr_phy_page_nb;
+
+		if (blocks[i].flags & FTL_SNAPSHOT_BLOCK_VICTIM){
+			victim_block_entry* victim = manager->victim_block_entries + i;
+			victim->phy_flash_nb = phy_flash_nb;
+			victim->phy_block_nb = phy_block_nb;
+			victim->valid_page_nb = &entry->valid_page_nb;
+			victim->seq = blocks[i].victim_seq;
+			if (victim->seq >= manager->victim_block_seq)
+				manager->victim_block_seq = victim->seq + 1;
+			entry->victim = victim;
+			_ADD_VICTIM_BLOCK(device_index, victim);
+		}
+	}
+
+	const uint64_t* empty_counts = (const uint64_t*)(image + header->empty_list_offset);
+	const uint64_t* empty_ids = empty_counts + root_nb;
+	memset(manager->free_plane_bitmap, 0, manager->free_plane_word_nb * sizeof(uint64_t));
+	for (i = 0; i < root_nb; i++){
+		empty_block_root* root = manager->empty_block_table_start + i;
+
+		root->head = 0;
+		root->empty_block_nb = 0;
+		_RESET_STREAM_BLOCKS(root);
+		for (k = 0; k < empty_counts[i]; k++)
+			_PUSH_EMPTY_BLOCK(device_index, root, *empty_ids++);
+	}
+	manager->total_zero_page_nb = header->total_zero_page_nb;
+	manager->empty_block_table_index = header->empty_block_table_index;
+
+	munmap(image, st.st_size);
+
+	/* A snapshot is consumed once, a clean shutdown writes the next one */
+	unlink(filename);
+	free(filename);
+
+	return FTL_SUCCESS;
+}
+
+static bool _IS_STREAM_BLOCK(empty_block_root* root, uint64_t block_id)
+{
+	int stream;
+
+	for(stream=0; stream<WRITE_STREAM_NB; stream++){
+		if(root->stream_block[stream] == block_id)
+			return true;
+	}
+	return false;
+}
+
+/*
+ * The block a write stream allocates from in a plane. Without stream separation all the streams
+ * share the head of the ring. Otherwise a stream keeps the block it claimed until the block fills
+ * up. It then claims a partly written block nobody claimed (as left by a restart) before an
+ * erased one, the least erased one with dynamic wear leveling. When every free block of the
+ * plane is claimed already, the stream shares one.
+ */
+static empty_block_entry* _STREAM_BLOCK(uint8_t device_index, empty_block_root* root, int stream)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t i, pos, block_id;
+	uint64_t found_id = NO_STREAM_BLOCK;
+
+	if(!devices[device_index].write_stream_separation)
+		return manager->empty_block_entries + root->ring[root->head];
+
+	if(root->stream_block[stream] != NO_STREAM_BLOCK)
+		return manager->empty_block_entries + root->stream_block[stream];
+
+	for(i=0, pos=root->head; i<root->empty_block_nb; i++, pos++){
+		if(pos == root->capacity)
+			pos = 0;
+		block_id = root->ring[pos];
+		if(_IS_STREAM_BLOCK(root, block_id))
+			continue;
+		if(manager->empty_block_entries[block_id].curr_phy_page_nb != 0){
+			found_id = block_id;
+			break;
+		}
+		if(found_id == NO_STREAM_BLOCK)
+			found_id = block_id;
+		else if(devices[device_index].wear_leveling_dynamic &&
+				manager->inverse_block_mapping_table_start[block_id].erase_count < manager->inverse_block_mapping_table_start[found_id].erase_count)
+			found_id = block_id;
+	}
+
+	/* The plane has free blocks, so the head is claimed by another stream */
+	if(found_id == NO_STREAM_BLOCK)
+		return manager->empty_block_entries + root->ring[root->head];
+
+	root->stream_block[stream] = found_id;
+	return manager->empty_block_entries + found_id;
 }
 
 //If we're using the VICTIM_OVERALL option, then a candidate block
@@ -437,7 +813,14 @@ void TERM_VICTIM_BLOCK_LIST(uint8_t device_index)
 // all over again)
 empty_block_entry* GET_EMPTY_BLOCK(uint8_t device_index, int mode, uint64_t mapping_index)
 {
-	uint64_t input_mapping_index = mapping_index;
+	return GET_STREAM_EMPTY_BLOCK(device_index, mode, mapping_index, WRITE_STREAM_HOT);
+}
+
+empty_block_entry* GET_STREAM_EMPTY_BLOCK(uint8_t device_index, int mode, uint64_t mapping_index, int stream)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t table_entry_nb = devices[device_index].empty_table_entry_nb;
+	uint64_t found_index;
 
 	empty_block_root* curr_root_entry;
 
@@ -458,56 +841,44 @@ empty_block_entry* GET_EMPTY_BLOCK(uint8_t device_index, int mode, uint64_t mapp
 			break;
 	}
 
-	while(inverse_mappings_manager[device_index].total_zero_page_nb > min_zero_page_nb){
+	if(manager->total_zero_page_nb > min_zero_page_nb){
 
 		if (mode == VICTIM_OVERALL){
-			curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + inverse_mappings_manager[device_index].empty_block_table_index;
-			inverse_mappings_manager[device_index].empty_block_table_index++;
-			if(inverse_mappings_manager[device_index].empty_block_table_index == devices[device_index].empty_table_entry_nb){
-				inverse_mappings_manager[device_index].empty_block_table_index = 0;
-			}
+			/* Round robin: the first plane with free blocks at or after the cursor */
+			found_index = _FIND_FREE_PLANE(device_index, 0, manager->empty_block_table_index, table_entry_nb);
+			if(found_index != UINT64_MAX){
+				manager->empty_block_table_index = found_index + 1;
+				if(manager->empty_block_table_index == table_entry_nb){
+					manager->empty_block_table_index = 0;
+				}
 
-			if(curr_root_entry->empty_block_nb == 0){
-				continue;
-			}
-			else
-			{
-				return curr_root_entry->next;
+				curr_root_entry = manager->empty_block_table_start + found_index;
+				return _STREAM_BLOCK(device_index, curr_root_entry, stream);
 			}
 		}
 		else if(mode == VICTIM_INCHIP){
-			curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
-			if(curr_root_entry->empty_block_nb == 0){
-
-				mapping_index++;
-				if(mapping_index % devices[device_index].planes_per_flash == 0){
-					mapping_index = mapping_index - devices[device_index].planes_per_flash;
-				}
-				if (mapping_index == input_mapping_index)
-					RINFO(NULL, "There is no empty block\n");
-
-				continue;
-			}
-			else{
-				return curr_root_entry->next;
-			}
+			/* Wraps around within the aligned group of planes_per_flash indexes */
+			uint64_t group_start = mapping_index - mapping_index % devices[device_index].planes_per_flash;
+			found_index = _FIND_FREE_PLANE(device_index, group_start, mapping_index, group_start + devices[device_index].planes_per_flash);
+			if(found_index == UINT64_MAX)
+				RINFO(NULL, "There is no empty block\n");
+
+			curr_root_entry = manager->empty_block_table_start + found_index;
+			return _STREAM_BLOCK(device_index, curr_root_entry, stream);
 		}
 
 		else if(mode == VICTIM_NOPARAL){
 			//Seems to have a bug here, not used somewhere in the project at the moment.
-			curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
-			if(curr_root_entry->empty_block_nb == 0){
-
-				mapping_index++;
-				inverse_mappings_manager[device_index].empty_block_table_index++;
-				if (mapping_index == devices[device_index].empty_table_entry_nb) {
-					mapping_index = 0;
-					inverse_mappings_manager[device_index].empty_block_table_index = 0;
-				}
-				continue;
-			}
-			else{
-				return curr_root_entry->next;
+			found_index = _FIND_FREE_PLANE(device_index, 0, mapping_index, table_entry_nb);
+			if(found_index != UINT64_MAX){
+				/* The cursor follows the skipped planes and restarts on a wrap */
+				if(found_index >= mapping_index)
+					manager->empty_block_table_index += found_index - mapping_index;
+				else
+					manager->empty_block_table_index = found_index;
+
+				curr_root_entry = manager->empty_block_table_start + found_index;
+				return _STREAM_BLOCK(device_index, curr_root_entry, stream);
 			}
 		}
 	}
@@ -523,163 +894,156 @@ ftl_ret_val INSERT_EMPTY_BLOCK(uint8_t device_index, unsigned int phy_flash_nb,
 	empty_block_root* curr_root_entry;
 	empty_block_entry* new_empty_block;
 
-	new_empty_block = calloc(1, sizeof(empty_block_entry));
-	if (new_empty_block == NULL)
-
-		RERR(FTL_FAILURE, "Alloc new empty block fail\n");
-
+	uint64_t block_id = _BLOCK_ID(device_index, phy_flash_nb, phy_block_nb);
 
 	/* Init New empty block */
+	new_empty_block = inverse_mappings_manager[device_index].empty_block_entries + block_id;
 	new_empty_block->phy_flash_nb = phy_flash_nb;
 	new_empty_block->phy_block_nb = phy_block_nb;
-	new_empty_block->next = NULL;
+	new_empty_block->curr_phy_page_nb = 0;
 
 	plane_nb = phy_block_nb % devices[device_index].planes_per_flash;
 	mapping_index = plane_nb * devices[device_index].flash_nb + phy_flash_nb;
 
 	curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
 
-	if(curr_root_entry->empty_block_nb == 0){
-		curr_root_entry->next = new_empty_block;
-		curr_root_entry->tail = new_empty_block;
-		curr_root_entry->empty_block_nb = 1;
-	}
-	else{
-		curr_root_entry->tail->next = new_empty_block;
-		curr_root_entry->tail = new_empty_block;
-		curr_root_entry->empty_block_nb++;
-	}
+	if(curr_root_entry->empty_block_nb == curr_root_entry->capacity)
+		RERR(FTL_FAILURE, "Empty block list overflow\n");
+
+	_PUSH_EMPTY_BLOCK(device_index, curr_root_entry, block_id);
 	inverse_mappings_manager[device_index].total_zero_page_nb += devices[device_index].page_nb;
 
 	return FTL_SUCCESS;
 }
 
-ftl_ret_val INSERT_VICTIM_BLOCK(uint8_t device_index, empty_block_entry* full_block){
-
-	uint64_t mapping_index;
-	int plane_nb;
+/*
+ * Dynamic wear leveling: move the least erased free block of the plane to the head of its ring, so
+ * it is the next one pages are allocated from. The block it replaces takes its slot in the ring.
+ */
+static void _PICK_LEAST_WORN_HEAD(uint8_t device_index, empty_block_root* root)
+{
+	inverse_mapping_manager_t* manager = &inverse_mappings_manager[device_index];
+	uint64_t i, pos, best_pos = root->head;
+	unsigned int best_erase_count = manager->inverse_block_mapping_table_start[root->ring[root->head]].erase_count;
 
-	victim_block_root* curr_root_entry;
-	victim_block_entry* new_victim_block;
-	victim_block_entry* curr_min_victim_block;
+	/* A block already written to stays the head */
+	if(manager->empty_block_entries[root->ring[root->head]].curr_phy_page_nb != 0)
+		return;
 
-	inverse_block_mapping_entry* inverse_block_entry;
-	inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, full_block->phy_flash_nb, full_block->phy_block_nb);
+	for(i=1, pos=root->head+1; i<root->empty_block_nb; i++, pos++){
+		if(pos == root->capacity)
+			pos = 0;
+		if(manager->inverse_block_mapping_table_start[root->ring[pos]].erase_count < best_erase_count){
+			best_erase_count = manager->inverse_block_mapping_table_start[root->ring[pos]].erase_count;
+			best_pos = pos;
+		}
+	}
 
-	/* Alloc New victim block entry */
-	new_victim_block = calloc(1, sizeof(victim_block_entry));
-	if (new_victim_block == NULL) {
-		RERR(FTL_FAILURE, "Calloc fail\n");
+	if(best_pos != root->head){
+		uint64_t block_id = root->ring[best_pos];
+		root->ring[best_pos] = root->ring[root->head];
+		root->ring[root->head] = block_id;
 	}
+}
 
-	inverse_block_entry->victim = new_victim_block;
+void EJECT_EMPTY_BLOCK(uint8_t device_index, uint64_t mapping_index)
+{
+	empty_block_root* curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
+	int stream;
 
-	/* Copy the full block address */
-	new_victim_block->phy_flash_nb = full_block->phy_flash_nb;
-	new_victim_block->phy_block_nb = full_block->phy_block_nb;
-	new_victim_block->valid_page_nb = &(inverse_block_entry->valid_page_nb);
-	new_victim_block->prev = NULL;
-	new_victim_block->next = NULL;
+	if(curr_root_entry->empty_block_nb == 0)
+		RERR(, "Empty block list underflow\n");
 
-	plane_nb = full_block->phy_block_nb % devices[device_index].planes_per_flash;
-	mapping_index = plane_nb * devices[device_index].flash_nb + full_block->phy_flash_nb;
+	for(stream=0; stream<WRITE_STREAM_NB; stream++){
+		if(curr_root_entry->stream_block[stream] == curr_root_entry->ring[curr_root_entry->head])
+			curr_root_entry->stream_block[stream] = NO_STREAM_BLOCK;
+	}
 
-	curr_root_entry = inverse_mappings_manager[device_index].victim_block_table_start + mapping_index;
+	curr_root_entry->head++;
+	if(curr_root_entry->head == curr_root_entry->capacity)
+		curr_root_entry->head = 0;
+	curr_root_entry->empty_block_nb--;
+	if(curr_root_entry->empty_block_nb == 0)
+		inverse_mappings_manager[device_index].free_plane_bitmap[mapping_index / 64] &= ~(1ULL << (mapping_index % 64));
+	else if(devices[device_index].wear_leveling_dynamic)
+		_PICK_LEAST_WORN_HEAD(device_index, curr_root_entry);
+}
 
-	/* Update victim block list */
-	if(curr_root_entry->victim_block_nb == 0){
-		curr_root_entry->next = new_victim_block;
-		curr_root_entry->tail = new_victim_block;
-		curr_root_entry->victim_block_nb = 1;
+/* A stream block fills up anywhere in the ring, it is moved to the head and ejected from there */
+void EJECT_FULL_BLOCK(uint8_t device_index, uint64_t mapping_index, empty_block_entry* full_block)
+{
+	empty_block_root* curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
+	uint64_t block_id = _BLOCK_ID(device_index, full_block->phy_flash_nb, full_block->phy_block_nb);
+	uint64_t i, pos;
+
+	for(i=0, pos=curr_root_entry->head; i<curr_root_entry->empty_block_nb; i++, pos++){
+		if(pos == curr_root_entry->capacity)
+			pos = 0;
+		if(curr_root_entry->ring[pos] == block_id){
+			curr_root_entry->ring[pos] = curr_root_entry->ring[curr_root_entry->head];
+			curr_root_entry->ring[curr_root_entry->head] = block_id;
+			break;
+		}
 	}
-	else{
-		//search for node with at least the same number of valid_page_nb
-		curr_min_victim_block = curr_root_entry->next;
-
-		//if first valid_page_nb is larger, insert before
-		if(*(curr_min_victim_block->valid_page_nb) >= *(new_victim_block->valid_page_nb)){
-			curr_min_victim_block->prev = new_victim_block;
-			new_victim_block->next = curr_min_victim_block;
-
-			curr_root_entry->next = new_victim_block;
-		}else{//else, go over list and insert after
-			//find block to insert after
-			while(curr_min_victim_block->next != NULL && *(curr_min_victim_block->next->valid_page_nb) < *(new_victim_block->valid_page_nb)){
-				curr_min_victim_block = curr_min_victim_block->next;
-			}
 
-			//insert new_victim_block after curr_min_victim_block
-			new_victim_block->prev = curr_min_victim_block;
-			new_victim_block->next = curr_min_victim_block->next;
+	EJECT_EMPTY_BLOCK(device_index, mapping_index);
+}
 
-			if(curr_min_victim_block->next != NULL){
-				curr_min_victim_block->next->prev = new_victim_block;
-			}
-			curr_min_victim_block->next = new_victim_block;
+ftl_ret_val INSERT_VICTIM_BLOCK(uint8_t device_index, empty_block_entry* full_block){
 
-			if(new_victim_block->next == NULL){//if last in list
-				curr_root_entry->tail = new_victim_block;
-			}
+	victim_block_entry* new_victim_block;
 
-		}
+	inverse_block_mapping_entry* inverse_block_entry;
+	inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, full_block->phy_flash_nb, full_block->phy_block_nb);
 
-		curr_root_entry->victim_block_nb++;
-	}
+	/* Take the victim entry of this block from the pool */
+	new_victim_block = inverse_mappings_manager[device_index].victim_block_entries + _BLOCK_ID(device_index, full_block->phy_flash_nb, full_block->phy_block_nb);
 
-	/* Free the full empty block entry */
-	free(full_block);
+	inverse_block_entry->victim = new_victim_block;
 
-	/* Update the total number of victim block */
-	inverse_mappings_manager[device_index].total_victim_block_nb++;
+	/* Copy the full block address */
+	new_victim_block->phy_flash_nb = full_block->phy_flash_nb;
+	new_victim_block->phy_block_nb = full_block->phy_block_nb;
+	new_victim_block->valid_page_nb = &(inverse_block_entry->valid_page_nb);
+	new_victim_block->seq = inverse_mappings_manager[device_index].victim_block_seq++;
+
+	/* File it under its valid page count, this also updates the total */
+	_ADD_VICTIM_BLOCK(device_index, new_victim_block);
 
 	return FTL_SUCCESS;
 }
 
 int EJECT_VICTIM_BLOCK(uint8_t device_index, victim_block_entry* victim_block){
 
-	uint64_t mapping_index;
-	int plane_nb;
-
-	victim_block_root* curr_root_entry;
-
-	plane_nb = victim_block->phy_block_nb % devices[device_index].planes_per_flash;
-	mapping_index = plane_nb * devices[device_index].flash_nb + victim_block->phy_flash_nb;
+	int link;
 
 	inverse_block_mapping_entry* inverse_block_entry;
 	inverse_block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, victim_block->phy_flash_nb, victim_block->phy_block_nb);
 	inverse_block_entry->victim = NULL;
 
-	curr_root_entry = inverse_mappings_manager[device_index].victim_block_table_start + mapping_index;
-
-	/* Update victim block list */
-	if(victim_block == curr_root_entry->next){
-		if(curr_root_entry->victim_block_nb == 1){
-			curr_root_entry->next = NULL;
-			curr_root_entry->tail = NULL;
-		}
-		else{
-			curr_root_entry->next = victim_block->next;
-			curr_root_entry->next->prev = NULL;
-		}
+	/* Update victim block index */
+	for(link=0;link<VICTIM_LINK_NB;link++){
+		victim_block_root* root = _GET_VICTIM_ROOT(device_index, victim_block, link);
+		_UNLINK_VICTIM_BLOCK(root, victim_block, link);
+		root->victim_block_nb--;
 	}
-	else if(victim_block == curr_root_entry->tail){
-		curr_root_entry->tail = victim_block->prev;
-		curr_root_entry->tail->next = NULL;
-	}
-	else{
-		victim_block->prev->next = victim_block->next;
-		victim_block->next->prev = victim_block->prev;
-	}
-
-	curr_root_entry->victim_block_nb--;
 	inverse_mappings_manager[device_index].total_victim_block_nb--;
 
-	/* Free the victim block */
-	free(victim_block);
-
 	return FTL_SUCCESS;
 }
 
+victim_block_entry* GET_MIN_VICTIM_BLOCK(uint8_t device_index, victim_block_root* root)
+{
+	uint64_t i;
+
+	for(i=0;i<inverse_mappings_manager[device_index].victim_bucket_word_nb;i++){
+		if(root->bucket_bitmap[i] != 0)
+			return root->buckets[i * 64 + __builtin_ctzll(root->bucket_bitmap[i])];
+	}
+
+	return NULL;
+}
+
 inverse_block_mapping_entry* GET_INVERSE_BLOCK_MAPPING_ENTRY(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb){
 
 	uint64_t mapping_index = phy_flash_nb * devices[device_index].block_nb + phy_block_nb;
@@ -695,26 +1059,27 @@ void GET_INVERSE_MAPPING_INFO(uint8_t device_index, uint64_t ppn, uint64_t *o_lp
 		PERR("overflow!\n");
 	}
 
-  	*o_lpn = inverse_mappings_manager[device_index].inverse_page_mapping_table[ppn];
+  	*o_lpn = LOAD_MAPPING_ENTRY(inverse_mappings_manager[device_index].inverse_page_mapping_table, devices[device_index].mapping_entry_size, ppn);
 }
 
 int UPDATE_INVERSE_PAGE_MAPPING(uint8_t device_index, uint64_t ppn, uint64_t lpn)
 {
-	inverse_mappings_manager[device_index].inverse_page_mapping_table[ppn] = lpn;
+	STORE_MAPPING_ENTRY(inverse_mappings_manager[device_index].inverse_page_mapping_table, devices[device_index].mapping_entry_size, ppn, lpn);
 
 	return FTL_SUCCESS;
 }
 
 int UPDATE_INVERSE_BLOCK_MAPPING(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb, int type)
 {
-        uint64_t i;
         inverse_block_mapping_entry* mapping_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, phy_flash_nb, phy_block_nb);
 
         mapping_entry->type = type;
 
         if(type == EMPTY_BLOCK){
-                for(i=0;i<devices[device_index].page_nb;i++){
-                        UPDATE_INVERSE_BLOCK_VALIDITY(device_index, phy_flash_nb, phy_block_nb, i, PAGE_ZERO);
+                memset(mapping_entry->valid_bitmap, 0, 2 * inverse_mappings_manager[device_index].page_bitmap_word_nb * sizeof(uint64_t));
+                if(mapping_entry->valid_page_nb != 0){
+                        mapping_entry->valid_page_nb = 0;
+                        UPDATE_VICTIM_LIST(device_index, mapping_entry->victim);
                 }
         }
 
@@ -722,94 +1087,22 @@ int UPDATE_INVERSE_BLOCK_MAPPING(uint8_t device_index, unsigned int phy_flash_nb
 }
 
 void UPDATE_VICTIM_LIST(uint8_t device_index, victim_block_entry *victim_entry){
-	if(victim_entry == NULL){
+	int link;
+
+	if(victim_entry == NULL || victim_entry->bucket == *(victim_entry->valid_page_nb)){
 		return;
 	}
-	uint32_t plane_nb = victim_entry->phy_block_nb % devices[device_index].planes_per_flash;
-	uint64_t mapping_index = plane_nb * devices[device_index].flash_nb + victim_entry->phy_flash_nb;
-
-	victim_block_root* curr_root_entry = inverse_mappings_manager[device_index].victim_block_table_start + mapping_index;
-
-	victim_block_entry *curr_victim_entry;
-	//if victim_entry.valid_page_nb > victim_entry->next->valid_page_nb then need to go foward and find correct spot
-	if(victim_entry->next != NULL && *(victim_entry->valid_page_nb) > *(victim_entry->next->valid_page_nb)){
-		curr_victim_entry = victim_entry->next;
-
-		//remove victim_entry from list
-		if(victim_entry->prev != NULL){
-			victim_entry->prev->next = victim_entry->next;
-		}
-		if(victim_entry->next != NULL){
-			victim_entry->next->prev = victim_entry->prev;
-		}
-		if(curr_root_entry->next == victim_entry){
-			curr_root_entry->next = victim_entry->next;
-		}
-		if(curr_root_entry->tail == victim_entry){
-			curr_root_entry->tail = victim_entry->prev;
-		}
-
-		victim_entry->next = NULL;
-		victim_entry->prev = NULL;
-
-		//find block to insert after
-		while(curr_victim_entry->next != NULL && *(curr_victim_entry->next->valid_page_nb) < *(victim_entry->valid_page_nb)){
-			curr_victim_entry = curr_victim_entry->next;
-		}
-
-		//insert victim_entry after curr_victim_entry
-		victim_entry->prev = curr_victim_entry;
-		victim_entry->next = curr_victim_entry->next;
-
-		if(curr_victim_entry->next){
-			curr_victim_entry->next->prev = victim_entry;
-		}
-		curr_victim_entry->next = victim_entry;
-
-		if(victim_entry->next == NULL){//if last in list
-			curr_root_entry->tail = victim_entry;
-		}
-
-	}else if(victim_entry->prev != NULL && *(victim_entry->valid_page_nb) < *(victim_entry->prev->valid_page_nb)){//if victim_entry.valid_page_nb > victim_entry->prev->valid_page_nb then need to go back and find correct spot
-		curr_victim_entry = victim_entry->prev;
-
-		//remove victim_entry from list
-		if(victim_entry->prev != NULL){
-			victim_entry->prev->next = victim_entry->next;
-		}
-		if(victim_entry->next != NULL){
-			victim_entry->next->prev = victim_entry->prev;
-		}
-		if(curr_root_entry->next == victim_entry){
-			curr_root_entry->next = victim_entry->next;
-		}
-		if(curr_root_entry->tail == victim_entry){
-			curr_root_entry->tail = victim_entry->prev;
-		}
-
-		victim_entry->next = NULL;
-		victim_entry->prev = NULL;
-
-		//find block to insert after
-		while(curr_victim_entry->prev != NULL && *(curr_victim_entry->prev->valid_page_nb) > *(victim_entry->valid_page_nb)){
-			curr_victim_entry = curr_victim_entry->prev;
-		}
-
-		//insert victim_entry after curr_victim_entry
-		victim_entry->next = curr_victim_entry;//
-		victim_entry->prev = curr_victim_entry->prev;
-
-		if(curr_victim_entry->prev != NULL){
-			curr_victim_entry->prev->next = victim_entry;
-		}
-		curr_victim_entry->prev = victim_entry;
-
-		if(victim_entry->prev == NULL){//if last in list
-			curr_root_entry->next = victim_entry;
-		}
 
+	/* Move the block to the bucket of its new valid page count */
+	for(link=0;link<VICTIM_LINK_NB;link++){
+		victim_block_root* root = _GET_VICTIM_ROOT(device_index, victim_entry, link);
+		_UNLINK_VICTIM_BLOCK(root, victim_entry, link);
+	}
+	victim_entry->bucket = *(victim_entry->valid_page_nb);
+	for(link=0;link<VICTIM_LINK_NB;link++){
+		victim_block_root* root = _GET_VICTIM_ROOT(device_index, victim_entry, link);
+		_LINK_VICTIM_BLOCK(root, victim_entry, link);
 	}
-	//otherwise do nothing
 }
 
 ftl_ret_val UPDATE_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb, uint64_t phy_page_nb, char valid)
@@ -821,7 +1114,10 @@ ftl_ret_val UPDATE_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy
 		GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, phy_flash_nb, phy_block_nb);
 
 	victim_block_entry *victim_entry = mapping_entry->victim;
-	char old_state = mapping_entry->valid_array[phy_page_nb];
+	uint64_t* valid_bits = mapping_entry->valid_bitmap + phy_page_nb / 64;
+	uint64_t* programmed_bits = valid_bits + inverse_mappings_manager[device_index].page_bitmap_word_nb;
+	uint64_t page_bit = 1ULL << (phy_page_nb % 64);
+	char old_state = (*valid_bits & page_bit) ? PAGE_VALID : ((*programmed_bits & page_bit) ? PAGE_INVALID : PAGE_ZERO);
 	if(old_state == PAGE_INVALID && valid == PAGE_VALID){
 		RERR(FTL_FAILURE, "Writing to a page that was already written to without erase.\n");
 	}
@@ -831,9 +1127,80 @@ ftl_ret_val UPDATE_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy
 	}
 	else if ((valid != PAGE_VALID) && (old_state == PAGE_VALID)){
 		mapping_entry->valid_page_nb--;
+		mapping_entry->last_invalidation_time = get_usec();
 		UPDATE_VICTIM_LIST(device_index, victim_entry);
 	}
-	mapping_entry->valid_array[phy_page_nb] = valid;
+	if (valid == PAGE_VALID)
+		*valid_bits |= page_bit;
+	else
+		*valid_bits &= ~page_bit;
+	if (valid == PAGE_ZERO)
+		*programmed_bits &= ~page_bit;
+	else
+		*programmed_bits |= page_bit;
+
+	return FTL_SUCCESS;
+}
+
+static int _COMPARE_PPN(const void* a, const void* b)
+{
+	uint64_t x = *(const uint64_t*)a;
+	uint64_t y = *(const uint64_t*)b;
+
+	return (x > y) - (x < y);
+}
+
+ftl_ret_val INVALIDATE_INVERSE_PAGES(uint8_t device_index, uint64_t* ppns, uint64_t ppn_nb)
+{
+	uint64_t page_nb = devices[device_index].page_nb;
+	int64_t now = get_usec();
+	uint64_t i = 0;
+
+	qsort(ppns, ppn_nb, sizeof(uint64_t), _COMPARE_PPN);
+	if (ppn_nb > 0 && ppns[ppn_nb - 1] >= devices[device_index].pages_in_ssd)
+		RERR(FTL_FAILURE, "Wrong physical address\n");
+
+	while (i < ppn_nb){
+		ppn_coords_t coords;
+		DECODE_PPN(device_index, ppns[i], &coords);
+
+		inverse_block_mapping_entry *mapping_entry =
+			GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, coords.flash, coords.block);
+		uint64_t first_ppn = ppns[i] - coords.page;
+		uint64_t invalidated_nb = 0;
+
+		/* Clear the valid bits of every listed page of this block, the programmed bits stay set */
+		for (; i < ppn_nb && ppns[i] - first_ppn < page_nb; i++){
+			uint64_t phy_page_nb = ppns[i] - first_ppn;
+			uint64_t* valid_bits = mapping_entry->valid_bitmap + phy_page_nb / 64;
+			uint64_t page_bit = 1ULL << (phy_page_nb % 64);
+
+			if (*valid_bits & page_bit){
+				*valid_bits &= ~page_bit;
+				invalidated_nb++;
+			}
+		}
+
+		if (invalidated_nb > 0){
+			mapping_entry->valid_page_nb -= invalidated_nb;
+			mapping_entry->last_invalidation_time = now;
+			UPDATE_VICTIM_LIST(device_index, mapping_entry->victim);
+		}
+	}
 
 	return FTL_SUCCESS;
 }
+
+char GET_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb, uint64_t phy_page_nb)
+{
+	inverse_block_mapping_entry *mapping_entry =
+		GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, phy_flash_nb, phy_block_nb);
+	uint64_t word_nb = phy_page_nb / 64;
+	uint64_t page_bit = 1ULL << (phy_page_nb % 64);
+
+	if (mapping_entry->valid_bitmap[word_nb] & page_bit)
+		return PAGE_VALID;
+	if (mapping_entry->valid_bitmap[inverse_mappings_manager[device_index].page_bitmap_word_nb + word_nb] & page_bit)
+		return PAGE_INVALID;
+	return PAGE_ZERO;
+}
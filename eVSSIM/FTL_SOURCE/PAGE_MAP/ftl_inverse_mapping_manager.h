@@ -14,11 +14,27 @@
 
 #include "common.h"
 
+/* Write streams, every stream allocates from its own block of a plane when separated */
+#define WRITE_STREAM_HOT	0	/* host writes of frequently updated pages */
+#define WRITE_STREAM_COLD	1	/* host writes of the other pages */
+#define WRITE_STREAM_GC		2	/* pages relocated by GC */
+#define WRITE_STREAM_NB		3
+
+#define NO_STREAM_BLOCK		UINT64_MAX
+
+/*
+ * Free blocks of a plane, kept as a FIFO ring of block ids (flash * block_nb
+ * + block) over a slice of empty_block_ring. The head is the block pages are
+ * currently allocated from. With write stream separation every stream claims
+ * a block of the ring instead, and keeps it until it fills up.
+ */
 typedef struct empty_block_root
 {
-	struct empty_block_entry* next;
-	struct empty_block_entry* tail;
+	uint64_t* ring;
+	uint64_t head;
+	uint64_t capacity;
 	uint64_t empty_block_nb;
+	uint64_t stream_block[WRITE_STREAM_NB];
 	int lock;
 } empty_block_root;
 
@@ -27,24 +43,41 @@ typedef struct empty_block_entry
 	unsigned int phy_flash_nb;
 	unsigned int phy_block_nb;
 	uint64_t curr_phy_page_nb;
-	struct empty_block_entry* next;
 } empty_block_entry;
 
+/* Every victim block is linked into a bucket of its plane and of the device */
+#define VICTIM_PLANE_LINK	0
+#define VICTIM_GLOBAL_LINK	1
+#define VICTIM_LINK_NB		2
+
+/*
+ * Full blocks bucketed by valid page count: buckets[n] lists the blocks with
+ * exactly n valid pages and bit n of bucket_bitmap is set while that bucket is
+ * not empty, so the block with the fewest valid pages is a find-first-set.
+ */
 typedef struct victim_block_root
 {
-	struct victim_block_entry* next;
-	struct victim_block_entry* tail;
+	struct victim_block_entry** buckets;
+	uint64_t* bucket_bitmap;
 	uint64_t victim_block_nb;
 	int lock;
 } victim_block_root;
 
+typedef struct victim_block_link
+{
+	struct victim_block_entry* prev;
+	struct victim_block_entry* next;
+} victim_block_link;
+
 typedef struct victim_block_entry
 {
 	unsigned int phy_flash_nb;
 	uint64_t phy_block_nb;
 	uint64_t *valid_page_nb;
-	struct victim_block_entry* prev;
-	struct victim_block_entry* next;
+	uint64_t bucket;
+	/* Order in which the block filled up, oldest first */
+	uint64_t seq;
+	victim_block_link links[VICTIM_LINK_NB];
 } victim_block_entry;
 
 typedef struct inverse_block_mapping_entry
@@ -53,27 +86,114 @@ typedef struct inverse_block_mapping_entry
 	uint64_t dirty_page_nb;
 	int type;
 	unsigned int erase_count;
+	/* Emulated time (get_usec) a page of the block was last invalidated */
+	int64_t last_invalidation_time;
 	victim_block_entry* victim;
-	char* valid_array;
+	/* page_bitmap_word_nb words of valid bits, then as many of programmed bits */
+	uint64_t* valid_bitmap;
 	int lock;
 } inverse_block_mapping_entry;
 
 typedef struct inverse_mapping_manager {
-	uint64_t* inverse_page_mapping_table;
+	void* inverse_page_mapping_table;
 
 	inverse_block_mapping_entry* inverse_block_mapping_table_start;
 
 	empty_block_root* empty_block_table_start;
 	victim_block_root* victim_block_table_start;
 
+	/* Per block state of the free and victim pools, indexed by block id */
+	empty_block_entry* empty_block_entries;
+	uint64_t* empty_block_ring;
+	/* Bit i is set while empty_block_table_start[i] has free blocks */
+	uint64_t* free_plane_bitmap;
+	uint64_t free_plane_word_nb;
+	victim_block_entry* victim_block_entries;
+
+	/* Device wide victim index and the bucket storage of all the indexes */
+	victim_block_root victim_block_index;
+	victim_block_entry** victim_buckets;
+	uint64_t* victim_bucket_bitmaps;
+	uint64_t victim_bucket_word_nb;
+
+	/* Page state bitmaps of all the blocks, in one slab */
+	uint64_t* page_state_bitmaps;
+	uint64_t page_bitmap_word_nb;
+
 	uint64_t total_zero_page_nb;
 	uint64_t total_victim_block_nb;
+	/* Sequence number of the next block to become a victim */
+	uint64_t victim_block_seq;
 
 	uint64_t empty_block_table_index;
 } inverse_mapping_manager_t;
 
 extern inverse_mapping_manager_t* inverse_mappings_manager;
 
+/*
+ * FTL snapshot: a pointer free image of the inverse mapping, validity, free
+ * and victim state. Sections are stored at the offsets of the header, every
+ * one of them aligned to FTL_SNAPSHOT_ALIGN. The forward mapping keeps its
+ * own flat mapping_table.dat, which the header pins by size.
+ */
+#define FTL_SNAPSHOT_MAGIC	0x31504e5357535356ULL	/* "VSSWSNP1" */
+#define FTL_SNAPSHOT_VERSION	2
+#define FTL_SNAPSHOT_ALIGN	64
+
+#define FTL_SNAPSHOT_BLOCK_VICTIM	0x1
+
+typedef struct ftl_snapshot_header
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t mapping_entry_size;
+
+	uint64_t flash_nb;
+	uint64_t block_nb;
+	uint64_t page_nb;
+	uint64_t planes_per_flash;
+	uint64_t page_mapping_entry_nb;
+
+	uint64_t total_zero_page_nb;
+	uint64_t empty_block_table_index;
+
+	/* Section offsets from the start of the file */
+	uint64_t inverse_page_offset;
+	uint64_t block_offset;
+	uint64_t page_state_offset;
+	uint64_t empty_list_offset;
+	uint64_t file_size;
+} ftl_snapshot_header_t;
+
+typedef struct ftl_snapshot_block
+{
+	uint64_t valid_page_nb;
+	uint64_t dirty_page_nb;
+	uint64_t curr_phy_page_nb;
+	int32_t type;
+	uint32_t erase_count;
+	uint32_t flags;
+	uint32_t reserved;
+	int64_t last_invalidation_time;
+	uint64_t victim_seq;
+} ftl_snapshot_block_t;
+
+/* Returns the first set bit at or after start, or word_nb * 64 if there is none */
+static inline uint64_t NEXT_SET_BIT(const uint64_t* bitmap, uint64_t word_nb, uint64_t start)
+{
+	uint64_t i = start / 64;
+	if (i >= word_nb)
+		return word_nb * 64;
+
+	uint64_t word = bitmap[i] & (~0ULL << (start % 64));
+	while (word == 0) {
+		if (++i == word_nb)
+			return word_nb * 64;
+		word = bitmap[i];
+	}
+	return i * 64 + __builtin_ctzll(word);
+}
+
 void INIT_INVERSE_PAGE_MAPPING(uint8_t device_index);
 void INIT_INVERSE_BLOCK_MAPPING(uint8_t device_index);
 void INIT_EMPTY_BLOCK_LIST(uint8_t device_index);
@@ -86,12 +206,19 @@ void TERM_EMPTY_BLOCK_LIST(uint8_t device_index);
 void TERM_VICTIM_BLOCK_LIST(uint8_t device_index);
 void TERM_VALID_ARRAY(uint8_t device_index);
 
+ftl_ret_val SAVE_FTL_SNAPSHOT(uint8_t device_index);
+ftl_ret_val LOAD_FTL_SNAPSHOT(uint8_t device_index);
+
 empty_block_entry* GET_EMPTY_BLOCK(uint8_t device_index, int mode, uint64_t mapping_index);
+empty_block_entry* GET_STREAM_EMPTY_BLOCK(uint8_t device_index, int mode, uint64_t mapping_index, int stream);
 ftl_ret_val INSERT_EMPTY_BLOCK(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb);
+void EJECT_EMPTY_BLOCK(uint8_t device_index, uint64_t mapping_index);
+void EJECT_FULL_BLOCK(uint8_t device_index, uint64_t mapping_index, empty_block_entry* full_block);
 
 ftl_ret_val INSERT_VICTIM_BLOCK(uint8_t device_index, empty_block_entry* full_block);
 void UPDATE_VICTIM_LIST(uint8_t device_index, victim_block_entry *victim_entry);
 int EJECT_VICTIM_BLOCK(uint8_t device_index, victim_block_entry* victim_block);
+victim_block_entry* GET_MIN_VICTIM_BLOCK(uint8_t device_index, victim_block_root* root);
 
 inverse_block_mapping_entry* GET_INVERSE_BLOCK_MAPPING_ENTRY(uint8_t device_index, unsigned int phy_flash_nb, uint64_t phy_block_nb);
 
@@ -101,5 +228,9 @@ int UPDATE_INVERSE_BLOCK_MAPPING(uint8_t device_index, unsigned int phy_flash_nb
     uint64_t phy_block_nb, int type);
 ftl_ret_val UPDATE_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy_flash_nb,
     uint64_t phy_block_nb, uint64_t phy_page_nb, char valid);
+char GET_INVERSE_BLOCK_VALIDITY(uint8_t device_index, unsigned int phy_flash_nb,
+    uint64_t phy_block_nb, uint64_t phy_page_nb);
+/* Invalidates all the given pages, sorting ppns in place so every block is updated once */
+ftl_ret_val INVALIDATE_INVERSE_PAGES(uint8_t device_index, uint64_t* ppns, uint64_t ppn_nb);
 
 #endif
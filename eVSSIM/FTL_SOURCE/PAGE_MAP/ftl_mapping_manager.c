@@ -4,17 +4,698 @@
 // Embedded Software Systems Lab. All right reserved
 
 #include "common.h"
+#include "test_context.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
 
 #define MAPPING_TABLE_INIT_VAL UINT64_MAX
 
-uint64_t **mapping_table = NULL;
+void **mapping_table = NULL;
+mapping_mmap_t *mapping_mmaps = NULL;
+mapping_cache_t *mapping_caches = NULL;
+mapping_extents_t *mapping_extents = NULL;
+write_heat_t *write_heats = NULL;
 
 extern GCAlgorithm gc_algo;
 
+/* An mmap'ed table keeps its entries one's-complemented in the entry width */
+static inline uint64_t _LOAD_MMAP_ENTRY(uint8_t device_index, uint64_t lpn)
+{
+	if (devices[device_index].mapping_entry_size == sizeof(uint32_t))
+	{
+		uint32_t entry = ~((uint32_t *)mapping_table[device_index])[lpn];
+		return entry == MAPPING_COMPACT_INIT_VAL ? MAPPING_TABLE_INIT_VAL : entry;
+	}
+	return ~((uint64_t *)mapping_table[device_index])[lpn];
+}
+
+static inline void _STORE_MMAP_ENTRY(uint8_t device_index, uint64_t lpn, uint64_t ppn)
+{
+	if (devices[device_index].mapping_entry_size == sizeof(uint32_t))
+		((uint32_t *)mapping_table[device_index])[lpn] = ppn == MAPPING_TABLE_INIT_VAL ? 0 : ~(uint32_t)ppn;
+	else
+		((uint64_t *)mapping_table[device_index])[lpn] = ~ppn;
+}
+
+static void _COLLECT_DIRTY_REGIONS(mapping_mmap_t* mm)
+{
+	memcpy(mm->flush_bitmap, mm->dirty_bitmap, mm->dirty_word_nb * sizeof(uint64_t));
+	memset(mm->dirty_bitmap, 0, mm->dirty_word_nb * sizeof(uint64_t));
+}
+
+/* msync every run of consecutive dirty regions collected in flush_bitmap */
+static void _SYNC_DIRTY_REGIONS(uint8_t device_index, mapping_mmap_t* mm)
+{
+	uint8_t* base = (uint8_t*)mapping_table[device_index];
+	uint64_t region_nb = (mm->size + MAPPING_DIRTY_REGION_SIZE - 1) >> MAPPING_DIRTY_REGION_SHIFT;
+	uint64_t region = 0;
+
+	while (region < region_nb)
+	{
+		uint64_t word = mm->flush_bitmap[region / 64] >> (region % 64);
+		if (word == 0)
+		{
+			region = (region / 64 + 1) * 64;
+			continue;
+		}
+		region += __builtin_ctzll(word);
+
+		uint64_t first = region;
+		while (region < region_nb && (mm->flush_bitmap[region / 64] & (1ULL << (region % 64))))
+			region++;
+
+		size_t offset = first << MAPPING_DIRTY_REGION_SHIFT;
+		size_t length = (region << MAPPING_DIRTY_REGION_SHIFT) - offset;
+		if (offset + length > mm->size)
+			length = mm->size - offset;
+
+		if (msync(base + offset, length, MS_SYNC) != 0)
+			DEV_PERR(device_index, "msync of mapping table failed\n");
+
+		mm->flushed_region_nb += region - first;
+	}
+}
+
+static void *MAPPING_FLUSH_LOOP(void *arg)
+{
+	uint8_t device_index = (uint8_t)(uintptr_t)arg;
+	mapping_mmap_t* mm = &mapping_mmaps[device_index];
+
+	// sleep on the signal lock, the device lock is only needed to collect the dirty regions
+	pthread_mutex_lock(&mm->flush_signal_lock);
+	while (!mm->flush_stop_flag) {
+		struct timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += devices[device_index].mapping_flush_interval_sec;
+		pthread_cond_timedwait(&mm->flush_signal_cond, &mm->flush_signal_lock, &ts);
+		// flush_stop_flag must be rechecked immediately
+		if (mm->flush_stop_flag)
+			break;
+		pthread_mutex_unlock(&mm->flush_signal_lock);
+
+		pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+		_COLLECT_DIRTY_REGIONS(mm);
+		pthread_rwlock_unlock(DEVICE_LOCK(device_index));
+
+		// the table stays mapped until this thread is joined, so the
+		// write-back itself does not need to hold the device lock
+		_SYNC_DIRTY_REGIONS(device_index, mm);
+		pthread_mutex_lock(&mm->flush_signal_lock);
+	}
+	pthread_mutex_unlock(&mm->flush_signal_lock);
+
+	return NULL;
+}
+
+static void INIT_MAPPING_TABLE_MMAP(uint8_t device_index)
+{
+	mapping_mmap_t* mm = &mapping_mmaps[device_index];
+	mm->size = (uint64_t)devices[device_index].page_mapping_entry_nb * devices[device_index].mapping_entry_size;
+
+	char *data_filename = GET_DATA_FILENAME(device_index, "mapping_table.map");
+	if (data_filename == NULL)
+		RERR(, "GET_DATA_FILENAME failed\n");
+
+	mm->fd = open(data_filename, O_RDWR | O_CREAT, 0644);
+	free(data_filename);
+	if (mm->fd < 0)
+		RERR(, "File open fail\n");
+
+	// a new file is extended sparsely, its zeroes decode as unmapped entries. A file
+	// of another size was written with another geometry or entry width and is dropped.
+	struct stat st;
+	if (fstat(mm->fd, &st) != 0)
+		st.st_size = 0;
+	if ((size_t)st.st_size != mm->size)
+	{
+		if (st.st_size != 0)
+			DEV_PINFO(device_index, "mapping table file size mismatch, resetting it\n");
+
+		if (ftruncate(mm->fd, 0) != 0 || ftruncate(mm->fd, mm->size) != 0)
+		{
+			close(mm->fd);
+			RERR(, "ftruncate mapping table fail\n");
+		}
+	}
+
+	void* table = mmap(NULL, mm->size, PROT_READ | PROT_WRITE, MAP_SHARED, mm->fd, 0);
+	if (table == MAP_FAILED)
+	{
+		close(mm->fd);
+		RERR(, "mmap mapping table fail\n");
+	}
+	mapping_table[device_index] = table;
+
+	uint64_t region_nb = (mm->size + MAPPING_DIRTY_REGION_SIZE - 1) >> MAPPING_DIRTY_REGION_SHIFT;
+	mm->dirty_word_nb = (region_nb + 63) / 64;
+	mm->dirty_bitmap = (uint64_t *)calloc(mm->dirty_word_nb, sizeof(uint64_t));
+	mm->flush_bitmap = (uint64_t *)calloc(mm->dirty_word_nb, sizeof(uint64_t));
+	if (mm->dirty_bitmap == NULL || mm->flush_bitmap == NULL)
+		RERR(, "Calloc mapping dirty bitmap fail\n");
+	mm->flushed_region_nb = 0;
+
+	pthread_mutex_init(&mm->flush_signal_lock, NULL);
+	pthread_cond_init(&mm->flush_signal_cond, NULL);
+	mm->flush_stop_flag = false;
+	if (0 != pthread_create(&mm->flush_tid, NULL, MAPPING_FLUSH_LOOP, (void *)(uintptr_t)device_index))
+		DEV_RERR(, device_index, "failed to create mapping flush thread\n");
+}
+
+static void TERM_MAPPING_TABLE_MMAP(uint8_t device_index)
+{
+	mapping_mmap_t* mm = &mapping_mmaps[device_index];
+
+	pthread_mutex_lock(&mm->flush_signal_lock);
+	mm->flush_stop_flag = true;
+	pthread_cond_signal(&mm->flush_signal_cond);
+	pthread_mutex_unlock(&mm->flush_signal_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
+	if (0 != pthread_join(mm->flush_tid, NULL))
+		DEV_PERR(device_index, "failed to join mapping flush thread\n");
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+	pthread_cond_destroy(&mm->flush_signal_cond);
+	pthread_mutex_destroy(&mm->flush_signal_lock);
+
+	FLUSH_MAPPING_TABLE(device_index);
+
+	munmap(mapping_table[device_index], mm->size);
+	mapping_table[device_index] = NULL;
+	close(mm->fd);
+
+	free(mm->dirty_bitmap);
+	free(mm->flush_bitmap);
+	mm->dirty_bitmap = NULL;
+	mm->flush_bitmap = NULL;
+}
+
+static void INIT_MAPPING_CACHE(uint8_t device_index)
+{
+	mapping_cache_t* cache = &mapping_caches[device_index];
+	memset(cache, 0, sizeof(*cache));
+
+	if (devices[device_index].mapping_cache_entry_nb == 0)
+		return;
+
+	cache->entries_per_tpage = devices[device_index].page_size / devices[device_index].mapping_entry_size;
+	cache->tpage_nb = (devices[device_index].page_mapping_entry_nb + cache->entries_per_tpage - 1) / cache->entries_per_tpage;
+
+	uint64_t slot_nb = devices[device_index].mapping_cache_entry_nb / cache->entries_per_tpage;
+	if (slot_nb == 0)
+		slot_nb = 1;
+	if (slot_nb > cache->tpage_nb)
+		slot_nb = cache->tpage_nb;
+	cache->slot_nb = slot_nb;
+
+	cache->slot_tvpn = (uint64_t *)malloc(sizeof(uint64_t) * cache->slot_nb);
+	cache->slot_flags = (uint8_t *)calloc(cache->slot_nb, sizeof(uint8_t));
+	cache->tvpn_slot = (uint32_t *)malloc(sizeof(uint32_t) * cache->tpage_nb);
+	if (cache->slot_tvpn == NULL || cache->slot_flags == NULL || cache->tvpn_slot == NULL)
+		RERR(, "Alloc mapping cache fail\n");
+
+	uint64_t i;
+	for (i = 0; i < cache->slot_nb; i++)
+		cache->slot_tvpn[i] = MAPPING_TABLE_INIT_VAL;
+	for (i = 0; i < cache->tpage_nb; i++)
+		cache->tvpn_slot[i] = MAPPING_CACHE_NO_SLOT;
+}
+
+static void TERM_MAPPING_CACHE(uint8_t device_index)
+{
+	mapping_cache_t* cache = &mapping_caches[device_index];
+
+	if (cache->slot_nb == 0)
+		return;
+
+	DEV_PINFO(device_index, "mapping cache hits %lu misses %lu writebacks %lu\n",
+		cache->hit_nb, cache->miss_nb, cache->writeback_nb);
+
+	free(cache->slot_tvpn);
+	free(cache->slot_flags);
+	free(cache->tvpn_slot);
+	memset(cache, 0, sizeof(*cache));
+}
+
+/* Translation pages live at a fixed home location, striped over the flashes */
+static void _TPAGE_LOCATION(uint8_t device_index, uint64_t tvpn, unsigned int* flash_nb, unsigned int* block_nb, unsigned int* page_nb)
+{
+	uint64_t rest = tvpn / devices[device_index].flash_nb;
+
+	*flash_nb = tvpn % devices[device_index].flash_nb;
+	*block_nb = rest % devices[device_index].block_nb;
+	*page_nb = (rest / devices[device_index].block_nb) % devices[device_index].page_nb;
+}
+
+/*
+ * Bring the translation page holding lpn into the cached mapping table,
+ * charging a translation page read on a miss and a write back when the
+ * clock evicts a dirty page.
+ */
+static void _MAPPING_CACHE_ACCESS(uint8_t device_index, uint64_t lpn, bool dirty)
+{
+	mapping_cache_t* cache = &mapping_caches[device_index];
+	unsigned int flash_nb, block_nb, page_nb;
+	bool writeback = false;
+
+	int64_t start = get_usec();
+	uint64_t tvpn = lpn / cache->entries_per_tpage;
+	uint32_t slot = cache->tvpn_slot[tvpn];
+
+	if (slot != MAPPING_CACHE_NO_SLOT)
+	{
+		cache->hit_nb++;
+		cache->slot_flags[slot] |= MAPPING_CACHE_REFERENCED | (dirty ? MAPPING_CACHE_DIRTY : 0);
+
+		_TPAGE_LOCATION(device_index, tvpn, &flash_nb, &block_nb, &page_nb);
+		LOG_MAPPING_CACHE(GET_LOGGER(device_index, flash_nb), (MappingCacheLog) {
+			.hit = true, .writeback = false,
+			.metadata = LOG_META(device_index, start, start)
+		});
+		return;
+	}
+
+	cache->miss_nb++;
+
+	/* Second chance: skip slots referenced since the hand last passed them */
+	while (cache->slot_flags[cache->clock_hand] & MAPPING_CACHE_REFERENCED)
+	{
+		cache->slot_flags[cache->clock_hand] &= ~MAPPING_CACHE_REFERENCED;
+		cache->clock_hand = (cache->clock_hand + 1) % cache->slot_nb;
+	}
+	slot = cache->clock_hand;
+	cache->clock_hand = (cache->clock_hand + 1) % cache->slot_nb;
+
+	uint64_t victim_tvpn = cache->slot_tvpn[slot];
+	if (victim_tvpn != MAPPING_TABLE_INIT_VAL)
+	{
+		if (cache->slot_flags[slot] & MAPPING_CACHE_DIRTY)
+		{
+			_TPAGE_LOCATION(device_index, victim_tvpn, &flash_nb, &block_nb, &page_nb);
+			SSD_PAGE_WRITE(device_index, flash_nb, block_nb, page_nb, 0, MAPPING_WRITE);
+			cache->writeback_nb++;
+			writeback = true;
+		}
+		cache->tvpn_slot[victim_tvpn] = MAPPING_CACHE_NO_SLOT;
+	}
+
+	_TPAGE_LOCATION(device_index, tvpn, &flash_nb, &block_nb, &page_nb);
+	_SSD_PAGE_READ(device_index, flash_nb, block_nb, page_nb, 0, MAPPING_READ);
+
+	cache->slot_tvpn[slot] = tvpn;
+	cache->slot_flags[slot] = MAPPING_CACHE_REFERENCED | (dirty ? MAPPING_CACHE_DIRTY : 0);
+	cache->tvpn_slot[tvpn] = slot;
+
+	LOG_MAPPING_CACHE(GET_LOGGER(device_index, flash_nb), (MappingCacheLog) {
+		.hit = false, .writeback = writeback,
+		.metadata = LOG_META(device_index, start, get_usec())
+	});
+}
+
+static void MAPPING_CACHE_ACCESS(uint8_t device_index, uint64_t lpn, bool dirty)
+{
+	if (mapping_caches[device_index].slot_nb == 0)
+		return;
+
+	// lookups also come from sector reads, which only share the device lock
+	pthread_mutex_lock(&ssds_manager[device_index].timing_lock);
+	_MAPPING_CACHE_ACCESS(device_index, lpn, dirty);
+	pthread_mutex_unlock(&ssds_manager[device_index].timing_lock);
+}
+
+/* Number of entries streamed at a time when the extents are loaded or stored */
+#define MAPPING_EXTENT_IO_ENTRY_NB 4096
+
+/* Index of the last extent starting at or before lpn, or -1 */
+static int64_t _FIND_EXTENT(mapping_extents_t* me, uint64_t lpn)
+{
+	int64_t low = 0, high = (int64_t)me->extent_nb - 1, found = -1;
+
+	while (low <= high)
+	{
+		int64_t mid = low + (high - low) / 2;
+		if (me->extents[mid].lpn <= lpn)
+		{
+			found = mid;
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid - 1;
+		}
+	}
+	return found;
+}
+
+static bool _EXTENT_CONTAINS(mapping_extent_t* extent, uint64_t lpn)
+{
+	return extent->lpn <= lpn && lpn < extent->lpn + extent->length;
+}
+
+static uint64_t _EXTENT_PPN(mapping_extent_t* extent, uint64_t lpn)
+{
+	return extent->ppn + (int64_t)(lpn - extent->lpn) * extent->stride;
+}
+
+/* Strides the page allocator produces: inside a block, or across blocks at the same page offset */
+static bool _IS_RUN_STRIDE(uint8_t device_index, int64_t stride)
+{
+	return stride == 1 || (stride != 0 && stride % (int64_t)devices[device_index].page_nb == 0);
+}
+
+/* Insert a new two page extent at index */
+static ftl_ret_val _INSERT_EXTENT(mapping_extents_t* me, uint64_t index, uint64_t lpn, uint64_t ppn, int64_t stride)
+{
+	if (me->extent_nb == me->extent_capacity)
+	{
+		uint64_t capacity = me->extent_capacity ? me->extent_capacity * 2 : 64;
+		mapping_extent_t* extents = (mapping_extent_t *)realloc(me->extents, capacity * sizeof(mapping_extent_t));
+		if (extents == NULL)
+			RERR(FTL_FAILURE, "Realloc mapping extents fail\n");
+		me->extents = extents;
+		me->extent_capacity = capacity;
+	}
+
+	memmove(me->extents + index + 1, me->extents + index, (me->extent_nb - index) * sizeof(mapping_extent_t));
+	me->extents[index] = (mapping_extent_t) { .lpn = lpn, .ppn = ppn, .length = 2, .stride = stride, .override_nb = 0 };
+	me->extent_nb++;
+
+	return FTL_SUCCESS;
+}
+
+static void _REMOVE_EXTENT(mapping_extents_t* me, uint64_t index)
+{
+	memmove(me->extents + index, me->extents + index + 1, (me->extent_nb - index - 1) * sizeof(mapping_extent_t));
+	me->extent_nb--;
+}
+
+static mapping_override_t* _FIND_OVERRIDE(mapping_extents_t* me, uint64_t lpn)
+{
+	mapping_override_t* override;
+
+	HASH_FIND(hh, me->overrides, &lpn, sizeof(uint64_t), override);
+	return override;
+}
+
+static void _REMOVE_OVERRIDE(mapping_extents_t* me, mapping_override_t* override)
+{
+	HASH_DEL(me->overrides, override);
+	free(override);
+	me->override_nb--;
+}
+
+static ftl_ret_val _SET_OVERRIDE(mapping_extents_t* me, mapping_override_t* override, uint64_t lpn, uint64_t ppn)
+{
+	if (override == NULL)
+	{
+		override = (mapping_override_t *)malloc(sizeof(mapping_override_t));
+		if (override == NULL)
+			RERR(FTL_FAILURE, "Malloc mapping override fail\n");
+		override->lpn = lpn;
+		HASH_ADD(hh, me->overrides, lpn, sizeof(uint64_t), override);
+		me->override_nb++;
+	}
+	override->ppn = ppn;
+
+	return FTL_SUCCESS;
+}
+
+static uint64_t _GET_EXTENT_MAPPING(mapping_extents_t* me, uint64_t lpn)
+{
+	mapping_override_t* override = _FIND_OVERRIDE(me, lpn);
+	if (override != NULL)
+		return override->ppn;
+
+	int64_t index = _FIND_EXTENT(me, lpn);
+	if (index >= 0 && _EXTENT_CONTAINS(&me->extents[index], lpn))
+		return _EXTENT_PPN(&me->extents[index], lpn);
+
+	return MAPPING_TABLE_INIT_VAL;
+}
+
+/*
+ * Map lpn to ppn, growing an adjacent extent when the pair continues it. A
+ * remapped page inside an extent becomes an override, unless it sits at the
+ * head or tail of the extent in which case the extent is trimmed instead.
+ */
+static ftl_ret_val _UPDATE_EXTENT_MAPPING(uint8_t device_index, uint64_t lpn, uint64_t ppn)
+{
+	mapping_extents_t* me = &mapping_extents[device_index];
+	mapping_override_t* override = _FIND_OVERRIDE(me, lpn);
+	int64_t index = _FIND_EXTENT(me, lpn);
+	mapping_extent_t* extent = index >= 0 ? &me->extents[index] : NULL;
+
+	if (extent != NULL && _EXTENT_CONTAINS(extent, lpn))
+	{
+		if (ppn == _EXTENT_PPN(extent, lpn))
+		{
+			if (override != NULL)
+			{
+				_REMOVE_OVERRIDE(me, override);
+				extent->override_nb--;
+			}
+			return FTL_SUCCESS;
+		}
+
+		if (override != NULL)
+			return _SET_OVERRIDE(me, override, lpn, ppn);
+
+		if (extent->length == 1 && ppn != MAPPING_TABLE_INIT_VAL)
+		{
+			extent->ppn = ppn;
+			return FTL_SUCCESS;
+		}
+
+		if (extent->length == 1 || (lpn != extent->lpn && lpn != extent->lpn + extent->length - 1))
+		{
+			extent->override_nb++;
+			return _SET_OVERRIDE(me, NULL, lpn, ppn);
+		}
+
+		/* Trim the extent, lpn is then mapped as a page outside of it */
+		if (lpn == extent->lpn)
+		{
+			extent->lpn++;
+			extent->ppn += extent->stride;
+			index--;
+		}
+		extent->length--;
+		extent = index >= 0 ? &me->extents[index] : NULL;
+	}
+
+	/* lpn is not covered by any extent from here on */
+	if (ppn == MAPPING_TABLE_INIT_VAL)
+	{
+		if (override != NULL)
+			_REMOVE_OVERRIDE(me, override);
+		return FTL_SUCCESS;
+	}
+
+	mapping_extent_t* next = (uint64_t)(index + 1) < me->extent_nb ? &me->extents[index + 1] : NULL;
+	bool prev_in_extent = extent != NULL && extent->lpn + extent->length == lpn;
+
+	if (prev_in_extent && _EXTENT_PPN(extent, lpn) == ppn)
+	{
+		if (override != NULL)
+			_REMOVE_OVERRIDE(me, override);
+
+		extent->length++;
+		if (next != NULL && next->lpn == lpn + 1 && next->stride == extent->stride && next->ppn == ppn + extent->stride)
+		{
+			extent->length += next->length;
+			extent->override_nb += next->override_nb;
+			_REMOVE_EXTENT(me, index + 1);
+		}
+		return FTL_SUCCESS;
+	}
+
+	if (next != NULL && next->lpn == lpn + 1 && next->ppn == ppn + next->stride)
+	{
+		if (override != NULL)
+			_REMOVE_OVERRIDE(me, override);
+
+		next->lpn--;
+		next->ppn = ppn;
+		next->length++;
+		return FTL_SUCCESS;
+	}
+
+	/* Two lone pages that form a run are promoted to an extent */
+	mapping_override_t* prev = (lpn > 0 && !prev_in_extent) ? _FIND_OVERRIDE(me, lpn - 1) : NULL;
+	if (prev != NULL && prev->ppn != MAPPING_TABLE_INIT_VAL && _IS_RUN_STRIDE(device_index, (int64_t)(ppn - prev->ppn)))
+	{
+		uint64_t prev_ppn = prev->ppn;
+
+		if (override != NULL)
+			_REMOVE_OVERRIDE(me, override);
+		_REMOVE_OVERRIDE(me, prev);
+
+		return _INSERT_EXTENT(me, index + 1, lpn - 1, prev_ppn, (int64_t)(ppn - prev_ppn));
+	}
+
+	return _SET_OVERRIDE(me, override, lpn, ppn);
+}
+
+static void INIT_MAPPING_EXTENTS(uint8_t device_index)
+{
+	mapping_extents_t* me = &mapping_extents[device_index];
+	memset(me, 0, sizeof(*me));
+
+	char *data_filename = GET_DATA_FILENAME(device_index, "mapping_table.dat");
+	if (data_filename == NULL)
+		RERR(, "GET_DATA_FILENAME failed\n");
+
+	FILE *fp = fopen(data_filename, "r");
+	free(data_filename);
+	if (fp == NULL)
+		return;
+
+	/* The table file keeps the flat layout, rebuild the extents from it */
+	const uint32_t entry_size = devices[device_index].mapping_entry_size;
+	void* entries = malloc(MAPPING_EXTENT_IO_ENTRY_NB * entry_size);
+	if (entries == NULL)
+	{
+		fclose(fp);
+		RERR(, "Malloc mapping extents buffer fail\n");
+	}
+
+	uint64_t lpn = 0;
+	while (lpn < devices[device_index].page_mapping_entry_nb)
+	{
+		size_t entry_nb = fread(entries, entry_size, MAPPING_EXTENT_IO_ENTRY_NB, fp);
+		if (entry_nb == 0)
+			break;
+
+		size_t i;
+		for (i = 0; i < entry_nb && lpn < devices[device_index].page_mapping_entry_nb; i++, lpn++)
+		{
+			uint64_t ppn = LOAD_MAPPING_ENTRY(entries, entry_size, i);
+			if (ppn != MAPPING_TABLE_INIT_VAL)
+				_UPDATE_EXTENT_MAPPING(device_index, lpn, ppn);
+		}
+	}
+
+	free(entries);
+	fclose(fp);
+}
+
+static void TERM_MAPPING_EXTENTS(uint8_t device_index)
+{
+	mapping_extents_t* me = &mapping_extents[device_index];
+
+	DEV_PINFO(device_index, "mapping extents %lu overrides %lu\n", me->extent_nb, me->override_nb);
+
+	char *data_filename = GET_DATA_FILENAME(device_index, "mapping_table.dat");
+	if (data_filename == NULL)
+		RERR(, "GET_DATA_FILENAME failed\n");
+
+	FILE *fp = fopen(data_filename, "w");
+	free(data_filename);
+
+	const uint32_t entry_size = devices[device_index].mapping_entry_size;
+	void* entries = malloc(MAPPING_EXTENT_IO_ENTRY_NB * entry_size);
+
+	if (fp == NULL || entries == NULL)
+	{
+		PERR("Can't store the mapping extents\n");
+	}
+	else
+	{
+		uint64_t lpn = 0;
+		while (lpn < devices[device_index].page_mapping_entry_nb)
+		{
+			size_t i;
+			for (i = 0; i < MAPPING_EXTENT_IO_ENTRY_NB && lpn < devices[device_index].page_mapping_entry_nb; i++, lpn++)
+				STORE_MAPPING_ENTRY(entries, entry_size, i, _GET_EXTENT_MAPPING(me, lpn));
+
+			if (fwrite(entries, entry_size, i, fp) != i)
+			{
+				PERR("fwrite\n");
+				break;
+			}
+		}
+	}
+
+	free(entries);
+	if (fp != NULL)
+		fclose(fp);
+
+	mapping_override_t *override, *tmp;
+	HASH_ITER(hh, me->overrides, override, tmp)
+	{
+		HASH_DEL(me->overrides, override);
+		free(override);
+	}
+	free(me->extents);
+	memset(me, 0, sizeof(*me));
+}
+
+static void INIT_WRITE_HEAT(uint8_t device_index)
+{
+	write_heat_t* heat = &write_heats[device_index];
+	memset(heat, 0, sizeof(*heat));
+
+	if (!devices[device_index].write_stream_separation)
+		return;
+
+	heat->write_counts = (uint8_t *)calloc(devices[device_index].page_mapping_entry_nb, sizeof(uint8_t));
+	if (heat->write_counts == NULL)
+		RERR(, "Calloc write heat fail\n");
+}
+
+static void TERM_WRITE_HEAT(uint8_t device_index)
+{
+	free(write_heats[device_index].write_counts);
+	memset(&write_heats[device_index], 0, sizeof(write_heats[device_index]));
+}
+
+int GET_WRITE_STREAM(uint8_t device_index, uint64_t lpn)
+{
+	write_heat_t* heat = &write_heats[device_index];
+	uint64_t i;
+
+	if (heat->write_counts == NULL)
+		return WRITE_STREAM_HOT;
+
+	if (++heat->write_nb == devices[device_index].page_mapping_entry_nb)
+	{
+		for (i = 0; i < devices[device_index].page_mapping_entry_nb; i++)
+			heat->write_counts[i] >>= 1;
+		heat->write_nb = 0;
+	}
+
+	if (heat->write_counts[lpn] < UINT8_MAX)
+		heat->write_counts[lpn]++;
+
+	return heat->write_counts[lpn] >= devices[device_index].write_stream_hot_write_nb ? WRITE_STREAM_HOT : WRITE_STREAM_COLD;
+}
+
 void INIT_MAPPING_TABLE(uint8_t device_index)
 {
+	INIT_MAPPING_CACHE(device_index);
+	INIT_WRITE_HEAT(device_index);
+
+	if (devices[device_index].mapping_extents)
+	{
+		if (devices[device_index].mapping_table_mmap)
+		{
+			DEV_PINFO(device_index, "mapping extents replace the mmap'ed mapping table\n");
+			devices[device_index].mapping_table_mmap = 0;
+		}
+		INIT_MAPPING_EXTENTS(device_index);
+		return;
+	}
+
+	if (devices[device_index].mapping_table_mmap)
+	{
+		INIT_MAPPING_TABLE_MMAP(device_index);
+		return;
+	}
+
 	/* Allocation Memory for Mapping Table */
-	mapping_table[device_index] = (uint64_t *)calloc((uint64_t)devices[device_index].page_mapping_entry_nb, sizeof(uint64_t));
+	mapping_table[device_index] = calloc((uint64_t)devices[device_index].page_mapping_entry_nb, devices[device_index].mapping_entry_size);
 	if (mapping_table[device_index] == NULL)
 		RERR(, "Calloc mapping table fail\n");
 
@@ -26,22 +707,33 @@ void INIT_MAPPING_TABLE(uint8_t device_index)
 	free(data_filename);
 	if (fp != NULL)
 	{
-		if (fread(mapping_table[device_index], sizeof(uint64_t), (uint64_t)devices[device_index].page_mapping_entry_nb, fp) <= 0)
+		if (fread(mapping_table[device_index], devices[device_index].mapping_entry_size, (uint64_t)devices[device_index].page_mapping_entry_nb, fp) <= 0)
 			PERR("fread\n");
 		fclose(fp);
 	}
 	else
 	{
-		uint64_t i;
-		for (i = 0; i < devices[device_index].page_mapping_entry_nb; i++)
-		{
-			mapping_table[device_index][i] = MAPPING_TABLE_INIT_VAL;
-		}
+		RESET_MAPPING_ENTRIES(mapping_table[device_index], devices[device_index].mapping_entry_size, devices[device_index].page_mapping_entry_nb);
 	}
 }
 
 void TERM_MAPPING_TABLE(uint8_t device_index)
 {
+	TERM_MAPPING_CACHE(device_index);
+	TERM_WRITE_HEAT(device_index);
+
+	if (devices[device_index].mapping_extents)
+	{
+		TERM_MAPPING_EXTENTS(device_index);
+		return;
+	}
+
+	if (devices[device_index].mapping_table_mmap)
+	{
+		TERM_MAPPING_TABLE_MMAP(device_index);
+		return;
+	}
+
 	char *data_filename = GET_DATA_FILENAME(device_index, "mapping_table.dat");
 	if (data_filename == NULL)
 		RERR(, "GET_DATA_FILENAME failed\n");
@@ -52,7 +744,7 @@ void TERM_MAPPING_TABLE(uint8_t device_index)
 		RERR(, "File open fail\n");
 
 	/* Write the mapping table to file */
-	if (fwrite(mapping_table[device_index], sizeof(uint64_t), (uint64_t)devices[device_index].page_mapping_entry_nb, fp) <= 0)
+	if (fwrite(mapping_table[device_index], devices[device_index].mapping_entry_size, (uint64_t)devices[device_index].page_mapping_entry_nb, fp) <= 0)
 		PERR("fwrite\n");
 
 	/* Free memory for mapping table */
@@ -60,6 +752,15 @@ void TERM_MAPPING_TABLE(uint8_t device_index)
 	fclose(fp);
 }
 
+void FLUSH_MAPPING_TABLE(uint8_t device_index)
+{
+	if (!devices[device_index].mapping_table_mmap)
+		return;
+
+	_COLLECT_DIRTY_REGIONS(&mapping_mmaps[device_index]);
+	_SYNC_DIRTY_REGIONS(device_index, &mapping_mmaps[device_index]);
+}
+
 uint64_t GET_MAPPING_INFO(uint8_t device_index, uint64_t lpn)
 {
 	if (lpn >= ((uint64_t)devices[device_index].page_mapping_entry_nb))
@@ -67,20 +768,65 @@ uint64_t GET_MAPPING_INFO(uint8_t device_index, uint64_t lpn)
 		PERR("overflow!\n");
 	}
 
-	const uint64_t ppn = mapping_table[device_index][lpn];
+	MAPPING_CACHE_ACCESS(device_index, lpn, false);
+
+	if (devices[device_index].mapping_extents)
+		return _GET_EXTENT_MAPPING(&mapping_extents[device_index], lpn);
+
+	if (devices[device_index].mapping_table_mmap)
+		return _LOAD_MMAP_ENTRY(device_index, lpn);
+
+	const uint64_t ppn = LOAD_MAPPING_ENTRY(mapping_table[device_index], devices[device_index].mapping_entry_size, lpn);
 	return ppn;
 }
 
+/*
+ * Look up lpn and return how many pages from it (up to max_page_nb) map to
+ * ppns that advance by *ppn_stride. Only the extent mapping knows about
+ * runs, the flat tables always report a single page.
+ */
+uint64_t GET_MAPPING_RUN(uint8_t device_index, uint64_t lpn, uint64_t max_page_nb, uint64_t* ppn, int64_t* ppn_stride)
+{
+	mapping_extents_t* me = &mapping_extents[device_index];
+	uint64_t run_nb = 1;
+
+	*ppn = GET_MAPPING_INFO(device_index, lpn);
+	*ppn_stride = 1;
+	if (!devices[device_index].mapping_extents || *ppn == MAPPING_TABLE_INIT_VAL || max_page_nb <= 1)
+		return 1;
+
+	int64_t index = _FIND_EXTENT(me, lpn);
+	if (index < 0 || !_EXTENT_CONTAINS(&me->extents[index], lpn) || me->extents[index].override_nb != 0)
+		return 1;
+
+	run_nb = me->extents[index].lpn + me->extents[index].length - lpn;
+	if (run_nb > max_page_nb)
+		run_nb = max_page_nb;
+	*ppn_stride = me->extents[index].stride;
+
+	/* The cached mapping table still sees every translation */
+	uint64_t i;
+	for (i = 1; i < run_nb; i++)
+		MAPPING_CACHE_ACCESS(device_index, lpn + i, false);
+
+	return run_nb;
+}
+
 ftl_ret_val GET_NEW_PAGE(uint8_t device_index, int mode, uint64_t mapping_index, uint64_t *ppn)
 {
-	return gc_algo.next_page(device_index, mode, mapping_index, ppn);
+	return gc_algo.next_page(device_index, mode, mapping_index, WRITE_STREAM_HOT, ppn);
 }
 
-ftl_ret_val DEFAULT_NEXT_PAGE_ALGO(uint8_t device_index, int mode, uint64_t mapping_index, uint64_t *ppn)
+ftl_ret_val GET_NEW_STREAM_PAGE(uint8_t device_index, int mode, uint64_t mapping_index, int stream, uint64_t *ppn)
+{
+	return gc_algo.next_page(device_index, mode, mapping_index, stream, ppn);
+}
+
+ftl_ret_val DEFAULT_NEXT_PAGE_ALGO(uint8_t device_index, int mode, uint64_t mapping_index, int stream, uint64_t *ppn)
 {
 	empty_block_entry *curr_empty_block;
 
-	curr_empty_block = GET_EMPTY_BLOCK(device_index, mode, mapping_index);
+	curr_empty_block = GET_STREAM_EMPTY_BLOCK(device_index, mode, mapping_index, stream);
 
 	if (curr_empty_block == NULL)
 	{
@@ -105,19 +851,8 @@ ftl_ret_val DEFAULT_NEXT_PAGE_ALGO(uint8_t device_index, int mode, uint64_t mapp
 		uint64_t plane_nb = curr_empty_block->phy_block_nb % devices[device_index].planes_per_flash;
 		mapping_index = plane_nb * devices[device_index].flash_nb + curr_empty_block->phy_flash_nb;
 
-		empty_block_root* curr_root_entry = inverse_mappings_manager[device_index].empty_block_table_start + mapping_index;
-
-		/* Update Empty Block List */
-		if(curr_root_entry->empty_block_nb == 1){
-			curr_root_entry->next = NULL;
-			curr_root_entry->empty_block_nb = 0;
-		}
-		else{
-			curr_root_entry->next = curr_empty_block->next;
-			curr_root_entry->empty_block_nb -= 1;
-		}
-
 		/* Eject Empty Block from the list */
+		EJECT_FULL_BLOCK(device_index, mapping_index, curr_empty_block);
 		INSERT_VICTIM_BLOCK(device_index, curr_empty_block);
 	}
 
@@ -134,14 +869,12 @@ int UPDATE_OLD_PAGE_MAPPING(uint8_t device_index, uint64_t lpn)
 
 		RDBG_FTL(FTL_FAILURE, "New page \n");
 
-	UPDATE_INVERSE_BLOCK_VALIDITY(device_index,
-								  CALC_FLASH(device_index, old_ppn),
-								  CALC_BLOCK(device_index, old_ppn),
-								  CALC_PAGE(device_index, old_ppn),
-								  PAGE_INVALID);
+	ppn_coords_t coords;
+	DECODE_PPN(device_index, old_ppn, &coords);
+	UPDATE_INVERSE_BLOCK_VALIDITY(device_index, coords.flash, coords.block, coords.page, PAGE_INVALID);
 	UPDATE_INVERSE_PAGE_MAPPING(device_index, old_ppn, MAPPING_TABLE_INIT_VAL);
 
-    pthread_cond_signal(&gc_threads[device_index].gc_signal_cond);
+    WAKE_GC_THREAD(device_index);
 
 	return FTL_SUCCESS;
 }
@@ -152,12 +885,30 @@ int UPDATE_NEW_PAGE_MAPPING(uint8_t device_index, uint64_t lpn, uint64_t ppn)
 	{
 		PERR("overflow!\n");
 	}
+	MAPPING_CACHE_ACCESS(device_index, lpn, true);
+
 	/* Update Page Mapping Table */
-	mapping_table[device_index][lpn] = ppn;
+	if (devices[device_index].mapping_extents)
+	{
+		if (_UPDATE_EXTENT_MAPPING(device_index, lpn, ppn) != FTL_SUCCESS)
+			return FTL_FAILURE;
+	}
+	else if (devices[device_index].mapping_table_mmap)
+	{
+		uint64_t region = (lpn * devices[device_index].mapping_entry_size) >> MAPPING_DIRTY_REGION_SHIFT;
+		mapping_mmaps[device_index].dirty_bitmap[region / 64] |= 1ULL << (region % 64);
+		_STORE_MMAP_ENTRY(device_index, lpn, ppn);
+	}
+	else
+	{
+		STORE_MAPPING_ENTRY(mapping_table[device_index], devices[device_index].mapping_entry_size, lpn, ppn);
+	}
 
 	/* Update Inverse Page Mapping Table */
-	UPDATE_INVERSE_BLOCK_VALIDITY(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), CALC_PAGE(device_index, ppn), PAGE_VALID);
-	UPDATE_INVERSE_BLOCK_MAPPING(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), DATA_BLOCK);
+	ppn_coords_t coords;
+	DECODE_PPN(device_index, ppn, &coords);
+	UPDATE_INVERSE_BLOCK_VALIDITY(device_index, coords.flash, coords.block, coords.page, PAGE_VALID);
+	UPDATE_INVERSE_BLOCK_MAPPING(device_index, coords.flash, coords.block, DATA_BLOCK);
 	UPDATE_INVERSE_PAGE_MAPPING(device_index, ppn, lpn);
 
 	return FTL_SUCCESS;
@@ -166,15 +917,30 @@ int UPDATE_NEW_PAGE_MAPPING(uint8_t device_index, uint64_t lpn, uint64_t ppn)
 int UPDATE_NEW_PAGE_MAPPING_NO_LOGICAL(uint8_t device_index, uint64_t ppn)
 {
 	/* Update Inverse Page Mapping Table */
-	UPDATE_INVERSE_BLOCK_VALIDITY(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), CALC_PAGE(device_index, ppn), PAGE_VALID);
-	UPDATE_INVERSE_BLOCK_MAPPING(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), DATA_BLOCK);
+	ppn_coords_t coords;
+	DECODE_PPN(device_index, ppn, &coords);
+	UPDATE_INVERSE_BLOCK_VALIDITY(device_index, coords.flash, coords.block, coords.page, PAGE_VALID);
+	UPDATE_INVERSE_BLOCK_MAPPING(device_index, coords.flash, coords.block, DATA_BLOCK);
 
 	return FTL_SUCCESS;
 }
 
+/* Decode ppn in a single pass using the divisors precomputed in devices[].geometry */
+void DECODE_PPN(uint8_t device_index, uint64_t ppn, ppn_coords_t* coords)
+{
+	const ssd_geometry_t* geometry = &devices[device_index].geometry;
+	uint64_t flash_block = GEOMETRY_DIVMOD(&geometry->page_nb, ppn, &coords->page);
+
+	coords->flash = GEOMETRY_DIVMOD(&geometry->block_nb, flash_block, &coords->block);
+	coords->plane = GEOMETRY_MOD(&geometry->planes_per_flash, coords->block);
+	coords->reg = coords->flash * devices[device_index].planes_per_flash + coords->plane;
+	coords->channel = GEOMETRY_MOD(&geometry->channel_nb, coords->flash);
+}
+
 unsigned int CALC_FLASH(uint8_t device_index, uint64_t ppn)
 {
-	unsigned int flash_nb = (ppn / devices[device_index].page_nb) / devices[device_index].block_nb;
+	const ssd_geometry_t* geometry = &devices[device_index].geometry;
+	unsigned int flash_nb = GEOMETRY_DIV(&geometry->block_nb, GEOMETRY_DIV(&geometry->page_nb, ppn));
 
 	if (flash_nb >= devices[device_index].flash_nb)
 	{
@@ -185,41 +951,30 @@ unsigned int CALC_FLASH(uint8_t device_index, uint64_t ppn)
 
 uint64_t CALC_BLOCK(uint8_t device_index, uint64_t ppn)
 {
-	uint64_t block_nb = (ppn / devices[device_index].page_nb) % devices[device_index].block_nb;
+	const ssd_geometry_t* geometry = &devices[device_index].geometry;
 
-	if (block_nb >= devices[device_index].block_nb)
-	{
-		PERR("block_nb %lu\n", block_nb);
-	}
-	return block_nb;
+	return GEOMETRY_MOD(&geometry->block_nb, GEOMETRY_DIV(&geometry->page_nb, ppn));
 }
 
 uint64_t CALC_PAGE(uint8_t device_index, uint64_t ppn)
 {
-	unsigned int page_nb = ppn % devices[device_index].page_nb;
-
-	return page_nb;
+	return GEOMETRY_MOD(&devices[device_index].geometry.page_nb, ppn);
 }
 
 unsigned int CALC_PLANE(uint8_t device_index, uint64_t ppn)
 {
-	int flash_nb = CALC_FLASH(device_index, ppn);
-	int block_nb = CALC_BLOCK(device_index, ppn);
-	int plane;
+	ppn_coords_t coords;
 
-	plane = flash_nb * devices[device_index].planes_per_flash + block_nb % devices[device_index].planes_per_flash;
-
-	return plane;
+	DECODE_PPN(device_index, ppn, &coords);
+	return coords.reg;
 }
 
 unsigned int CALC_CHANNEL(uint8_t device_index, uint64_t ppn)
 {
-	int flash_nb = CALC_FLASH(device_index, ppn);
-	int channel;
-
-	channel = flash_nb % devices[device_index].channel_nb;
+	ppn_coords_t coords;
 
-	return channel;
+	DECODE_PPN(device_index, ppn, &coords);
+	return coords.channel;
 }
 
 unsigned int CALC_SCOPE_FIRST_PAGE(uint8_t device_index, uint64_t address, int scope)
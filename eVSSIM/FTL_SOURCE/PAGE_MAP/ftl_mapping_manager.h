@@ -7,20 +7,164 @@
 #define _MAPPING_MANAGER_H_
 
 #include "ftl.h"
+#include "uthash.h"
 
-extern uint64_t** mapping_table;
+/*
+ * Mapping tables hold either uint64_t or, when the geometry allows it,
+ * uint32_t entries (see mapping_entry_size). The accessors below hide the
+ * width and translate MAPPING_COMPACT_INIT_VAL to MAPPING_TABLE_INIT_VAL.
+ */
+extern void** mapping_table;
+
+static inline uint64_t LOAD_MAPPING_ENTRY(const void* table, uint32_t entry_size, uint64_t index)
+{
+	if (entry_size == sizeof(uint32_t))
+	{
+		uint32_t entry = ((const uint32_t *)table)[index];
+		return entry == MAPPING_COMPACT_INIT_VAL ? MAPPING_TABLE_INIT_VAL : entry;
+	}
+	return ((const uint64_t *)table)[index];
+}
+
+static inline void STORE_MAPPING_ENTRY(void* table, uint32_t entry_size, uint64_t index, uint64_t value)
+{
+	if (entry_size == sizeof(uint32_t))
+		((uint32_t *)table)[index] = value == MAPPING_TABLE_INIT_VAL ? MAPPING_COMPACT_INIT_VAL : (uint32_t)value;
+	else
+		((uint64_t *)table)[index] = value;
+}
+
+/* Set every entry of a table to MAPPING_TABLE_INIT_VAL (all ones in both widths) */
+static inline void RESET_MAPPING_ENTRIES(void* table, uint32_t entry_size, uint64_t entry_nb)
+{
+	memset(table, 0xff, entry_size * entry_nb);
+}
+
+/* Dirty tracking granularity of an mmap'ed mapping table (64KB regions) */
+#define MAPPING_DIRTY_REGION_SHIFT 16
+#define MAPPING_DIRTY_REGION_SIZE (1UL << MAPPING_DIRTY_REGION_SHIFT)
+
+/*
+ * State of a mapping table that is backed by ./data/<idx>/mapping_table.map.
+ * Entries are stored one's-complemented, so a freshly truncated (sparse, zero
+ * filled) file reads back as MAPPING_TABLE_INIT_VAL without touching it.
+ */
+typedef struct mapping_mmap {
+    int fd;
+    size_t size;
+    uint64_t* dirty_bitmap;
+    uint64_t* flush_bitmap;
+    uint64_t dirty_word_nb;
+    pthread_t flush_tid;
+    pthread_mutex_t flush_signal_lock;
+    pthread_cond_t flush_signal_cond;
+    bool flush_stop_flag;
+    uint64_t flushed_region_nb;
+} mapping_mmap_t;
+
+extern mapping_mmap_t* mapping_mmaps;
+
+#define MAPPING_CACHE_NO_SLOT UINT32_MAX
+#define MAPPING_CACHE_REFERENCED 0x1
+#define MAPPING_CACHE_DIRTY 0x2
+
+/*
+ * DFTL-style cached mapping table. Translation pages (page_size worth of
+ * entries each) are cached in slot_nb slots and evicted with the clock
+ * algorithm; misses and dirty evictions are charged as flash page reads and
+ * writes. The backing mapping_table keeps the authoritative entries.
+ */
+typedef struct mapping_cache {
+    uint64_t entries_per_tpage;
+    uint64_t tpage_nb;
+    uint32_t slot_nb;
+    uint32_t clock_hand;
+    uint64_t* slot_tvpn;
+    uint8_t* slot_flags;
+    uint32_t* tvpn_slot;
+    uint64_t hit_nb;
+    uint64_t miss_nb;
+    uint64_t writeback_nb;
+} mapping_cache_t;
+
+extern mapping_cache_t* mapping_caches;
+
+/*
+ * Extent mapping: runs of consecutive lpns whose ppns advance by a fixed
+ * stride (1 inside a block, a whole flash when the allocator stripes pages
+ * over the planes) are kept as single extents, sorted by lpn. Pages remapped
+ * inside a run, and lone pages that do not extend any run, are kept as page
+ * overrides which take precedence over the extents. Replaces the flat
+ * mapping_table.
+ */
+typedef struct mapping_extent {
+    uint64_t lpn;
+    uint64_t ppn;
+    uint64_t length;
+    int64_t stride;
+    uint64_t override_nb;
+} mapping_extent_t;
+
+typedef struct mapping_override {
+    uint64_t lpn;
+    uint64_t ppn;
+    UT_hash_handle hh;
+} mapping_override_t;
+
+typedef struct mapping_extents {
+    mapping_extent_t* extents;
+    uint64_t extent_nb;
+    uint64_t extent_capacity;
+    mapping_override_t* overrides;
+    uint64_t override_nb;
+} mapping_extents_t;
+
+extern mapping_extents_t* mapping_extents;
+
+/*
+ * Recent host write counts of the lpns, for hot/cold stream separation. The counts saturate, and
+ * are all halved every page_mapping_entry_nb host writes so they follow the update frequency.
+ */
+typedef struct write_heat {
+    uint8_t* write_counts;
+    uint64_t write_nb;
+} write_heat_t;
+
+extern write_heat_t* write_heats;
 
 void INIT_MAPPING_TABLE(uint8_t device_index);
 void TERM_MAPPING_TABLE(uint8_t device_index);
+void FLUSH_MAPPING_TABLE(uint8_t device_index);
 
 uint64_t GET_MAPPING_INFO(uint8_t device_index, uint64_t lpn);
+uint64_t GET_MAPPING_RUN(uint8_t device_index, uint64_t lpn, uint64_t max_page_nb, uint64_t* ppn, int64_t* ppn_stride);
+/* Allocates a page on the hot write stream, GET_NEW_STREAM_PAGE on a given WRITE_STREAM_* */
 ftl_ret_val GET_NEW_PAGE(uint8_t device_index, int mode, uint64_t mapping_index, uint64_t* ppn);
-ftl_ret_val DEFAULT_NEXT_PAGE_ALGO(uint8_t device_index, int mode, uint64_t mapping_index, uint64_t* ppn);
+ftl_ret_val GET_NEW_STREAM_PAGE(uint8_t device_index, int mode, uint64_t mapping_index, int stream, uint64_t* ppn);
+ftl_ret_val DEFAULT_NEXT_PAGE_ALGO(uint8_t device_index, int mode, uint64_t mapping_index, int stream, uint64_t* ppn);
+
+/*
+ * Records a host write of lpn and returns the write stream it goes to: WRITE_STREAM_HOT when the
+ * page was written write_stream_hot_write_nb times lately, WRITE_STREAM_COLD otherwise. Always
+ * WRITE_STREAM_HOT without stream separation.
+ */
+int GET_WRITE_STREAM(uint8_t device_index, uint64_t lpn);
 
 int UPDATE_OLD_PAGE_MAPPING(uint8_t device_index, uint64_t lpn);
 int UPDATE_NEW_PAGE_MAPPING(uint8_t device_index, uint64_t lpn, uint64_t ppn);
 int UPDATE_NEW_PAGE_MAPPING_NO_LOGICAL(uint8_t device_index, uint64_t ppn);
 
+/* All the coordinates of a physical page */
+typedef struct ppn_coords {
+	unsigned int flash;
+	uint64_t block;
+	uint64_t page;
+	unsigned int plane;		/* plane of the block inside its flash */
+	unsigned int reg;		/* flash-wide plane index, as CALC_PLANE */
+	unsigned int channel;
+} ppn_coords_t;
+
+void DECODE_PPN(uint8_t device_index, uint64_t ppn, ppn_coords_t* coords);
 unsigned int CALC_FLASH(uint8_t device_index, uint64_t ppn);
 uint64_t CALC_BLOCK(uint8_t device_index, uint64_t ppn);
 uint64_t CALC_PAGE(uint8_t device_index, uint64_t ppn);
@@ -14,6 +14,9 @@ object_id_t current_id;
 
 static struct osd_device osd = { 0x0 };
 static uint8_t *osd_sense = NULL;
+// The object tables and the osd backend are shared by every object device, so
+// they get a lock of their own, always taken after the device lock.
+static pthread_mutex_t obj_table_lock = PTHREAD_MUTEX_INITIALIZER;
 #define OSD_READ_VALUE_OFFSET       (44)
 #define OSD_SENSE_BUFFER_SIZE       (1024)
 
@@ -25,7 +28,7 @@ static uint8_t *osd_sense = NULL;
 
 void INIT_OBJ_STRATEGY(void)
 {
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&obj_table_lock);
     current_id = 1;
     objects_table = NULL;
     objects_mapping = NULL;
@@ -40,7 +43,7 @@ void INIT_OBJ_STRATEGY(void)
     // creating a single partition, to be used later to store all
     // user objects
     assert(!osd_create_partition(&osd, PARTITION_PID_LB, 0, osd_sense));
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&obj_table_lock);
 }
 
 void free_obj_table(void)
@@ -78,7 +81,7 @@ void free_page_table(void)
 
 void TERM_OBJ_STRATEGY(void)
 {
-    pthread_mutex_lock(&g_lock);
+    pthread_mutex_lock(&obj_table_lock);
     free_obj_table();
     free_obj_mapping();
     free_page_table();
@@ -88,7 +91,34 @@ void TERM_OBJ_STRATEGY(void)
         osd_sense = NULL;
         osd_close(&osd);
     }
-    pthread_mutex_unlock(&g_lock);
+    pthread_mutex_unlock(&obj_table_lock);
+}
+
+// Take a free page, dipping into the GC reserve when the device is full. *device_full tells the
+// caller to collect garbage once the request is done.
+static ftl_ret_val _OBJ_GET_NEW_PAGE(uint8_t device_index, uint64_t *page_id, bool *device_full)
+{
+    if (GET_NEW_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, page_id) == FTL_SUCCESS)
+        return FTL_SUCCESS;
+
+    if (GET_NEW_PAGE(device_index, VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb, page_id) == FTL_FAILURE)
+        return FTL_FAILURE;
+
+    *device_full = true;
+    DEV_PINFO(device_index, "obtained a GC reserved page because device is full\n");
+    return FTL_SUCCESS;
+}
+
+// Foreground GC after a request, the same way the sector strategy does it
+static void _OBJ_GC_AFTER_REQUEST(uint8_t device_index, bool device_full)
+{
+#ifdef GC_ON
+    if (devices[device_index].gc_incremental_page_nb > 0) {
+        GC_INCREMENTAL_STEP(device_index);
+    } else if (device_full) {
+        GC_CHECK(device_index, true, false);
+    }
+#endif
 }
 
 ftl_ret_val _FTL_OBJ_READ(uint8_t device_index, obj_id_t obj_loc, void *data, offset_t offset, length_t *p_length)
@@ -138,10 +168,9 @@ ftl_ret_val _FTL_OBJ_READ(uint8_t device_index, obj_id_t obj_loc, void *data, of
     for (curr_io_page_nb = 0; curr_io_page_nb < io_page_nb; curr_io_page_nb++)
     {
         // simulate the page read
-        ret = SSD_PAGE_READ(device_index, CALC_FLASH(device_index, current_page->page_id),
-                    CALC_BLOCK(device_index, current_page->page_id),
-                    CALC_PAGE(device_index, current_page->page_id),
-                    curr_io_page_nb, READ);
+        ppn_coords_t coords;
+        DECODE_PPN(device_index, current_page->page_id, &coords);
+        ret = SSD_PAGE_READ(device_index, coords.flash, coords.block, coords.page, curr_io_page_nb, READ);
 
         // send a physical read action being done to the statistics gathering
         if (ret == FTL_SUCCESS)
@@ -158,7 +187,7 @@ ftl_ret_val _FTL_OBJ_READ(uint8_t device_index, obj_id_t obj_loc, void *data, of
         current_page = current_page->next;
     }
 
-    INCREASE_IO_REQUEST_SEQ_NB();
+    END_IO_REQUEST();
 
     if (data != NULL) {
         uint64_t outlen = 0;
@@ -182,9 +211,12 @@ ftl_ret_val _FTL_OBJ_READ(uint8_t device_index, obj_id_t obj_loc, void *data, of
 
 ftl_ret_val FTL_OBJ_READ(uint8_t device_index, obj_id_t obj_loc, void *data, offset_t offset, length_t *p_length)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+	pthread_mutex_lock(&obj_table_lock);
 	ftl_ret_val ret = _FTL_OBJ_READ(device_index, obj_loc, data, offset, p_length);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_mutex_unlock(&obj_table_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
@@ -201,6 +233,8 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
     int curr_io_page_nb;
     unsigned int ret = FTL_SUCCESS;
     int osd_ret;
+    bool device_full = false;
+    bool invalidated = false;
 
     object = lookup_object(object_loc.object_id);
 
@@ -214,7 +248,7 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
     // if the offset is past the current size of the stored_object we need to append new pages until we can start writing
     while (offset > object->size)
     {
-        if (GET_NEW_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, &page_id) == FTL_FAILURE)
+        if (_OBJ_GET_NEW_PAGE(device_index, &page_id, &device_full) == FTL_FAILURE)
         {
             // not enough memory presumably
             RERR(FTL_FAILURE, "[FTL_WRITE] Get new page fail \n");
@@ -235,7 +269,7 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
             current_page = current_page->next;
 
         // get the pge we'll be writing to
-        if (GET_NEW_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, &page_id) == FTL_FAILURE)
+        if (_OBJ_GET_NEW_PAGE(device_index, &page_id, &device_full) == FTL_FAILURE)
         {
             RERR(FTL_FAILURE, "[FTL_WRITE] Get new page fail \n");
         }
@@ -256,25 +290,20 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
         else // writing over parts of the object
         {
             // invalidate the old physical page and replace the page_node's page
-            UPDATE_INVERSE_BLOCK_VALIDITY(device_index, CALC_FLASH(device_index, current_page->page_id),
-                CALC_BLOCK(device_index, current_page->page_id),
-                CALC_PAGE(device_index, current_page->page_id),
-                PAGE_INVALID);
+            ppn_coords_t old_coords;
+            DECODE_PPN(device_index, current_page->page_id, &old_coords);
+            UPDATE_INVERSE_BLOCK_VALIDITY(device_index, old_coords.flash, old_coords.block, old_coords.page, PAGE_INVALID);
             UPDATE_INVERSE_PAGE_MAPPING(device_index, current_page->page_id, MAPPING_TABLE_INIT_VAL);
 
             HASH_DEL(global_page_table, current_page);
             current_page->page_id = page_id;
             HASH_ADD_INT(global_page_table, page_id, current_page);
+            invalidated = true;
         }
-#ifdef GC_ON
-        // must improve this because it is very possible that we will do multiple GCs on the same flash chip and block
-        // probably gonna add an array to hold the unique ones and in the end GC all of them
 
-        // GC_CHECK(CALC_FLASH(current_page->page_id), CALC_BLOCK(current_page->page_id), false, true);
-#endif
-
-        ret = SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, page_id),
-            CALC_BLOCK(device_index, page_id), CALC_PAGE(device_index, page_id), curr_io_page_nb, WRITE);
+        ppn_coords_t coords;
+        DECODE_PPN(device_index, page_id, &coords);
+        ret = SSD_PAGE_WRITE(device_index, coords.flash, coords.block, coords.page, curr_io_page_nb, WRITE);
 
         // send a physical write action being done to the statistics gathering
         if (ret == FTL_SUCCESS)
@@ -304,7 +333,11 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
         }
     }
 
-    INCREASE_IO_REQUEST_SEQ_NB();
+    END_IO_REQUEST();
+
+    if (invalidated)
+        WAKE_GC_THREAD(device_index);
+    _OBJ_GC_AFTER_REQUEST(device_index, device_full);
 
     PDBG_FTL("Complete\n");
 
@@ -313,43 +346,73 @@ ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void
 
 ftl_ret_val FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void *data, offset_t offset, length_t length)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+	pthread_mutex_lock(&obj_table_lock);
 	ftl_ret_val ret = _FTL_OBJ_WRITE(device_index, object_loc, data, offset, length);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_mutex_unlock(&obj_table_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
-ftl_ret_val _FTL_OBJ_COPYBACK(uint8_t device_index, int32_t source, int32_t destination)
+ftl_ret_val _FTL_OBJ_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destination, int type)
 {
     if (devices[device_index].storage_strategy != STRATEGY_OBJECT) {
         DEV_RERR(FTL_FAILURE, device_index, "wrong storage strategy %d\n", devices[device_index].storage_strategy);
     }
 
-    page_node *source_p;
+    // the object data lives in the osd backend, so only the copyback delays are simulated
+    if (SSD_PAGE_COPYBACK(device_index, source, destination, type) == FTL_FAILURE)
+        RDBG_FTL(FTL_FAILURE, "%lu page copyback fail \n", source);
 
-    source_p = lookup_page(source);
+    return _FTL_OBJ_RELOCATE_PAGE(device_index, source, destination);
+}
 
-    // source_p can be NULL if the GC is working on some old pages that belonged to an object we deleted already
-    if (source_p != NULL)
-    {
-        // invalidate the source page
-        UPDATE_INVERSE_BLOCK_VALIDITY(device_index, CALC_FLASH(device_index, source),
-            CALC_BLOCK(device_index, source), CALC_PAGE(device_index, source), PAGE_INVALID);
+ftl_ret_val _FTL_OBJ_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type)
+{
+    unsigned int i;
 
-        // mark new page as valid and used
-        UPDATE_NEW_PAGE_MAPPING_NO_LOGICAL(device_index, destination);
+    if (devices[device_index].storage_strategy != STRATEGY_OBJECT) {
+        DEV_RERR(FTL_FAILURE, device_index, "wrong storage strategy %d\n", devices[device_index].storage_strategy);
+    }
+
+    if (SSD_MULTI_PLANE_COPYBACK(device_index, sources, destinations, page_nb, type) == FTL_FAILURE)
+        RDBG_FTL(FTL_FAILURE, "%lu multi-plane copyback of %u pages fail \n", sources[0], page_nb);
 
-        // change the object's page mapping to the new page
-        HASH_DEL(global_page_table, source_p);
-        source_p->page_id = destination;
-        HASH_ADD_INT(global_page_table, page_id, source_p);
+    for (i = 0; i < page_nb; i++) {
+        if (_FTL_OBJ_RELOCATE_PAGE(device_index, sources[i], destinations[i]) == FTL_FAILURE)
+            return FTL_FAILURE;
     }
-    else
+
+    return FTL_SUCCESS;
+}
+
+ftl_ret_val _FTL_OBJ_RELOCATE_PAGE(uint8_t device_index, uint64_t source, uint64_t destination)
+{
+    page_node *source_p;
+    ppn_coords_t coords;
+
+    source_p = lookup_page(source);
+
+    // invalidate the source page
+    DECODE_PPN(device_index, source, &coords);
+    UPDATE_INVERSE_BLOCK_VALIDITY(device_index, coords.flash, coords.block, coords.page, PAGE_INVALID);
+
+    // a valid page that no object owns can't be moved anywhere, dropping it is all the GC can do
+    if (source_p == NULL)
     {
-        PDBG_FTL("Warning %u copyback page not mapped to an object \n", source);
-        return FTL_FAILURE;
+        PDBG_FTL("Warning %lu copyback page not mapped to an object \n", source);
+        return FTL_SUCCESS;
     }
 
+    // mark new page as valid and used
+    UPDATE_NEW_PAGE_MAPPING_NO_LOGICAL(device_index, destination);
+
+    // change the object's page mapping to the new page
+    HASH_DEL(global_page_table, source_p);
+    source_p->page_id = destination;
+    HASH_ADD_INT(global_page_table, page_id, source_p);
+
     return FTL_SUCCESS;
 }
 
@@ -361,8 +424,10 @@ bool _FTL_OBJ_CREATE(uint8_t device_index, obj_id_t obj_loc, size_t size)
 
     stored_object *new_object;
     int osd_ret;
+    bool device_full = false;
 
-    new_object = create_object(device_index, obj_loc.object_id, size);
+    new_object = create_object(device_index, obj_loc.object_id, size, &device_full);
+    _OBJ_GC_AFTER_REQUEST(device_index, device_full);
 
     if (new_object == NULL)
     {
@@ -384,9 +449,12 @@ bool _FTL_OBJ_CREATE(uint8_t device_index, obj_id_t obj_loc, size_t size)
 
 bool FTL_OBJ_CREATE(uint8_t device_index, obj_id_t obj_loc, size_t size)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+	pthread_mutex_lock(&obj_table_lock);
 	bool ret = _FTL_OBJ_CREATE(device_index, obj_loc, size);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_mutex_unlock(&obj_table_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
@@ -423,9 +491,12 @@ ftl_ret_val _FTL_OBJ_DELETE(uint8_t device_index, obj_id_t obj_loc)
 
 ftl_ret_val FTL_OBJ_DELETE(uint8_t device_index, obj_id_t obj_loc)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
+	pthread_mutex_lock(&obj_table_lock);
 	ftl_ret_val ret = _FTL_OBJ_DELETE(device_index, obj_loc);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_mutex_unlock(&obj_table_lock);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
@@ -454,9 +525,26 @@ ftl_ret_val _FTL_OBJ_LIST(void *data, size_t *size, uint64_t initial_oid)
 
 ftl_ret_val FTL_OBJ_LIST(void *data, size_t *size, uint64_t initial_oid)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_mutex_lock(&obj_table_lock);
     ftl_ret_val ret = _FTL_OBJ_LIST(data, size, initial_oid);
-	pthread_mutex_unlock(&g_lock);
+	pthread_mutex_unlock(&obj_table_lock);
+	return ret;
+}
+
+bool FTL_OBJ_GC_CHECK(uint8_t device_index, bool force, bool background)
+{
+	// the caller holds the device lock, moving pages rewrites global_page_table
+	pthread_mutex_lock(&obj_table_lock);
+	bool ret = GC_CHECK(device_index, force, background);
+	pthread_mutex_unlock(&obj_table_lock);
+	return ret;
+}
+
+bool FTL_OBJ_GC_IDLE_WORK(uint8_t device_index, int64_t until_us)
+{
+	pthread_mutex_lock(&obj_table_lock);
+	bool ret = GC_IDLE_WORK(device_index, until_us);
+	pthread_mutex_unlock(&obj_table_lock);
 	return ret;
 }
 
@@ -480,7 +568,7 @@ object_map *lookup_object_mapping(object_id_t object_id)
     return obj_map;
 }
 
-stored_object *create_object(uint8_t device_index, object_id_t obj_id, size_t size)
+stored_object *create_object(uint8_t device_index, object_id_t obj_id, size_t size, bool *device_full)
 {
     stored_object *obj = malloc(sizeof(stored_object));
     uint64_t page_id;
@@ -511,7 +599,7 @@ stored_object *create_object(uint8_t device_index, object_id_t obj_id, size_t si
 
     while (size > obj->size)
     {
-        if (GET_NEW_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, &page_id) == FTL_FAILURE)
+        if (_OBJ_GET_NEW_PAGE(device_index, &page_id, device_full) == FTL_FAILURE)
         {
             // cleanup just in case we managed to do anything up until now
             remove_object(device_index, obj, obj_map);
@@ -532,6 +620,8 @@ int remove_object(uint8_t device_index, stored_object *object, object_map *obj_m
 {
     page_node *current_page;
     page_node *invalidated_page;
+    uint64_t *ppns;
+    uint64_t ppn_nb = 0;
 
     if (object == NULL)
         return FTL_SUCCESS;
@@ -547,17 +637,15 @@ int remove_object(uint8_t device_index, stored_object *object, object_map *obj_m
         free(obj_map);
     }
 
+    // the pages are invalidated together, so every block is updated once
+    ppns = malloc((object->size / GET_PAGE_SIZE(device_index) + 1) * sizeof(uint64_t));
+    if (ppns == NULL)
+        RERR(FTL_FAILURE, "malloc failed\n");
+
     current_page = object->pages;
     while (current_page != NULL)
     {
-        // invalidate the physical page and update its mapping
-        UPDATE_INVERSE_BLOCK_VALIDITY(device_index, CALC_FLASH(device_index, current_page->page_id),
-            CALC_BLOCK(device_index, current_page->page_id), CALC_PAGE(device_index, current_page->page_id), PAGE_INVALID);
-
-#ifdef GC_ON
-        // should we really perform GC for every page? we know we are invalidating a lot of them now...
-        // GC_CHECK(CALC_FLASH(current_page->page_id), CALC_BLOCK(current_page->page_id), true, true);
-#endif
+        ppns[ppn_nb++] = current_page->page_id;
 
         // get next page and free the current one
         invalidated_page = current_page;
@@ -569,9 +657,15 @@ int remove_object(uint8_t device_index, stored_object *object, object_map *obj_m
         free(invalidated_page);
     }
 
+    INVALIDATE_INVERSE_PAGES(device_index, ppns, ppn_nb);
+    free(ppns);
+
     // free the object's memory
     free(object);
 
+    if (ppn_nb > 0)
+        WAKE_GC_THREAD(device_index);
+
     return FTL_SUCCESS;
 }
 
@@ -55,10 +55,16 @@ bool FTL_OBJ_CREATE(uint8_t device_index, obj_id_t obj_loc, size_t size);
 ftl_ret_val FTL_OBJ_DELETE(uint8_t device_index, obj_id_t object_loc);
 ftl_ret_val FTL_OBJ_LIST(void *data, size_t *size, uint64_t initial_oid);
 
+// Garbage collection of an object device, taking the object tables lock (used by the GC thread)
+bool FTL_OBJ_GC_CHECK(uint8_t device_index, bool force, bool background);
+bool FTL_OBJ_GC_IDLE_WORK(uint8_t device_index, int64_t until_us);
+
 /* FTL functions */
 ftl_ret_val _FTL_OBJ_READ(uint8_t device_index, obj_id_t object_loc, void *data, offset_t offset, length_t *length);
 ftl_ret_val _FTL_OBJ_WRITE(uint8_t device_index, obj_id_t object_loc, const void *data, offset_t offset, length_t length);
-ftl_ret_val _FTL_OBJ_COPYBACK(uint8_t device_index, int32_t source, int32_t destination);
+ftl_ret_val _FTL_OBJ_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destination, int type);
+ftl_ret_val _FTL_OBJ_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type);
+ftl_ret_val _FTL_OBJ_RELOCATE_PAGE(uint8_t device_index, uint64_t source, uint64_t destination);
 bool _FTL_OBJ_CREATE(uint8_t device_index, obj_id_t obj_loc, size_t size);
 ftl_ret_val _FTL_OBJ_DELETE(uint8_t device_index, obj_id_t object_loc);
 ftl_ret_val _FTL_OBJ_LIST(void *data, size_t *size, uint64_t initial_oid);
@@ -66,7 +72,7 @@ ftl_ret_val _FTL_OBJ_LIST(void *data, size_t *size, uint64_t initial_oid);
 /* Helper functions */
 stored_object *lookup_object(object_id_t object_id);
 object_map *lookup_object_mapping(object_id_t object_id);
-stored_object *create_object(uint8_t device_index, object_id_t obj_id, size_t size);
+stored_object *create_object(uint8_t device_index, object_id_t obj_id, size_t size, bool *device_full);
 int remove_object(uint8_t device_index, stored_object *object, object_map *obj_map);
 
 page_node *allocate_new_page(object_id_t object_id, uint32_t page_id);
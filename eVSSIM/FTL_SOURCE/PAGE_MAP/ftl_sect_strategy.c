@@ -6,8 +6,6 @@ extern ssd_disk ssd;
 
 static uint64_t physical_address_from_logical_address(uint8_t device_index, uint64_t lba, uint64_t* o_ppn);
 
-static ftl_ret_val _READ_STATUS_ENHANCED(void);
-
 #define FAILURE_VALUE UINT64_MAX
 static uint64_t physical_address_from_logical_address(uint8_t device_index, uint64_t lba, uint64_t* o_ppn) {
 	uint64_t lpn = lba / (int32_t)devices[device_index].sectors_per_page;
@@ -49,6 +47,8 @@ ftl_ret_val _FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned in
 	unsigned int ret = FTL_FAILURE;
 	int read_page_nb = 0;
 	int io_page_nb;
+	uint64_t run_page_nb = 0;
+	int64_t run_ppn_stride = 1;
 
 	// just calculate the overhead of allocating the request. io_page_nb will be the total number of pages we're gonna read
 	ssds_manager[device_index].io_alloc_overhead = ALLOC_IO_REQUEST(device_index, sector_nb, length, READ, &io_page_nb);
@@ -76,7 +76,16 @@ ftl_ret_val _FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned in
 		FTL_STATISTICS_GATHERING(device_index, lpn , LOGICAL_READ);
 
 		offset_in_page = lba % (int32_t)devices[device_index].sectors_per_page;
-		ppn = GET_MAPPING_INFO(device_index, lpn);
+		// Consecutive lpns of a mapping run need no further lookups
+		if (run_page_nb == 0)
+		{
+			run_page_nb = GET_MAPPING_RUN(device_index, lpn, io_page_nb - read_page_nb, &ppn, &run_ppn_stride);
+		}
+		else
+		{
+			ppn += run_ppn_stride;
+		}
+		run_page_nb--;
         if (ppn == MAPPING_TABLE_INIT_VAL)
         {
             RDBG_FTL(FTL_FAILURE, "No Mapping info\n");
@@ -102,7 +111,9 @@ ftl_ret_val _FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned in
         }
         else
         { // Only for statistics gathering without an actual reading of data.
-            ret = SSD_PAGE_READ(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), CALC_PAGE(device_index, ppn), read_page_nb, READ);
+            ppn_coords_t coords;
+            DECODE_PPN(device_index, ppn, &coords);
+            ret = SSD_PAGE_READ(device_index, coords.flash, coords.block, coords.page, read_page_nb, READ);
             // Send a physical read action being done to the statistics gathering
             if (ret == FTL_SUCCESS)
             {
@@ -128,7 +139,7 @@ ftl_ret_val _FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned in
 		// read log all together, and refer to the physical one as an indication to both.
 	}
 
-	INCREASE_IO_REQUEST_SEQ_NB();
+	END_IO_REQUEST();
 
 	PDBG_FTL("Complete\n");
 
@@ -137,9 +148,10 @@ ftl_ret_val _FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned in
 
 ftl_ret_val FTL_READ_SECT(uint8_t device_index, uint64_t sector_nb, unsigned int length, unsigned char *data)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_rdlock(DEVICE_LOCK(device_index));
 	ftl_ret_val ret = _FTL_READ_SECT(device_index, sector_nb, length, data);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
@@ -151,53 +163,30 @@ ftl_ret_val _FTL_WRITE(uint8_t device_index, uint64_t sector_nb, unsigned int le
 // **
 // * The following functions are internal helper functions for the use of _FTL_WRITE_SECT
 // **
-static ftl_ret_val read_status_enanched = FTL_FAILURE;
-
-// Checks if a writing is program compatible (there is not actuall writing here).
+// Writes to the ssd without erasing the current mapped physical page, if the writing is program compatible
+// (there is no need to flip bits from 0 to 1). The check and the copy are done in one go on the image,
+// nothing is written when the page isn't compatible.
+// Returns whether the page was written in place, `o_ret` is then the result of the write.
 // NOTE: We assume the parameters are for writing in a single page amount of `length` sectors.
-static void _FTL_WRITE_DRY_SECT(uint8_t device_index, uint64_t lba, unsigned int length, const unsigned char *data) {
-	read_status_enanched = FTL_FAILURE;
+static bool _FTL_WRITE_IN_PLACE(uint8_t device_index, uint64_t lba, int write_page_nb, unsigned int length, const unsigned char *data, ftl_ret_val *o_ret) {
 	if (data == NULL) {
-		read_status_enanched = FTL_FAILURE;
-		return;
-	}
-
-	size_t abs_physical_offset =  physical_address_from_logical_address(device_index, lba, NULL);
-	if (abs_physical_offset == FAILURE_VALUE) {
-		read_status_enanched = FTL_FAILURE;
-		return;
-	}
-
-	if (is_program_compatible(GET_FILE_NAME(device_index), abs_physical_offset, length * GET_SECTOR_SIZE(device_index), data)) {
-		read_status_enanched = FTL_SUCCESS;
-		return;
-	}
-}
-
-// Returns the result of the last call to _FTL_WRITE_DRY_SECT
-static ftl_ret_val _READ_STATUS_ENHANCED(void) {
-	return read_status_enanched;
-}
-
-// Writes to the ssd without erasing the current mapped physical page.
-// NOTE: We assume the parameters are for writing in a single page amount of `length` sectors.
-//		 And we assume the writing happens after making sure the writing is program compatible.
-static ftl_ret_val _FTL_WRITE_COMMIT(uint8_t device_index, uint64_t lba, int write_page_nb, unsigned int length, const unsigned char *data) {
-	if (data == NULL) {
-		return FTL_FAILURE;
+		return false;
 	}
 
 	uint64_t ppn = MAPPING_TABLE_INIT_VAL;
 	size_t abs_physical_offset = physical_address_from_logical_address(device_index, lba, &ppn);
-	if (abs_physical_offset == FAILURE_VALUE || ppn == MAPPING_TABLE_INIT_VAL) {
-		return FTL_FAILURE;
+	if (abs_physical_offset == FAILURE_VALUE) {
+		return false;
 	}
-	ftl_ret_val ret = SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, ppn), CALC_BLOCK(device_index, ppn), CALC_PAGE(device_index, ppn), write_page_nb, WRITE_COMMIT);
-	if (ret == FTL_SUCCESS && ssd_write(GET_FILE_NAME(device_index), abs_physical_offset, length * GET_SECTOR_SIZE(device_index), data) == SSD_FILE_OPS_SUCCESS) {
-		return FTL_SUCCESS;
+
+	if (!ssd_file_program_in_place(SSD_IMAGE(device_index), abs_physical_offset, length * GET_SECTOR_SIZE(device_index), data)) {
+		return false;
 	}
 
-	return FTL_FAILURE;
+	ppn_coords_t coords;
+	DECODE_PPN(device_index, ppn, &coords);
+	*o_ret = SSD_PAGE_WRITE(device_index, coords.flash, coords.block, coords.page, write_page_nb, WRITE_COMMIT);
+	return true;
 }
 // **
 // * End of helper functions for the use of _FTL_WRITE_SECT
@@ -230,7 +219,7 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 	unsigned int write_sects;
 	size_t amount_of_bytes_to_write;
 
-	unsigned int ret = FTL_FAILURE;
+	ftl_ret_val ret = FTL_FAILURE;
 	int write_page_nb=0;
 
 	while (remain > 0)
@@ -253,15 +242,14 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 		// Calculate the offset inside the page
 		offset_in_page = lba % (int32_t)devices[device_index].sectors_per_page;
 
+		// Every write counts towards the update frequency, the in place ones too
+		int stream = GET_WRITE_STREAM(device_index, lpn);
+
 		// First try writing to the page without erasing it if it is program compatile (there is not need to flip bits from 0 to 1).
-		_FTL_WRITE_DRY_SECT(device_index, lba, write_sects, data);
-		if (_READ_STATUS_ENHANCED() == FTL_SUCCESS) {
-			ret = _FTL_WRITE_COMMIT(device_index, lba, write_page_nb, write_sects, data);
-		}
-		else {
-			ret = GET_NEW_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, &new_ppn);
+		if (!_FTL_WRITE_IN_PLACE(device_index, lba, write_page_nb, write_sects, data, &ret)) {
+			ret = GET_NEW_STREAM_PAGE(device_index, VICTIM_OVERALL, devices[device_index].empty_table_entry_nb, stream, &new_ppn);
 			if (ret == FTL_FAILURE) {
-				ret = GET_NEW_PAGE(device_index, VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb, &new_ppn);
+				ret = GET_NEW_STREAM_PAGE(device_index, VICTIM_OVERALL_GC, devices[device_index].empty_table_entry_nb, stream, &new_ppn);
 				if (ret == FTL_FAILURE) {
 					RERR(FTL_FAILURE, "[FTL_WRITE] Get new page fail \n");
 				} else {
@@ -277,7 +265,9 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 				onfi_ret_val onfi_ret = ONFI_PAGE_PROGRAM(device_index, new_ppn, offset_in_page, data, amount_of_bytes_to_write, &nwritten);
 				ret = (onfi_ret == ONFI_SUCCESS && nwritten == amount_of_bytes_to_write) ? FTL_SUCCESS : FTL_FAILURE;
 			} else { // Only for statistics gathering without an actual writing of data.
-				ret = SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, new_ppn), CALC_BLOCK(device_index, new_ppn), CALC_PAGE(device_index, new_ppn), write_page_nb, WRITE);
+				ppn_coords_t coords;
+				DECODE_PPN(device_index, new_ppn, &coords);
+				ret = SSD_PAGE_WRITE(device_index, coords.flash, coords.block, coords.page, write_page_nb, WRITE);
 			}
 
 			// logical page number to physical. will need to be changed to account for objectid
@@ -286,8 +276,8 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 		}
 
 		//we caused a block write -> update the logical block_write counter + update the physical block write counter
-		wa_counters.logical_block_write_counter++;
-		wa_counters.physical_block_write_counter++;
+		wa_counters[device_index].logical_block_write_counter++;
+		wa_counters[device_index].physical_block_write_counter++;
 		//Send a physical write action being done to the statistics gathering
 		if (ret == FTL_SUCCESS)
 		{
@@ -310,10 +300,12 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 		left_skip = 0;
 	}
 
-	INCREASE_IO_REQUEST_SEQ_NB();
+	END_IO_REQUEST();
 
 #ifdef GC_ON
-	if (device_full) {
+	if (devices[device_index].gc_incremental_page_nb > 0) {
+		GC_INCREMENTAL_STEP(device_index);
+	} else if (device_full) {
 		GC_CHECK(device_index, true, false);
 	}
 #endif
@@ -325,12 +317,42 @@ ftl_ret_val _FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned i
 
 ftl_ret_val FTL_WRITE_SECT(uint8_t device_index, uint64_t sector_nb, unsigned int length, const unsigned char *data)
 {
-	pthread_mutex_lock(&g_lock);
+	pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
 	ftl_ret_val ret = _FTL_WRITE_SECT(device_index, sector_nb, length, data);
-	pthread_mutex_unlock(&g_lock);
+	GC_NOTE_HOST_IO(device_index);
+	pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 	return ret;
 }
 
+// Moves the data and the mapping of a page that was copied back
+static ftl_ret_val _FTL_COPYBACK_PAGE(uint8_t device_index, uint64_t source, uint64_t destination)
+{
+	uint64_t lpn; //The logical page address, the page that being moved.
+
+	// Actual page copy
+	unsigned char buff[GET_PAGE_SIZE(device_index)];
+	// If ssd_read failed - this is because we don't call _FTL_CREATE to create the ssd.img.
+	// In this case we don't do anything - this is like happen before this change when the ssd.img was not used in the simulation.
+	if (ssd_file_read(SSD_IMAGE(device_index), source * GET_PAGE_SIZE(device_index), GET_PAGE_SIZE(device_index), buff) == SSD_FILE_OPS_SUCCESS) {
+		if (ssd_file_write(SSD_IMAGE(device_index), destination * GET_PAGE_SIZE(device_index), GET_PAGE_SIZE(device_index), buff) == SSD_FILE_OPS_ERROR) {
+			// If ssd_read succeeded this fail shouldn't happen !!
+			RDBG_FTL(FTL_FAILURE, "%lu page copyback fail \n", source);
+		}
+	}
+
+	//Handle page map
+	GET_INVERSE_MAPPING_INFO(device_index, source, &lpn);
+
+	if (lpn != MAPPING_TABLE_INIT_VAL)
+	{
+		// The given physical page is being map, the mapping information need to be changed,
+		UPDATE_OLD_PAGE_MAPPING(device_index, lpn); //as far as I can tell when being called under the gc manage all the actions are being done, but what if will be called from another place?
+		UPDATE_NEW_PAGE_MAPPING(device_index, lpn, destination);
+	}
+
+	return FTL_SUCCESS;
+}
+
 //Get 2 physical page address, the source page which need to be moved to the destination page
 ftl_ret_val _FTL_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destination, int type)
 {
@@ -338,7 +360,6 @@ ftl_ret_val _FTL_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destin
 		DEV_RERR(FTL_FAILURE, device_index, "wrong storage strategy %d\n", devices[device_index].storage_strategy);
 	}
 
-	uint64_t lpn; //The logical page address, the page that being moved.
 	unsigned int ret = FTL_FAILURE;
 
 	//Handle copyback delays
@@ -354,28 +375,24 @@ ftl_ret_val _FTL_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destin
 	if (ret == FTL_FAILURE)
         RDBG_FTL(FTL_FAILURE, "%u page copyback fail \n", source);
 
-	// Actual page copy
-	unsigned char buff[GET_PAGE_SIZE(device_index)];
-	// If ssd_read failed - this is because we don't call _FTL_CREATE to create the ssd.img.
-	// In this case we don't do anything - this is like happen before this change when the ssd.img was not used in the simulation.
-	if (ssd_read(GET_FILE_NAME(device_index), source * GET_PAGE_SIZE(device_index), GET_PAGE_SIZE(device_index), buff) == SSD_FILE_OPS_SUCCESS) {
-		if (ssd_write(GET_FILE_NAME(device_index), destination * GET_PAGE_SIZE(device_index), GET_PAGE_SIZE(device_index), buff) == SSD_FILE_OPS_ERROR) {
-			// If ssd_read succeeded this fail shouldn't happen !!
-			RDBG_FTL(FTL_FAILURE, "%u page copyback fail \n", source);
-		}
-	}
+	return _FTL_COPYBACK_PAGE(device_index, source, destination);
+}
 
-	//Handle page map
-	GET_INVERSE_MAPPING_INFO(device_index, source, &lpn);
+ftl_ret_val _FTL_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type)
+{
+	unsigned int i;
 
-	if (lpn != MAPPING_TABLE_INIT_VAL)
-	{
-		// The given physical page is being map, the mapping information need to be changed,
-		UPDATE_OLD_PAGE_MAPPING(device_index, lpn); //as far as I can tell when being called under the gc manage all the actions are being done, but what if will be called from another place?
-		UPDATE_NEW_PAGE_MAPPING(device_index, lpn, destination);
+	if (devices[device_index].storage_strategy != STRATEGY_SECTOR) {
+		DEV_RERR(FTL_FAILURE, device_index, "wrong storage strategy %d\n", devices[device_index].storage_strategy);
 	}
 
-	return ret;
+	if (SSD_MULTI_PLANE_COPYBACK(device_index, sources, destinations, page_nb, type) == FTL_FAILURE)
+		RDBG_FTL(FTL_FAILURE, "%lu multi-plane copyback of %u pages fail \n", sources[0], page_nb);
+
+	for (i = 0; i < page_nb; i++)
+		_FTL_COPYBACK_PAGE(device_index, sources[i], destinations[i]);
+
+	return FTL_SUCCESS;
 }
 
 ftl_ret_val _FTL_CREATE(uint8_t device_index)
@@ -385,7 +402,7 @@ ftl_ret_val _FTL_CREATE(uint8_t device_index)
 	}
 
     // no "creation" in address-based storage
-	return (ssd_create(GET_FILE_NAME(device_index), (uint64_t)devices[device_index].sectors_per_page * (uint64_t)devices[device_index].page_nb *
+	return (SSD_IMAGE_CREATE(device_index, (uint64_t)devices[device_index].sectors_per_page * (uint64_t)devices[device_index].page_nb *
 			(uint64_t)devices[device_index].block_nb * (uint64_t)devices[device_index].flash_nb * GET_SECTOR_SIZE(device_index))
 				== SSD_FILE_OPS_SUCCESS) ? FTL_SUCCESS : FTL_FAILURE;
 }
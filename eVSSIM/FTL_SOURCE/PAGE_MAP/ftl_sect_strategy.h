@@ -16,6 +16,7 @@ ftl_ret_val _FTL_READ(uint8_t device_index, uint64_t sector_nb, unsigned int len
 ftl_ret_val _FTL_WRITE(uint8_t device_index, uint64_t sector_nb, unsigned int length, const unsigned char *data);
 
 ftl_ret_val _FTL_COPYBACK(uint8_t device_index, uint64_t source, uint64_t destination, int type);
+ftl_ret_val _FTL_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type);
 ftl_ret_val _FTL_CREATE(uint8_t device_index);
 ftl_ret_val _FTL_DELETE(void);
 
@@ -5,111 +5,89 @@
 
 #include "common.h"
 
-/* Average IO Time */
-double avg_write_delay;
-double total_write_count;
-double total_write_delay;
+perf_checker_t* perf_checkers = NULL;
 
-double avg_read_delay;
-double total_read_count;
-double total_read_delay;
+/* The request the calling thread is serving, UINT32_MAX outside of host requests */
+static TLS uint32_t current_io_request_nb = UINT32_MAX;
 
-double avg_gc_write_delay;
-double total_gc_write_count;
-double total_gc_write_delay;
+static void _FREE_IO_REQUEST(uint8_t device_index, io_request* request);
 
-double avg_gc_read_delay;
-double total_gc_read_count;
-double total_gc_read_delay;
+void INIT_PERF_CHECKER(uint8_t device_index){
 
-/* IO Latency */
-unsigned int io_request_nb;
-unsigned int io_request_seq_nb;
-
-struct io_request* io_request_start;
-struct io_request* io_request_end;
-
-/* Calculate IO Latency */
-double read_latency_count;
-double write_latency_count;
-
-double avg_read_latency;
-double avg_write_latency;
-
-/* SSD Util */
-double ssd_util;
-uint64_t written_page_nb;
-
-void INIT_PERF_CHECKER(void){
+	perf_checker_t* perf = &perf_checkers[device_index];
 
 	/* Average IO Time */
-	avg_write_delay = 0;
-	total_write_count = 0;
-	total_write_delay = 0;
+	perf->avg_write_delay = 0;
+	perf->total_write_count = 0;
+	perf->total_write_delay = 0;
 
-	avg_read_delay = 0;
-	total_read_count = 0;
-	total_read_delay = 0;
+	perf->avg_read_delay = 0;
+	perf->total_read_count = 0;
+	perf->total_read_delay = 0;
 
-	avg_gc_write_delay = 0;
-	total_gc_write_count = 0;
-	total_gc_write_delay = 0;
+	perf->avg_gc_write_delay = 0;
+	perf->total_gc_write_count = 0;
+	perf->total_gc_write_delay = 0;
 
-	avg_gc_read_delay = 0;
-	total_gc_read_count = 0;
-	total_gc_read_delay = 0;
+	perf->avg_gc_read_delay = 0;
+	perf->total_gc_read_count = 0;
+	perf->total_gc_read_delay = 0;
 
 	/* IO Latency */
-	io_request_nb = 0;
-	io_request_seq_nb = 0;
+	perf->io_request_nb = 0;
+	perf->io_request_seq_nb = 0;
 
-	io_request_start = NULL;
-	io_request_end = NULL;
+	perf->io_request_start = NULL;
+	perf->io_request_end = NULL;
 
-	read_latency_count = 0;
-	write_latency_count = 0;
+	perf->read_latency_count = 0;
+	perf->write_latency_count = 0;
 
-	avg_read_latency = 0;
-	avg_write_latency = 0;
+	perf->avg_read_latency = 0;
+	perf->avg_write_latency = 0;
 
-	ssd_util = 0;
-	written_page_nb = 0;
+	perf->ssd_util = 0;
+	perf->written_page_nb = 0;
 }
 
-void TERM_PERF_CHECKER(void){
+void TERM_PERF_CHECKER(uint8_t device_index){
+
+	perf_checker_t* perf = &perf_checkers[device_index];
 
-	while (io_request_nb) {
-		FREE_IO_REQUEST(io_request_start);
+	while (perf->io_request_nb) {
+		FREE_IO_REQUEST(device_index, perf->io_request_start);
 	}
 
-	printf("Average Read Latency	%.3lf us\n", avg_read_latency);
-	printf("Average Write Latency	%.3lf us\n", avg_write_latency);
+	printf("Average Read Latency	%.3lf us\n", perf->avg_read_latency);
+	printf("Average Write Latency	%.3lf us\n", perf->avg_write_latency);
 }
 
-void SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, int type){
+static void _SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, int type){
+
+	perf_checker_t* perf = &perf_checkers[device_index];
 
 	double delay = (double)op_delay;
 	if(type == CH_OP){
 		switch(op_type){
 			case READ:
-				total_read_delay += delay;
-				total_read_count++;
-				avg_read_delay = total_read_delay / total_read_count;
+				perf->total_read_delay += delay;
+				perf->total_read_count++;
+				perf->avg_read_delay = perf->total_read_delay / perf->total_read_count;
 				break;
 
 			case WRITE:
-				total_write_delay += delay;
+				perf->total_write_delay += delay;
 				break;
 
 			case ERASE:
 				break;
 
 			case GC_READ:
-				total_gc_read_delay += delay;
+				perf->total_gc_read_delay += delay;
 				break;
 
 			case GC_WRITE:
-				total_gc_write_delay += delay;
+				perf->total_gc_write_delay += delay;
 				break;
 			case COPYBACK:
 				break;
@@ -120,35 +98,35 @@ void SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, i
 	else if(type == REG_OP){
 		switch (op_type){
 			case READ:
-				total_read_delay += delay;
+				perf->total_read_delay += delay;
 				break;
 
 			case WRITE:
-				total_write_delay += delay;
-				total_write_count++;
-				avg_write_delay = total_write_delay / total_write_count;
+				perf->total_write_delay += delay;
+				perf->total_write_count++;
+				perf->avg_write_delay = perf->total_write_delay / perf->total_write_count;
 
 				/* Calc SSD Util */
-				written_page_nb++;
+				perf->written_page_nb++;
 				break;
 
 			case ERASE:
-				written_page_nb -= devices[device_index].page_nb;
+				perf->written_page_nb -= devices[device_index].page_nb;
 				break;
 
 			case GC_READ:
-				total_gc_read_delay += delay;
-				total_gc_read_count++;
-				avg_gc_read_delay = total_gc_read_delay / total_gc_read_count;
+				perf->total_gc_read_delay += delay;
+				perf->total_gc_read_count++;
+				perf->avg_gc_read_delay = perf->total_gc_read_delay / perf->total_gc_read_count;
 				break;
 
 			case GC_WRITE:
-				total_gc_write_delay += delay;
-				total_gc_write_count++;
-				avg_gc_write_delay = total_gc_write_delay / total_gc_write_count;
+				perf->total_gc_write_delay += delay;
+				perf->total_gc_write_count++;
+				perf->avg_gc_write_delay = perf->total_gc_write_delay / perf->total_gc_write_count;
 
 				/* Calc SSD Util */
-				written_page_nb++;
+				perf->written_page_nb++;
 				break;
 			case COPYBACK:
 				break;
@@ -156,18 +134,18 @@ void SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, i
 				break;
 		}
 
-		ssd_util = (double)((double)written_page_nb / devices[device_index].pages_in_ssd)*100;
+		perf->ssd_util = (double)((double)perf->written_page_nb / devices[device_index].pages_in_ssd)*100;
 	}
 	else if(type == LATENCY_OP){
 		switch (op_type){
 			case READ:
-				avg_read_latency = (avg_read_latency * read_latency_count + delay)/(read_latency_count + 1);
+				perf->avg_read_latency = (perf->avg_read_latency * perf->read_latency_count + delay)/(perf->read_latency_count + 1);
 
-				read_latency_count++;
+				perf->read_latency_count++;
 				break;
 			case WRITE:
-				avg_write_latency = (avg_write_latency * write_latency_count + delay)/(write_latency_count + 1);
-				write_latency_count++;
+				perf->avg_write_latency = (perf->avg_write_latency * perf->write_latency_count + delay)/(perf->write_latency_count + 1);
+				perf->write_latency_count++;
 				break;
 			default:
 				break;
@@ -175,6 +153,13 @@ void SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, i
 	}
 }
 
+void SEND_TO_PERF_CHECKER(uint8_t device_index, int op_type, int64_t op_delay, int type){
+
+	pthread_mutex_lock(&perf_checkers[device_index].lock);
+	_SEND_TO_PERF_CHECKER(device_index, op_type, op_delay, type);
+	pthread_mutex_unlock(&perf_checkers[device_index].lock);
+}
+
 double GET_IO_BANDWIDTH(uint8_t device_index, double delay)
 {
 	double bw;
@@ -190,6 +175,7 @@ double GET_IO_BANDWIDTH(uint8_t device_index, double delay)
 
 int64_t ALLOC_IO_REQUEST(uint8_t device_index, uint32_t sector_nb, unsigned int length, int io_type, int* page_nb)
 {
+	perf_checker_t* perf = &perf_checkers[device_index];
 	int64_t start = get_usec();
 	int io_page_nb = 0;
 	unsigned int remain = length;
@@ -224,8 +210,6 @@ int64_t ALLOC_IO_REQUEST(uint8_t device_index, uint32_t sector_nb, unsigned int
 	memset(start_time_arr, 0, io_page_nb);
 	memset(end_time_arr, 0, io_page_nb);
 
-	curr_io_request->request_nb = io_request_seq_nb;
-
 	curr_io_request->request_type = io_type;
 	curr_io_request->request_size = io_page_nb;
 	curr_io_request->start_count = 0;
@@ -234,88 +218,73 @@ int64_t ALLOC_IO_REQUEST(uint8_t device_index, uint32_t sector_nb, unsigned int
 	curr_io_request->end_time = end_time_arr;
 	curr_io_request->next = NULL;
 
-	if(io_request_start == NULL && io_request_nb == 0){
-		io_request_start = curr_io_request;
-		io_request_end = curr_io_request;
+	pthread_mutex_lock(&perf->lock);
+	curr_io_request->request_nb = perf->io_request_seq_nb;
+	current_io_request_nb = curr_io_request->request_nb;
+	if (perf->io_request_seq_nb == UINT32_MAX) {
+		perf->io_request_seq_nb = 0;
 	}
 	else{
-		io_request_end->next = curr_io_request;
-		io_request_end = curr_io_request;
+		perf->io_request_seq_nb++;
 	}
-	io_request_nb++;
+
+	if(perf->io_request_start == NULL && perf->io_request_nb == 0){
+		perf->io_request_start = curr_io_request;
+		perf->io_request_end = curr_io_request;
+	}
+	else{
+		perf->io_request_end->next = curr_io_request;
+		perf->io_request_end = curr_io_request;
+	}
+	perf->io_request_nb++;
+	pthread_mutex_unlock(&perf->lock);
 
 	int64_t end = get_usec();
 
 	return (end - start);
 }
 
-void FREE_DUMMY_IO_REQUEST(void)
+void FREE_DUMMY_IO_REQUEST(uint8_t device_index)
 {
-	uint32_t i;
-	int success = 0;
-	io_request* prev_request = io_request_start;
-
-	io_request* request = LOOKUP_IO_REQUEST(io_request_seq_nb);
-
-
-	if(io_request_nb == 1){
-		io_request_start = NULL;
-		io_request_end = NULL;
-		success = 1;
-	}
-	else if(prev_request == request){
-		io_request_start = request->next;
-		success = 1;
-	}
-	else{
-		for(i=0;i<(io_request_nb-1);i++){
-			if(prev_request->next == request && request == io_request_end){
-				prev_request->next = NULL;
-				io_request_end = prev_request;
-				success = 1;
-				break;
-			}
-			else if(prev_request->next == request){
-				prev_request->next = request->next;
-				success = 1;
-				break;
-			}
-			else{
-				prev_request = prev_request->next;
-			}
-		}
-	}
+	perf_checker_t* perf = &perf_checkers[device_index];
 
-	if (success == 0)
-		RERR(, "There is no such io request\n");
-
-	free(request->start_time);
-	free(request->end_time);
-	free(request);
+	pthread_mutex_lock(&perf->lock);
+	io_request* request = LOOKUP_IO_REQUEST(device_index, current_io_request_nb);
+	if (request != NULL)
+		_FREE_IO_REQUEST(device_index, request);
+	else
+		PERR("There is no such io request\n");
+	pthread_mutex_unlock(&perf->lock);
+}
 
-	io_request_nb--;
+void FREE_IO_REQUEST(uint8_t device_index, io_request* request)
+{
+	pthread_mutex_lock(&perf_checkers[device_index].lock);
+	_FREE_IO_REQUEST(device_index, request);
+	pthread_mutex_unlock(&perf_checkers[device_index].lock);
 }
 
-void FREE_IO_REQUEST(io_request* request)
+static void _FREE_IO_REQUEST(uint8_t device_index, io_request* request)
 {
+	perf_checker_t* perf = &perf_checkers[device_index];
 	uint32_t i;
 	int success = 0;
-	io_request* prev_request = io_request_start;
+	io_request* prev_request = perf->io_request_start;
 
-	if(io_request_nb == 1){
-		io_request_start = NULL;
-		io_request_end = NULL;
+	if(perf->io_request_nb == 1){
+		perf->io_request_start = NULL;
+		perf->io_request_end = NULL;
 		success = 1;
 	}
 	else if(prev_request == request){
-		io_request_start = request->next;
+		perf->io_request_start = request->next;
 		success = 1;
 	}
 	else{
-		for(i=0;i<(io_request_nb-1);i++){
-			if(prev_request->next == request && request == io_request_end){
+		for(i=0;i<(perf->io_request_nb-1);i++){
+			if(prev_request->next == request && request == perf->io_request_end){
 				prev_request->next = NULL;
-				io_request_end = prev_request;
+				perf->io_request_end = prev_request;
 				success = 1;
 				break;
 			}
@@ -337,7 +306,7 @@ void FREE_IO_REQUEST(io_request* request)
 	free(request->end_time);
 	free(request);
 
-	io_request_nb--;
+	perf->io_request_nb--;
 }
 
 int64_t UPDATE_IO_REQUEST(uint8_t device_index, uint32_t request_nb, int offset, int64_t time, int type)
@@ -351,9 +320,12 @@ int64_t UPDATE_IO_REQUEST(uint8_t device_index, uint32_t request_nb, int offset,
 		return 0;
 	}
 
-	io_request* curr_request = LOOKUP_IO_REQUEST(request_nb);
-	if (curr_request == NULL)
+	pthread_mutex_lock(&perf_checkers[device_index].lock);
+	io_request* curr_request = LOOKUP_IO_REQUEST(device_index, request_nb);
+	if (curr_request == NULL) {
+		pthread_mutex_unlock(&perf_checkers[device_index].lock);
 		RDBG_FTL(0, "No such io request, nb %d\n", request_nb);
+	}
 
 	if(type == UPDATE_START_TIME){
 		curr_request->start_time[offset] = time;
@@ -368,34 +340,36 @@ int64_t UPDATE_IO_REQUEST(uint8_t device_index, uint32_t request_nb, int offset,
 		latency = CALC_IO_LATENCY(device_index, curr_request);
 		io_type = curr_request->request_type;
 
-		SEND_TO_PERF_CHECKER(device_index, io_type, latency, LATENCY_OP);
+		_SEND_TO_PERF_CHECKER(device_index, io_type, latency, LATENCY_OP);
 
-		FREE_IO_REQUEST(curr_request);
+		_FREE_IO_REQUEST(device_index, curr_request);
 	}
+	pthread_mutex_unlock(&perf_checkers[device_index].lock);
 	int64_t end = get_usec();
 
 	return (end - start);
 }
 
-void INCREASE_IO_REQUEST_SEQ_NB(void)
+uint32_t CURRENT_IO_REQUEST_NB(void)
 {
-	if (io_request_seq_nb == UINT32_MAX) {
-		io_request_seq_nb = 0;
-	}
-	else{
-		io_request_seq_nb++;
-	}
+	return current_io_request_nb;
+}
+
+void END_IO_REQUEST(void)
+{
+	current_io_request_nb = UINT32_MAX;
 }
 
-io_request* LOOKUP_IO_REQUEST(uint32_t request_nb)
+io_request* LOOKUP_IO_REQUEST(uint8_t device_index, uint32_t request_nb)
 {
+	perf_checker_t* perf = &perf_checkers[device_index];
 	uint32_t i;
 	uint32_t total_request=0;
 	io_request* curr_request = NULL;
 
-	if(io_request_start != NULL){
-		curr_request = io_request_start;
-		total_request = io_request_nb;
+	if(perf->io_request_start != NULL){
+		curr_request = perf->io_request_start;
+		total_request = perf->io_request_nb;
 	}
 	else
 		RDBG_FTL(NULL, "There is no request\n");
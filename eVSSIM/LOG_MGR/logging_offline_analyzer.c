@@ -185,6 +185,20 @@ void offline_log_analyzer_loop(OfflineLogAnalyzer* analyzer) {
                     JSON_SSD_UTILIZATION(&log, &json_buf);
                     break;
                 }
+                case MAPPING_CACHE_LOG_UID:
+                {
+                    MappingCacheLog res;
+                    NEXT_MAPPING_CACHE_LOG(analyzer->logger_pool, &res, OFFLINE_ANALYZER);
+                    JSON_MAPPING_CACHE(&res, &json_buf);
+                    break;
+                }
+                case WEAR_LEVELING_LOG_UID:
+                {
+                    WearLevelingLog res;
+                    NEXT_WEAR_LEVELING_LOG(analyzer->logger_pool, &res, OFFLINE_ANALYZER);
+                    JSON_WEAR_LEVELING(&res, &json_buf);
+                    break;
+                }
                 default:
                     fprintf(stderr, "WARNING: unknown log type id! [%d]\n", log_type);
                     fprintf(stderr, "WARNING: rt_log_analyzer_loop may not be up to date!\n");
@@ -314,6 +314,7 @@ void JSON_BLOCK_ERASE(BlockEraseLog *src, char **dst)
     json_object_object_add(jobj, "die", json_object_new_int(src->die));
     json_object_object_add(jobj, "block", json_object_new_int(src->block));
     json_object_object_add(jobj, "dirty_page_nb", json_object_new_int(src->dirty_page_nb));
+    json_object_object_add(jobj, "erase_count", json_object_new_int(src->erase_count));
     json_object_object_add(jobj, "background", json_object_new_boolean(src->background));
     add_metadata_to_json_object(jobj, &src->metadata);
 
@@ -502,6 +503,60 @@ void JSON_SSD_UTILIZATION(SsdUtilizationLog *src, char **dst)
     json_object_put(jobj); // Delete the json object
 }
 
+/**
+ * writes a mapping cache log in json format to a given string
+ * @param src the struct containing all the data to be added to the json
+ * @param dst the pointer to the written string
+ */
+void JSON_MAPPING_CACHE(MappingCacheLog *src, char **dst)
+{
+    struct json_object *jobj;
+
+    jobj = json_object_new_object();
+    json_object_object_add(jobj, "type", json_object_new_string("MappingCacheLog"));
+    json_object_object_add(jobj, "hit", json_object_new_boolean(src->hit));
+    json_object_object_add(jobj, "writeback", json_object_new_boolean(src->writeback));
+    add_metadata_to_json_object(jobj, &src->metadata);
+
+    const char *json_string = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_SPACED);
+
+    size_t json_length = strlen(json_string);
+    *dst = (char *)malloc(json_length + 2);
+
+    strcpy(*dst, json_string);
+    strcat(*dst, "\n");
+    json_object_put(jobj); // Delete the json object
+}
+
+/**
+ * writes a wear leveling log in json format to a given string
+ * @param src the struct containing all the data to be added to the json
+ * @param dst the pointer to the written string
+ */
+void JSON_WEAR_LEVELING(WearLevelingLog *src, char **dst)
+{
+    struct json_object *jobj;
+
+    jobj = json_object_new_object();
+    json_object_object_add(jobj, "type", json_object_new_string("WearLevelingLog"));
+    json_object_object_add(jobj, "die", json_object_new_int(src->die));
+    json_object_object_add(jobj, "block", json_object_new_int(src->block));
+    json_object_object_add(jobj, "erase_count", json_object_new_int(src->erase_count));
+    json_object_object_add(jobj, "max_erase_count", json_object_new_int(src->max_erase_count));
+    json_object_object_add(jobj, "moved_page_nb", json_object_new_int(src->moved_page_nb));
+    json_object_object_add(jobj, "background", json_object_new_boolean(src->background));
+    add_metadata_to_json_object(jobj, &src->metadata);
+
+    const char *json_string = json_object_to_json_string_ext(jobj, JSON_C_TO_STRING_SPACED);
+
+    size_t json_length = strlen(json_string);
+    *dst = (char *)malloc(json_length + 2);
+
+    strcpy(*dst, json_string);
+    strcat(*dst, "\n");
+    json_object_put(jobj); // Delete the json object
+}
+
 #define _LOGS_WRITER_DEFINITION_APPLIER(structure, name)            \
     void CONCAT(LOG_, name)(Logger_Pool * logger, structure buffer) \
     {                                                               \
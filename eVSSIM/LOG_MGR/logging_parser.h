@@ -305,6 +305,10 @@ typedef struct {
      * number of dirty pages in block prior to erase
      */
     uint64_t dirty_page_nb;
+    /**
+     * The number of times the block was erased, this erase included
+     */
+    unsigned int erase_count;
     /**
      * Is it a background action?
      */
@@ -447,6 +451,58 @@ typedef struct {
     LogMetadata metadata;
 } SsdUtilizationLog;
 
+/**
+ * A log of a cached mapping table (CMT) lookup
+ */
+typedef struct {
+    /**
+     * Was the translation page of the entry already cached?
+     */
+    bool hit;
+    /**
+     * Was a dirty translation page written back to make room for it?
+     */
+    bool writeback;
+    /**
+     * Log metadata
+     */
+    LogMetadata metadata;
+} MappingCacheLog;
+
+/**
+ * A log of a static wear leveling migration
+ */
+typedef struct {
+    /**
+     * The die number of the migrated block
+     */
+    unsigned int die;
+    /**
+     * The block number of the migrated block
+     */
+    unsigned int block;
+    /**
+     * The erase count of the block before the migration
+     */
+    unsigned int erase_count;
+    /**
+     * The highest erase count of the device
+     */
+    unsigned int max_erase_count;
+    /**
+     * The number of valid pages moved off the block
+     */
+    uint64_t moved_page_nb;
+    /**
+     * Is it a background action?
+     */
+    bool background;
+    /**
+     * Log metadata
+     */
+    LogMetadata metadata;
+} WearLevelingLog;
+
 /**
  * All the logs definitions; used to easily add more log types
  * Each line should contain a call to the applier, with the structure and name of the log
@@ -469,6 +525,8 @@ APPLIER(ObjectAddPageLog, OBJECT_ADD_PAGE)                  \
 APPLIER(ObjectCopyback, OBJECT_COPYBACK)                    \
 APPLIER(LoggeingServerSync, LOG_SYNC)   \
 APPLIER(SsdUtilizationLog, SSD_UTILIZATION)                 \
+APPLIER(MappingCacheLog, MAPPING_CACHE)                     \
+APPLIER(WearLevelingLog, WEAR_LEVELING)                     \
 
 /**
  * The enum log applier; used to create an enum of the log types' ids
@@ -301,6 +301,28 @@ void rt_log_analyzer_loop(uint8_t device_index, RTLogAnalyzer* analyzer, int max
                 stats.occupied_pages = log.occupied_pages;
                 break;
             }
+            case MAPPING_CACHE_LOG_UID:
+            {
+                MappingCacheLog res;
+                NEXT_MAPPING_CACHE_LOG(analyzer->logger, &res, RT_ANALYZER);
+                if (res.hit) {
+                    stats.mapping_cache_hit_count++;
+                } else {
+                    stats.mapping_cache_miss_count++;
+                }
+                if (res.writeback) {
+                    stats.mapping_cache_writeback_count++;
+                }
+                break;
+            }
+            case WEAR_LEVELING_LOG_UID:
+            {
+                WearLevelingLog res;
+                NEXT_WEAR_LEVELING_LOG(analyzer->logger, &res, RT_ANALYZER);
+                stats.wear_leveling_count++;
+                stats.wear_leveling_page_count += res.moved_page_nb;
+                break;
+            }
             default:
                 fprintf(stderr, "WARNING: unknown log type id! [%d]\n", log_type);
                 fprintf(stderr, "WARNING: rt_log_analyzer_loop may not be up to date!\n");
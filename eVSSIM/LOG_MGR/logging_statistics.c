@@ -37,6 +37,11 @@ SSDStatistics stats_init(void) {
             .background_read_count = 0,
             .background_garbage_collection_count = 0,
             .background_block_erase_count = 0,
+            .mapping_cache_hit_count = 0,
+            .mapping_cache_miss_count = 0,
+            .mapping_cache_writeback_count = 0,
+            .wear_leveling_count = 0,
+            .wear_leveling_page_count = 0,
             .log_id = 0,
     };
     return stats;
@@ -61,7 +66,12 @@ int stats_json(SSDStatistics stats, Byte* buffer, int max_len) {
                     "\"background_write_count\":%lu,"
                     "\"background_read_count\":%lu,"
                     "\"background_garbage_collection_count\":%lu,"
-                    "\"background_block_erase_count\":%lu"
+                    "\"background_block_erase_count\":%lu,"
+                    "\"mapping_cache_hit_count\":%lu,"
+                    "\"mapping_cache_miss_count\":%lu,"
+                    "\"mapping_cache_writeback_count\":%lu,"
+                    "\"wear_leveling_count\":%lu,"
+                    "\"wear_leveling_page_count\":%lu"
                     "}",
                     stats.write_count, stats.write_speed, stats.read_count,
                     stats.read_speed, stats.garbage_collection_count,
@@ -71,7 +81,12 @@ int stats_json(SSDStatistics stats, Byte* buffer, int max_len) {
                     stats.background_write_count,
                     stats.background_read_count,
                     stats.background_garbage_collection_count,
-                    stats.background_block_erase_count
+                    stats.background_block_erase_count,
+                    stats.mapping_cache_hit_count,
+                    stats.mapping_cache_miss_count,
+                    stats.mapping_cache_writeback_count,
+                    stats.wear_leveling_count,
+                    stats.wear_leveling_page_count
                 );
 }
 
@@ -95,6 +110,11 @@ int stats_equal(SSDStatistics first, SSDStatistics second) {
            first.background_read_count == second.background_read_count &&
            first.background_garbage_collection_count == second.background_garbage_collection_count &&
            first.background_block_erase_count == second.background_block_erase_count &&
+           first.mapping_cache_hit_count == second.mapping_cache_hit_count &&
+           first.mapping_cache_miss_count == second.mapping_cache_miss_count &&
+           first.mapping_cache_writeback_count == second.mapping_cache_writeback_count &&
+           first.wear_leveling_count == second.wear_leveling_count &&
+           first.wear_leveling_page_count == second.wear_leveling_page_count &&
            first.log_id == second.log_id;
 }
 
@@ -117,6 +137,11 @@ void printSSDStat(SSDStatistics *stat){
     fprintf(stdout, "\tbackground_read_count = %lu\n", stat->background_read_count);
     fprintf(stdout, "\tbackground_garbage_collection_count = %lu\n", stat->background_garbage_collection_count);
     fprintf(stdout, "\tbackground_block_erase_count = %lu\n", stat->background_block_erase_count);
+    fprintf(stdout, "\tmapping_cache_hit_count = %lu\n", stat->mapping_cache_hit_count);
+    fprintf(stdout, "\tmapping_cache_miss_count = %lu\n", stat->mapping_cache_miss_count);
+    fprintf(stdout, "\tmapping_cache_writeback_count = %lu\n", stat->mapping_cache_writeback_count);
+    fprintf(stdout, "\twear_leveling_count = %lu\n", stat->wear_leveling_count);
+    fprintf(stdout, "\twear_leveling_page_count = %lu\n", stat->wear_leveling_page_count);
 };
 
 void validateSSDStat(SSDStatistics *stat){
@@ -100,6 +100,26 @@ typedef struct {
      * The number of physical page erase actions (background)
      */
     uint64_t background_block_erase_count;
+    /**
+     * The number of mapping lookups served by the cached mapping table
+     */
+    uint64_t mapping_cache_hit_count;
+    /**
+     * The number of mapping lookups that had to read a translation page
+     */
+    uint64_t mapping_cache_miss_count;
+    /**
+     * The number of dirty translation pages written back on eviction
+     */
+    uint64_t mapping_cache_writeback_count;
+    /**
+     * The number of static wear leveling migrations
+     */
+    uint64_t wear_leveling_count;
+    /**
+     * The number of valid pages moved by static wear leveling
+     */
+    uint64_t wear_leveling_page_count;
 } SSDStatistics;
 
 
@@ -334,7 +334,7 @@ void _MONITOR_SYNC(uint8_t device_index, SSDStatistics *stats, uint64_t max_slee
 }
 
 void MONITOR_SYNC(uint8_t device_index, SSDStatistics *stats, uint64_t max_sleep) {
-    pthread_mutex_lock(&g_lock);
+    pthread_rwlock_wrlock(DEVICE_LOCK(device_index));
     _MONITOR_SYNC(device_index, stats, max_sleep);
-    pthread_mutex_unlock(&g_lock);
+    pthread_rwlock_unlock(DEVICE_LOCK(device_index));
 }
@@ -225,13 +225,15 @@ onfi_ret_val ONFI_READ(uint8_t device_index, uint64_t row_address, uint32_t colu
 
     const size_t amount_to_read = (buffer_size + column_address > GET_PAGE_SIZE(device_index)) ? (GET_PAGE_SIZE(device_index) - column_address) : buffer_size;
 
-    if (SSD_PAGE_READ(device_index, CALC_FLASH(device_index, row_address), CALC_BLOCK(device_index, row_address), CALC_PAGE(device_index, row_address), 0, READ) != FTL_SUCCESS)
+    ppn_coords_t coords;
+    DECODE_PPN(device_index, row_address, &coords);
+    if (SSD_PAGE_READ(device_index, coords.flash, coords.block, coords.page, 0, READ) != FTL_SUCCESS)
     {
         PERR("Failed reading\n")
         return ONFI_FAILURE;
     }
 
-    if (ssd_read(GET_FILE_NAME(device_index), row_address * GET_PAGE_SIZE(device_index) + column_address, amount_to_read, o_buffer) != SSD_FILE_OPS_SUCCESS)
+    if (ssd_file_read(SSD_IMAGE(device_index), row_address * GET_PAGE_SIZE(device_index) + column_address, amount_to_read, o_buffer) != SSD_FILE_OPS_SUCCESS)
     {
         PERR("Failed reading\n")
         return ONFI_FAILURE;
@@ -265,14 +267,16 @@ onfi_ret_val ONFI_PAGE_PROGRAM(uint8_t device_index, uint64_t row_address, uint3
 
     const size_t amount_to_write = (buffer_size + column_address > GET_PAGE_SIZE(device_index)) ? (GET_PAGE_SIZE(device_index) - column_address) : buffer_size;
 
-    if (SSD_PAGE_WRITE(device_index, CALC_FLASH(device_index, row_address), CALC_BLOCK(device_index, row_address), CALC_PAGE(device_index, row_address), 0, WRITE) != FTL_SUCCESS)
+    ppn_coords_t coords;
+    DECODE_PPN(device_index, row_address, &coords);
+    if (SSD_PAGE_WRITE(device_index, coords.flash, coords.block, coords.page, 0, WRITE) != FTL_SUCCESS)
     {
         PERR("Failed writing\n")
         _ONFI_UPDATE_STATUS_REGISTER(get_status_reg(device_index), ONFI_FAILURE);
         return ONFI_FAILURE;
     }
 
-    if (ssd_write(GET_FILE_NAME(device_index), row_address * GET_PAGE_SIZE(device_index) + column_address, amount_to_write, buffer) != SSD_FILE_OPS_SUCCESS)
+    if (ssd_file_write(SSD_IMAGE(device_index), row_address * GET_PAGE_SIZE(device_index) + column_address, amount_to_write, buffer) != SSD_FILE_OPS_SUCCESS)
     {
         PERR("Failed writing\n")
         _ONFI_UPDATE_STATUS_REGISTER(get_status_reg(device_index), ONFI_FAILURE);
@@ -298,8 +302,10 @@ onfi_ret_val ONFI_BLOCK_ERASE(uint8_t device_index, uint64_t row_address)
         return ONFI_FAILURE;
     }
 
-    const uint64_t block_nb = CALC_BLOCK(device_index, row_address);
-    const uint64_t flash_nb = CALC_FLASH(device_index, row_address);
+    ppn_coords_t coords;
+    DECODE_PPN(device_index, row_address, &coords);
+    const uint64_t block_nb = coords.block;
+    const uint64_t flash_nb = coords.flash;
 
     if (SSD_BLOCK_ERASE(device_index, flash_nb, block_nb, ERASE) != FTL_SUCCESS)
     {
@@ -311,7 +317,7 @@ onfi_ret_val ONFI_BLOCK_ERASE(uint8_t device_index, uint64_t row_address)
     const size_t block_size = GET_PAGE_NB(device_index) * GET_PAGE_SIZE(device_index);
     const uint64_t first_page_in_block = block_nb * GET_PAGE_NB(device_index);
 
-    if (ssd_erase(GET_FILE_NAME(device_index), first_page_in_block * GET_PAGE_SIZE(device_index), block_size) != SSD_FILE_OPS_SUCCESS)
+    if (ssd_file_erase(SSD_IMAGE(device_index), first_page_in_block * GET_PAGE_SIZE(device_index), block_size) != SSD_FILE_OPS_SUCCESS)
     {
         PERR("Failed erasing\n")
         _ONFI_UPDATE_STATUS_REGISTER(get_status_reg(device_index), ONFI_FAILURE);
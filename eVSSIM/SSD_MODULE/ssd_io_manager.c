@@ -22,7 +22,7 @@ enum SSDTimeMode SSDTimeMode;
 
 /* Emulation time state */
 static int64_t start_wall_time_us = 0; /* wall-clock anchor captured at init */
-static int64_t sim_time_us = 0;        /* simulated time offset */
+static int64_t sim_time_us = 0;        /* simulated time offset, shared by all devices and advanced atomically */
 static uint64_t log_seq_id = 0;        /* optional: used where you assign seq ids TODO: Apply this to logs*/
 
 /**
@@ -34,7 +34,7 @@ int64_t get_usec(void)
     if (SSDTimeMode == EMULATED)
     {
         // Base Timestamp + Offset + Constant Time Delay
-        return start_wall_time_us + sim_time_us + time_delay;
+        return start_wall_time_us + __atomic_load_n(&sim_time_us, __ATOMIC_RELAXED) + time_delay;
     }
     return 0;
 }
@@ -49,7 +49,7 @@ void wait_usec(int64_t usec)
 
     if (SSDTimeMode == EMULATED)
     {
-        sim_time_us += usec;
+        __atomic_add_fetch(&sim_time_us, usec, __ATOMIC_RELAXED);
     }
 }
 
@@ -80,6 +80,7 @@ int SSD_IO_INIT(uint8_t device_index){
     /* Init Variable for Channel Switch Delay */
     ssds_manager[device_index].old_channel_nb = devices[device_index].channel_nb;
     ssds_manager[device_index].last_operation_time_us = start_wall_time_us;
+    ssds_manager[device_index].qemu_overhead = 0;
 
     /* Init ssd statistic */
     ssds_manager[device_index].ssd.occupied_pages_counter = 0;
@@ -133,11 +134,33 @@ int SSD_IO_INIT(uint8_t device_index){
 
     SSDTimeMode = EMULATED;
 
+    /* The image is opened once, a missing one can still be created by SSD_IMAGE_CREATE */
+    ssd_close(&ssds_manager[device_index].image);
+    if (ssd_open(&ssds_manager[device_index].image, GET_FILE_NAME(device_index), devices[device_index].image_mmap ? SSD_FILE_MMAP : SSD_FILE_PREAD) != SSD_FILE_OPS_SUCCESS) {
+        PDBG_FTL("no image file %s\n", GET_FILE_NAME(device_index));
+    }
+
     return 0;
 }
 
+ssd_file* SSD_IMAGE(uint8_t device_index)
+{
+    return &ssds_manager[device_index].image;
+}
+
+ssd_file_ops_ret_val SSD_IMAGE_CREATE(uint8_t device_index, size_t capacity)
+{
+    // the file is truncated, it must not stay mapped meanwhile
+    ssd_close(&ssds_manager[device_index].image);
+    if (ssd_create(GET_FILE_NAME(device_index), capacity) != SSD_FILE_OPS_SUCCESS)
+        return SSD_FILE_OPS_ERROR;
+    return ssd_open(&ssds_manager[device_index].image, GET_FILE_NAME(device_index), devices[device_index].image_mmap ? SSD_FILE_MMAP : SSD_FILE_PREAD);
+}
+
 int SSD_IO_TERM(uint8_t device_index)
 {
+    ssd_close(&ssds_manager[device_index].image);
+
     free(ssds_manager[device_index].reg_io_cmd);
     free(ssds_manager[device_index].reg_io_type);
     free(ssds_manager[device_index].reg_io_time);
@@ -201,9 +224,9 @@ ftl_ret_val SSD_PAGE_WRITE(uint8_t device_index, unsigned int flash_nb, unsigned
     int64_t start = get_usec();
 
     /* Calculate ch & reg */
-    channel = flash_nb % devices[device_index].channel_nb;
+    channel = GEOMETRY_MOD(&devices[device_index].geometry.channel_nb, flash_nb);
     ssds_manager[device_index].ssd.cur_channel_mode[channel] = WRITE;
-    reg = flash_nb*devices[device_index].planes_per_flash + block_nb%devices[device_index].planes_per_flash;
+    reg = flash_nb*devices[device_index].planes_per_flash + GEOMETRY_MOD(&devices[device_index].geometry.planes_per_flash, block_nb);
 
     /* Delay Operation */
     SSD_CH_ENABLE(device_index, flash_nb, channel); // Channel enable
@@ -237,6 +260,11 @@ ftl_ret_val SSD_PAGE_WRITE(uint8_t device_index, unsigned int flash_nb, unsigned
     ssds_manager[device_index].ssd.prev_channel_mode[channel] = WRITE;
     ssds_manager[device_index].old_channel_nb = channel;
 
+    /* Translation pages only cost time, they are not accounted as user data */
+    if (type == MAPPING_WRITE) {
+        return ret;
+    }
+
     /* Update ssd page write counters */
     if (type != WRITE_COMMIT) {
         ssds_manager[device_index].ssd.occupied_pages_counter++;
@@ -275,6 +303,14 @@ ftl_ret_val SSD_PAGE_WRITE(uint8_t device_index, unsigned int flash_nb, unsigned
 }
 
 ftl_ret_val SSD_PAGE_READ(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, unsigned int page_nb, int offset, int type)
+{
+    pthread_mutex_lock(&ssds_manager[device_index].timing_lock);
+    ftl_ret_val ret = _SSD_PAGE_READ(device_index, flash_nb, block_nb, page_nb, offset, type);
+    pthread_mutex_unlock(&ssds_manager[device_index].timing_lock);
+    return ret;
+}
+
+ftl_ret_val _SSD_PAGE_READ(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, unsigned int page_nb, int offset, int type)
 {
     unsigned int channel, reg;
     int delay_ret = 0;
@@ -282,9 +318,9 @@ ftl_ret_val SSD_PAGE_READ(uint8_t device_index, unsigned int flash_nb, unsigned
     int64_t start = get_usec();
 
     /* Calculate ch & reg */
-    channel = flash_nb % devices[device_index].channel_nb;
+    channel = GEOMETRY_MOD(&devices[device_index].geometry.channel_nb, flash_nb);
     ssds_manager[device_index].ssd.cur_channel_mode[channel] = READ;
-    reg = flash_nb*devices[device_index].planes_per_flash + block_nb%devices[device_index].planes_per_flash;
+    reg = flash_nb*devices[device_index].planes_per_flash + GEOMETRY_MOD(&devices[device_index].geometry.planes_per_flash, block_nb);
 
     /* Delay Operation */
     SSD_CH_ENABLE(device_index, flash_nb, channel);    // channel enable
@@ -330,9 +366,9 @@ ftl_ret_val SSD_BLOCK_ERASE(uint8_t device_index, unsigned int flash_nb, unsigne
     int64_t start = get_usec();
 
     /* Calculate ch & reg */
-    channel = flash_nb % devices[device_index].channel_nb;
+    channel = GEOMETRY_MOD(&devices[device_index].geometry.channel_nb, flash_nb);
     ssds_manager[device_index].ssd.cur_channel_mode[channel] = ERASE;
-    reg = flash_nb*devices[device_index].planes_per_flash + block_nb%devices[device_index].planes_per_flash;
+    reg = flash_nb*devices[device_index].planes_per_flash + GEOMETRY_MOD(&devices[device_index].geometry.planes_per_flash, block_nb);
 
     /* Delay Operation */
     if( devices[device_index].io_parallelism == 0 ){
@@ -353,9 +389,11 @@ ftl_ret_val SSD_BLOCK_ERASE(uint8_t device_index, unsigned int flash_nb, unsigne
     ssds_manager[device_index].ssd.occupied_pages_counter -= block_entry->dirty_page_nb;
     SSD_UTIL_LOG(device_index, flash_nb);
     ssds_manager[device_index].ssd.prev_channel_mode[channel] = ERASE;
+    block_entry->erase_count++;
 
     LOG_BLOCK_ERASE(GET_LOGGER(device_index, flash_nb), (BlockEraseLog) {
         .channel = channel, .die = flash_nb, .block = block_nb, .dirty_page_nb = block_entry->dirty_page_nb,
+        .erase_count = block_entry->erase_count,
         .metadata = LOG_META(device_index, start, end),
         .background = (type == ERASE_BACKGROUND),
     });
@@ -369,11 +407,12 @@ int SSD_FLASH_ACCESS(uint8_t device_index, unsigned int flash_nb, unsigned int c
 {
     uint32_t i;
     uint32_t r_num = flash_nb * devices[device_index].planes_per_flash;
+    uint32_t request_nb = CURRENT_IO_REQUEST_NB();
     int ret = 0;
 
     for (i=0;i<devices[device_index].planes_per_flash;i++) {
 
-        if (r_num != reg && ssds_manager[device_index].access_nb[r_num][0] == io_request_seq_nb) {
+        if (r_num != reg && request_nb != UINT32_MAX && ssds_manager[device_index].access_nb[r_num][0] == request_nb) {
             /* That's OK */
         }
         else{
@@ -434,9 +473,9 @@ ftl_ret_val SSD_REG_RECORD(uint8_t device_index, int reg, int type, int offset,
 
             /* Update SATA request Info */
             if(type == WRITE) {
-                ssds_manager[device_index].access_nb[reg][0] = io_request_seq_nb;
+                ssds_manager[device_index].access_nb[reg][0] = CURRENT_IO_REQUEST_NB();
                 ssds_manager[device_index].access_nb[reg][1] = offset;
-                ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, io_request_seq_nb, offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
+                ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, CURRENT_IO_REQUEST_NB(), offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
                 SSD_UPDATE_IO_OVERHEAD(device_index, reg, ssds_manager[device_index].io_update_overhead);
             }
             else{
@@ -451,9 +490,9 @@ ftl_ret_val SSD_REG_RECORD(uint8_t device_index, int reg, int type, int offset,
             }
             /* Update SATA request Info */
             if(type == READ){
-                ssds_manager[device_index].access_nb[reg][0] = io_request_seq_nb;
+                ssds_manager[device_index].access_nb[reg][0] = CURRENT_IO_REQUEST_NB();
                 ssds_manager[device_index].access_nb[reg][1] = offset;
-                ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, io_request_seq_nb, offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
+                ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, CURRENT_IO_REQUEST_NB(), offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
                 SSD_UPDATE_IO_OVERHEAD(device_index, reg, ssds_manager[device_index].io_update_overhead);
             }
             else{
@@ -468,9 +507,9 @@ ftl_ret_val SSD_REG_RECORD(uint8_t device_index, int reg, int type, int offset,
         break;
     case COPYBACK:
         ssds_manager[device_index].reg_io_time[reg] = ssds_manager[device_index].cell_io_time[reg] + devices[device_index].cell_read_delay;
-        ssds_manager[device_index].access_nb[reg][0] = io_request_seq_nb;
+        ssds_manager[device_index].access_nb[reg][0] = CURRENT_IO_REQUEST_NB();
         ssds_manager[device_index].access_nb[reg][1] = offset;
-        ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, io_request_seq_nb, offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
+        ssds_manager[device_index].io_update_overhead = UPDATE_IO_REQUEST(device_index, CURRENT_IO_REQUEST_NB(), offset, ssds_manager[device_index].last_operation_time_us, UPDATE_START_TIME);
         SSD_UPDATE_IO_OVERHEAD(device_index, reg, ssds_manager[device_index].io_update_overhead);
         break;
     default:
@@ -843,20 +882,18 @@ void SSD_REMAIN_IO_DELAY(uint8_t device_index, unsigned int flash_nb, int channe
 }
 
 //MIX
-int64_t qemu_overhead;
-
 void SSD_UPDATE_QEMU_OVERHEAD(uint8_t device_index, int64_t delay)
 {
     int i;
     int p_num = devices[device_index].flash_nb * devices[device_index].planes_per_flash;
     int64_t diff = delay;
 
-    if(qemu_overhead == 0){
+    if(ssds_manager[device_index].qemu_overhead == 0){
         return;
     }
     else{
-        if(diff > qemu_overhead){
-            diff = qemu_overhead;
+        if(diff > ssds_manager[device_index].qemu_overhead){
+            diff = ssds_manager[device_index].qemu_overhead;
         }
     }
 
@@ -865,7 +902,7 @@ void SSD_UPDATE_QEMU_OVERHEAD(uint8_t device_index, int64_t delay)
         ssds_manager[device_index].cell_io_time[i] -= diff;
         ssds_manager[device_index].reg_io_time[i] -= diff;
     }
-    qemu_overhead -= diff;
+    ssds_manager[device_index].qemu_overhead -= diff;
 }
 
 ftl_ret_val SSD_PAGE_COPYBACK(uint8_t device_index, uint32_t source, uint32_t destination, int type)
@@ -876,19 +913,24 @@ ftl_ret_val SSD_PAGE_COPYBACK(uint8_t device_index, uint32_t source, uint32_t de
     uint32_t reg , channel;
     int delay_ret = 0;
 
+    ppn_coords_t source_coords, dest_coords;
+    DECODE_PPN(device_index, source, &source_coords);
+    DECODE_PPN(device_index, destination, &dest_coords);
+
     //Check source and destination pages are at the same plane.
-    block_nb = CALC_BLOCK(device_index, source);
-    source_plane = CALC_FLASH(device_index, source)*devices[device_index].planes_per_flash + block_nb%devices[device_index].planes_per_flash;
-    destination_plane = CALC_FLASH(device_index, destination) * devices[device_index].planes_per_flash + block_nb%devices[device_index].planes_per_flash;
+    block_nb = source_coords.block;
+    source_plane = source_coords.reg;
+    destination_plane = dest_coords.reg;
     if (source_plane != destination_plane){
-        //copyback from different planes is not supported
-        return FTL_FAILURE;
+        // another plane of the same flash is reached through the controller buffer, if allowed
+        uint64_t multi_source = source, multi_destination = destination;
+        return SSD_MULTI_PLANE_COPYBACK(device_index, &multi_source, &multi_destination, 1, type);
     }else{
         reg = destination_plane;
-        flash_nb = CALC_FLASH(device_index, source);
+        flash_nb = source_coords.flash;
     }
 
-    channel = flash_nb % devices[device_index].channel_nb;
+    channel = source_coords.channel;
     ssds_manager[device_index].ssd.cur_channel_mode[channel] = COPYBACK;
 
     int64_t start = get_usec();
@@ -912,8 +954,8 @@ ftl_ret_val SSD_PAGE_COPYBACK(uint8_t device_index, uint32_t source, uint32_t de
     SSD_UTIL_LOG(device_index, flash_nb);
     ssds_manager[device_index].ssd.physical_page_writes++;
 
-    dest_block_nb = CALC_BLOCK(device_index, destination);
-    dest_flash_nb = CALC_FLASH(device_index, destination);
+    dest_block_nb = dest_coords.block;
+    dest_flash_nb = dest_coords.flash;
     inverse_block_mapping_entry* block_entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, dest_flash_nb, dest_block_nb);
     block_entry->dirty_page_nb++;
 
@@ -931,6 +973,119 @@ ftl_ret_val SSD_PAGE_COPYBACK(uint8_t device_index, uint32_t source, uint32_t de
     return FTL_SUCCESS;
 }
 
+ftl_ret_val SSD_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type)
+{
+    const uint32_t planes_per_flash = devices[device_index].planes_per_flash;
+    ppn_coords_t source_coords, dest_coords;
+    unsigned int flash_nb, channel;
+    unsigned int i;
+
+    if (page_nb == 0 || page_nb > planes_per_flash)
+        return FTL_FAILURE;
+
+    /* Reads queued on every plane, and whether a plane is programmed by the command */
+    unsigned int plane_read_nb[planes_per_flash];
+    bool plane_programmed[planes_per_flash];
+    unsigned int cross_plane_nb = 0;
+    memset(plane_read_nb, 0, sizeof(plane_read_nb));
+    memset(plane_programmed, 0, sizeof(plane_programmed));
+
+    DECODE_PPN(device_index, sources[0], &source_coords);
+    flash_nb = source_coords.flash;
+    channel = source_coords.channel;
+
+    for (i = 0; i < page_nb; i++) {
+        DECODE_PPN(device_index, sources[i], &source_coords);
+        DECODE_PPN(device_index, destinations[i], &dest_coords);
+
+        // copyback never leaves the flash, and a plane takes a single page of the command
+        if (source_coords.flash != flash_nb || dest_coords.flash != flash_nb || plane_programmed[dest_coords.plane])
+            return FTL_FAILURE;
+        if (source_coords.plane != dest_coords.plane) {
+            if (!devices[device_index].copyback_cross_plane)
+                return FTL_FAILURE;
+            cross_plane_nb++;
+        }
+
+        plane_read_nb[source_coords.plane]++;
+        plane_programmed[dest_coords.plane] = true;
+    }
+
+    ssds_manager[device_index].ssd.cur_channel_mode[channel] = COPYBACK;
+
+    int64_t start = get_usec();
+
+    /* Access Registers */
+    int delay_ret = 0;
+    unsigned int first_reg = flash_nb * planes_per_flash;
+    if (devices[device_index].io_parallelism == 0) {
+        delay_ret = SSD_FLASH_ACCESS(device_index, flash_nb, channel, first_reg);
+    }
+    else {
+        for (i = 0; i < planes_per_flash; i++) {
+            if (plane_read_nb[i] || plane_programmed[i])
+                delay_ret |= SSD_REG_ACCESS(device_index, flash_nb, channel, first_reg + i);
+        }
+    }
+
+    SSD_CH_RECORD(device_index, channel, 0, delay_ret);
+
+    /*
+     * The pages of a plane are read one after the other, the planes in parallel. A page bound to another
+     * plane goes out to the controller buffer and back over the channel, and then all the planes are
+     * programmed together. The registers stay busy until the end of the command.
+     */
+    unsigned int max_read_nb = 0;
+    for (i = 0; i < planes_per_flash; i++) {
+        if (plane_read_nb[i] > max_read_nb)
+            max_read_nb = plane_read_nb[i];
+    }
+    int64_t now = get_usec();
+    int64_t transfer_end = now + (int64_t)max_read_nb * devices[device_index].cell_read_delay
+        + (int64_t)cross_plane_nb * (devices[device_index].reg_read_delay + devices[device_index].reg_write_delay);
+    int64_t program_end = transfer_end + devices[device_index].cell_program_delay;
+
+    for (i = 0; i < planes_per_flash; i++) {
+        int64_t busy_until;
+        if (plane_programmed[i])
+            busy_until = program_end;
+        else if (plane_read_nb[i])
+            busy_until = now + (int64_t)plane_read_nb[i] * devices[device_index].cell_read_delay;
+        else
+            continue;
+
+        unsigned int reg = first_reg + i;
+        ssds_manager[device_index].reg_io_cmd[reg] = COPYBACK;
+        ssds_manager[device_index].reg_io_type[reg] = type;
+        ssds_manager[device_index].reg_io_time[reg] = busy_until;
+        ssds_manager[device_index].cell_io_time[reg] = busy_until - devices[device_index].cell_read_delay;
+        ssds_manager[device_index].access_nb[reg][0] = UINT32_MAX;
+        ssds_manager[device_index].access_nb[reg][1] = UINT32_MAX;
+    }
+
+    ssds_manager[device_index].ssd.prev_channel_mode[channel] = COPYBACK;
+
+    int64_t end = get_usec();
+
+    for (i = 0; i < page_nb; i++) {
+        DECODE_PPN(device_index, sources[i], &source_coords);
+        DECODE_PPN(device_index, destinations[i], &dest_coords);
+
+        ssds_manager[device_index].ssd.occupied_pages_counter++;
+        SSD_UTIL_LOG(device_index, flash_nb);
+        ssds_manager[device_index].ssd.physical_page_writes++;
+        GET_INVERSE_BLOCK_MAPPING_ENTRY(device_index, dest_coords.flash, dest_coords.block)->dirty_page_nb++;
+
+        LOG_PAGE_COPYBACK(GET_LOGGER(device_index, flash_nb), (PageCopyBackLog) {
+            .channel = channel, .block = source_coords.block, .source_page = sources[i], .destination_page = destinations[i],
+            .metadata = LOG_META(device_index, start, end),
+            .background = (type == COPYBACK_BACKGROUND),
+        });
+    }
+
+    return FTL_SUCCESS;
+}
+
 double SSD_UTIL(uint8_t device_index) {
     const uint64_t total_pages    = (uint64_t)devices[device_index].pages_in_ssd;
     const uint64_t occupied_pages = (uint64_t)ssds_manager[device_index].ssd.occupied_pages_counter;
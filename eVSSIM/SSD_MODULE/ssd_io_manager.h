@@ -9,6 +9,7 @@
 //#include "ssd_util.h"
 #include "ftl.h"
 #include "logging_statistics.h"
+#include "ssd_file_operations.h"
 
 extern enum SSDTimeMode{
     REAL, // We have removed the use of REAL SSDTimeMode from io_manager
@@ -56,6 +57,14 @@ typedef struct ssd_manager {
     int64_t io_update_overhead;
 
     int64_t init_diff_reg;
+    int64_t qemu_overhead;
+
+    /* Serializes the timing model and the flash loggers between sector reads, which only share
+     * the device lock. The channel and last operation state is device wide, so is this lock. */
+    pthread_mutex_t timing_lock;
+
+    /* The image file of the device, open from SSD_IO_INIT to SSD_IO_TERM when it exists */
+    ssd_file image;
 
     ssd_disk ssd;
 } ssd_manager_t;
@@ -77,11 +86,21 @@ void wait_until(int64_t target_us);
 int SSD_IO_INIT(uint8_t device_index);
 int SSD_IO_TERM(uint8_t device_index);
 
+/* The open image file of the device, where the page data is kept. Operations on it fail when the
+ * device has no image file. */
+ssd_file* SSD_IMAGE(uint8_t device_index);
+/* Creates the image file of the device, all erased, and opens it */
+ssd_file_ops_ret_val SSD_IMAGE_CREATE(uint8_t device_index, size_t capacity);
+
 /* GET IO from FTL */
 ftl_ret_val SSD_PAGE_READ(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, unsigned int page_nb, int offset, int type);
+/* SSD_PAGE_READ for callers already holding the timing lock */
+ftl_ret_val _SSD_PAGE_READ(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, unsigned int page_nb, int offset, int type);
 ftl_ret_val SSD_PAGE_WRITE(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, unsigned int page_nb, int offset, int type);
 ftl_ret_val SSD_BLOCK_ERASE(uint8_t device_index, unsigned int flash_nb, unsigned int block_nb, int type);
 ftl_ret_val SSD_PAGE_COPYBACK(uint8_t device_index, uint32_t source, uint32_t destination, int type);
+/* Copyback of up to one page per plane of a flash by a single multi-plane command */
+ftl_ret_val SSD_MULTI_PLANE_COPYBACK(uint8_t device_index, const uint64_t* sources, const uint64_t* destinations, unsigned int page_nb, int type);
 
 /* Channel Access Delay */
 int SSD_CH_ENABLE(uint8_t device_index, unsigned int flash_nb, unsigned int channel);
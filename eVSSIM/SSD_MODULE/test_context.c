@@ -5,13 +5,6 @@
 #include "common.h"
 #include "test_context.h"
 
-/* Portable thread-local keyword */
-#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
-  #define TLS _Thread_local
-#else
-  #define TLS __thread
-#endif
-
 typedef struct ssd_tls_ctx {
     char*    test_name;
     char*    test_case_name;
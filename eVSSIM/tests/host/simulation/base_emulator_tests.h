@@ -114,6 +114,7 @@ namespace {
         size_t flash_nb;
         size_t block_nb;
         size_t channel_nb;
+        size_t planes_per_flash;
         size_t logger_size;
         size_t object_size;
         size_t pages;
@@ -144,6 +145,7 @@ namespace {
             this->page_nb = CONST_PAGES_PER_BLOCK + CONST_PAGES_PER_BLOCK_OVERPROV;
             this->flash_nb = DEFAULT_FLASH_NB;
             this->channel_nb = DEFAULT_FLASH_NB;
+            this->planes_per_flash = 1;
             this->sector_size = sector_size;
             this->object_size = 2048; // megabytes
             this->storage_strategy = STRATEGY_SECTOR;
@@ -152,7 +154,7 @@ namespace {
         SSDConf(size_t page_size, size_t page_nb, size_t sector_size,
                 size_t flash_nb, size_t block_nb, size_t channel_nb)
                 : page_size(page_size), page_nb(page_nb), sector_size(sector_size),
-                  flash_nb(flash_nb), block_nb(block_nb), channel_nb(channel_nb) {
+                  flash_nb(flash_nb), block_nb(block_nb), channel_nb(channel_nb), planes_per_flash(1) {
                     this->pages = page_nb * block_nb * flash_nb;
                     this->storage_strategy = STRATEGY_SECTOR;
                 }
@@ -181,6 +183,10 @@ namespace {
             return this->channel_nb;
         }
 
+        size_t get_planes_per_flash(void) {
+            return this->planes_per_flash;
+        }
+
         size_t get_logger_size(void) {
             return this->logger_size;
         }
@@ -201,6 +207,10 @@ namespace {
             this->logger_size = val;
         }
 
+        void set_planes_per_flash(size_t val) {
+            this->planes_per_flash = val;
+        }
+
         void set_object_size(size_t val) {
             this->object_size = val;
         }
@@ -222,7 +232,7 @@ namespace {
                 "SECTOR_SIZE " << get_sector_size() << "\n"
                 "FLASH_NB " << get_flash_nb() << "\n"
                 "BLOCK_NB " << get_block_nb() << "\n"
-                "PLANES_PER_FLASH 1\n"
+                "PLANES_PER_FLASH " << get_planes_per_flash() << "\n"
                 "NS1 " << (get_block_nb() / 2) << "\n"
                 "NS2 " << (get_block_nb() / 4) << "\n"
                 "REG_WRITE_DELAY 82\n"
@@ -246,7 +256,7 @@ namespace {
                 "SECTOR_SIZE " << get_sector_size() << "\n"
                 "FLASH_NB " << get_flash_nb() << "\n"
                 "BLOCK_NB " << get_block_nb() << "\n"
-                "PLANES_PER_FLASH 1\n"
+                "PLANES_PER_FLASH " << get_planes_per_flash() << "\n"
                 "NS1 " << (get_block_nb() / 2) << "\n"
                 "NS2 " << (get_block_nb() / 4) << "\n"
                 "REG_WRITE_DELAY 82\n"
@@ -270,7 +280,7 @@ namespace {
                 "SECTOR_SIZE " << get_sector_size() << "\n"
                 "FLASH_NB " << get_flash_nb() << "\n"
                 "BLOCK_NB " << get_block_nb() << "\n"
-                "PLANES_PER_FLASH 1\n"
+                "PLANES_PER_FLASH " << get_planes_per_flash() << "\n"
                 "NS1 " << (get_block_nb() / 2) << "\n"
                 "NS2 " << (get_block_nb() / 4) << "\n"
                 "REG_WRITE_DELAY 82\n"
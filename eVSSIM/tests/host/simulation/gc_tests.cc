@@ -24,20 +24,20 @@ namespace ssd_io_emulator_tests {
                 BaseTest::SetUp();
                 INIT_LOG_MANAGER(g_device_index);
 
-                pthread_mutex_lock(&g_lock); // prevent the GC thread from running
+                pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index)); // prevent the GC thread from running
                 devices[g_device_index].gc_low_thr_interval_sec = 0;
                 devices[g_device_index].gc_hi_thr_interval_sec = 0;
 
-                // Since there's a short duration in which g_lock is unlocked, the GC thread may
+                // Since there's a short duration in which the device lock is unlocked, the GC thread may
                 // have done a loop already. We reset it to run ASAP.
                 if (gc_threads[g_device_index].gc_loop_count > 0) {
-                    pthread_cond_signal(&gc_threads[g_device_index].gc_signal_cond);
+                    WAKE_GC_THREAD(g_device_index);
                     gc_threads[g_device_index].gc_loop_count = 0;
                 }
             }
 
             virtual void TearDown() {
-                pthread_mutex_unlock(&g_lock);
+                pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
                 BaseTest::TearDown(false);
                 TERM_LOG_MANAGER(g_device_index);
                 TERM_SSD_CONFIG();
@@ -57,9 +57,9 @@ namespace ssd_io_emulator_tests {
     static bool WaitForGC() {
         uint64_t before = gc_threads[g_device_index].gc_loop_count;
         for (int i = 0; i < 100; i++) {
-            pthread_mutex_unlock(&g_lock);
+            pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
             usleep(1000);
-            pthread_mutex_lock(&g_lock);
+            pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
             if (gc_threads[g_device_index].gc_loop_count > before) {
                 return true;
             }
@@ -160,6 +160,43 @@ namespace ssd_io_emulator_tests {
         ASSERT_LT(config->page_nb, inverse_mappings_manager[g_device_index].total_zero_page_nb);
     }
 
+    TEST_P(GCTest, CaseVictimIndexTracksMinimum) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < 2 * config->pages_in_ssd; i++) {
+            uint64_t sector_nb = rand_r(&seed) % max_sector_nb;
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, sector_nb, 1, NULL));
+
+            if (i % config->page_nb != 0) {
+                continue;
+            }
+
+            // compare the index against a scan of all the full blocks
+            uint64_t min_valid_nb = UINT64_MAX;
+            uint64_t victim_nb = 0;
+            for (uint64_t block = 0; block < config->block_mapping_entry_nb; block++) {
+                inverse_block_mapping_entry *entry = manager->inverse_block_mapping_table_start + block;
+                if (entry->victim != NULL) {
+                    ASSERT_EQ(entry->valid_page_nb, entry->victim->bucket);
+                    min_valid_nb = std::min(min_valid_nb, entry->valid_page_nb);
+                    victim_nb++;
+                }
+            }
+            ASSERT_EQ(victim_nb, manager->total_victim_block_nb);
+            ASSERT_EQ(victim_nb, manager->victim_block_index.victim_block_nb);
+
+            victim_block_entry *victim = GET_MIN_VICTIM_BLOCK(g_device_index, &manager->victim_block_index);
+            if (victim_nb == 0) {
+                ASSERT_EQ(NULL, victim);
+            } else {
+                ASSERT_EQ(min_valid_nb, *victim->valid_page_nb);
+            }
+        }
+    }
+
     TEST_P(GCTest, CaseDiskFullWrite) {
         ssd_config_t *config = &devices[g_device_index];
 
@@ -190,21 +227,405 @@ namespace ssd_io_emulator_tests {
         for (size_t i = 0; i < sizeof(sectors) / sizeof(sectors[0]); i++) {
             uint64_t lba = sectors[i];
             ASSERT_EQ(config->page_nb, inverse_mappings_manager[g_device_index].total_zero_page_nb);
-            pthread_mutex_unlock(&g_lock);
+            pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
             ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lba, 1, NULL));
-            pthread_mutex_lock(&g_lock);
+            pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
             ASSERT_EQ(config->page_nb, inverse_mappings_manager[g_device_index].total_zero_page_nb);
         }
     }
 
+    // Restart the FTL of the test device without the state it saved on shutdown
+    static void RestartEmptyFTL() {
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+        FTL_TERM(g_device_index);
+        std::ignore = system((std::string("rm -f data/") + std::to_string(g_device_index) + "/*").c_str());
+        FTL_INIT(g_device_index);
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+    }
+
+    // Runs a random write workload and returns the most pages foreground GC copied during one write
+    static uint64_t MaxCopiesPerWrite(uint64_t write_nb) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+        uint64_t max_copy_nb = 0;
+
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < write_nb; i++) {
+            uint64_t sector_nb = rand_r(&seed) % max_sector_nb;
+            int64_t free_before = inverse_mappings_manager[g_device_index].total_zero_page_nb;
+            int64_t written_before = wa_counters[g_device_index].physical_block_write_counter;
+            EXPECT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, sector_nb, 1, NULL));
+            int64_t freed = inverse_mappings_manager[g_device_index].total_zero_page_nb - free_before;
+            int64_t written = wa_counters[g_device_index].physical_block_write_counter - written_before;
+
+            // the host page and every copy use up a free page, an erase gives back a block.
+            // copies and erases both count as physical writes.
+            int64_t erase_nb = (freed + written) / (config->page_nb + 1);
+            max_copy_nb = std::max(max_copy_nb, (uint64_t)(written - 1 - erase_nb));
+        }
+        return max_copy_nb;
+    }
+
+    TEST_P(GCTest, CaseIncrementalGCBoundsCopies) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t write_nb = 4 * config->pages_in_ssd;
+
+        // whole blocks are collected when the device gets full
+        config->gc_incremental_page_nb = 0;
+        ASSERT_LT(4u, MaxCopiesPerWrite(write_nb));
+        ASSERT_FALSE(gc_threads[g_device_index].victim_in_progress);
+
+        RestartEmptyFTL();
+
+        config->gc_incremental_page_nb = 4;
+        ASSERT_GE(4u, MaxCopiesPerWrite(write_nb));
+
+        // a snapshot must not lose the partly collected victim
+        uint64_t victim_nb = inverse_mappings_manager[g_device_index].total_victim_block_nb;
+        if (gc_threads[g_device_index].victim_in_progress) {
+            RELEASE_GC_VICTIM(g_device_index);
+            ASSERT_EQ(victim_nb + 1, inverse_mappings_manager[g_device_index].total_victim_block_nb);
+        }
+        ASSERT_FALSE(gc_threads[g_device_index].victim_in_progress);
+        config->gc_incremental_page_nb = 0;
+    }
+
+    // Leaves two half valid blocks on every flash, then returns the emulated time it takes to reclaim
+    // flash_nb of them
+    static int64_t TimeGCOfHalfValidBlocks(int parallel_victim_nb) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t lpn_nb = 2 * config->flash_nb * config->page_nb;
+
+        RestartEmptyFTL();
+        config->gc_parallel_victim_nb = parallel_victim_nb;
+
+        // consecutive pages go to consecutive flashes, so rewriting every other run of flash_nb
+        // pages invalidates half of each block
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            EXPECT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            if ((lpn / config->flash_nb) % 2 == 0) {
+                EXPECT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+            }
+        }
+
+        uint64_t victim_nb = inverse_mappings_manager[g_device_index].total_victim_block_nb;
+        uint64_t free_page_nb = inverse_mappings_manager[g_device_index].total_zero_page_nb;
+        int64_t start = get_usec();
+        for (uint32_t collected = 0; collected < config->flash_nb; collected += parallel_victim_nb) {
+            EXPECT_EQ(FTL_SUCCESS, GARBAGE_COLLECTION(g_device_index, 1, true));
+        }
+        int64_t end = get_usec();
+
+        // half of every reclaimed block was copied elsewhere
+        EXPECT_EQ(victim_nb - config->flash_nb, inverse_mappings_manager[g_device_index].total_victim_block_nb);
+        EXPECT_EQ(free_page_nb + config->flash_nb * config->page_nb / 2, inverse_mappings_manager[g_device_index].total_zero_page_nb);
+
+        config->gc_parallel_victim_nb = 1;
+        return end - start;
+    }
+
+    TEST_P(GCTest, CaseParallelGCOverlapsFlashes) {
+        ssd_config_t *config = &devices[g_device_index];
+        ASSERT_LE(4u, config->flash_nb);
+
+        int64_t serial_us = TimeGCOfHalfValidBlocks(1);
+        int64_t parallel_us = TimeGCOfHalfValidBlocks(config->flash_nb);
+        printf("serial GC: %" PRId64 "us, parallel GC: %" PRId64 "us\n", serial_us, parallel_us);
+
+        ASSERT_LT(0, parallel_us);
+        ASSERT_LT(parallel_us * 2, serial_us);
+    }
+
+    // Selects a victim with the given policy and files it back, so the index is left as it was
+    static victim_block_entry* PeekVictim(int policy) {
+        ssd_config_t *config = &devices[g_device_index];
+        unsigned int phy_flash_nb;
+        uint64_t phy_block_nb;
+
+        config->gc_victim_policy = policy;
+        EXPECT_EQ(FTL_SUCCESS, SELECT_VICTIM_BLOCK(g_device_index, &phy_flash_nb, &phy_block_nb));
+        config->gc_victim_policy = GC_VICTIM_GREEDY;
+
+        empty_block_entry block = { phy_flash_nb, (unsigned int)phy_block_nb, config->page_nb };
+        EXPECT_EQ(FTL_SUCCESS, INSERT_VICTIM_BLOCK(g_device_index, &block));
+        return GET_INVERSE_BLOCK_MAPPING_ENTRY(g_device_index, phy_flash_nb, phy_block_nb)->victim;
+    }
+
+    TEST_P(GCTest, CaseVictimPolicies) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        const uint64_t lpn_nb = 2 * config->flash_nb * config->page_nb;
+
+        RestartEmptyFTL();
+        unsigned int seed = 0;
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+        for (uint64_t i = 0; i < lpn_nb / 4; i++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, (rand_r(&seed) % lpn_nb) * config->sectors_per_page, 1, NULL));
+        }
+
+        victim_block_entry *least_valid = NULL, *oldest = NULL, *aged = NULL;
+        for (uint64_t i = 0; i < config->block_mapping_entry_nb; i++) {
+            victim_block_entry *victim = manager->inverse_block_mapping_table_start[i].victim;
+            if (victim == NULL) {
+                continue;
+            }
+            if (least_valid == NULL || *victim->valid_page_nb < *least_valid->valid_page_nb) {
+                least_valid = victim;
+            }
+            if (*victim->valid_page_nb < config->page_nb && (oldest == NULL || victim->seq < oldest->seq)) {
+                oldest = victim;
+            }
+        }
+        ASSERT_NE(nullptr, least_valid);
+        ASSERT_NE(nullptr, oldest);
+
+        // a window of one only sees the block with invalid pages that filled up first
+        config->gc_victim_candidate_nb = 1;
+        uint64_t oldest_block_nb = oldest->phy_block_nb;
+        unsigned int oldest_flash_nb = oldest->phy_flash_nb;
+        victim_block_entry *windowed = PeekVictim(GC_VICTIM_WINDOWED);
+        ASSERT_EQ(oldest_flash_nb, windowed->phy_flash_nb);
+        ASSERT_EQ(oldest_block_nb, windowed->phy_block_nb);
+        config->gc_victim_candidate_nb = 8;
+
+        // greedy, and d-choices drawing about every block, take the block with the fewest valid pages
+        ASSERT_EQ(*least_valid->valid_page_nb, *PeekVictim(GC_VICTIM_GREEDY)->valid_page_nb);
+        config->gc_victim_candidate_nb = config->block_mapping_entry_nb;
+        ASSERT_EQ(*least_valid->valid_page_nb, *PeekVictim(GC_VICTIM_D_CHOICES)->valid_page_nb);
+        config->gc_victim_candidate_nb = 8;
+
+        // cost-benefit prefers a block left alone for long over one just invalidated
+        int64_t now = get_usec();
+        for (uint64_t i = 0; i < config->block_mapping_entry_nb; i++) {
+            inverse_block_mapping_entry *entry = manager->inverse_block_mapping_table_start + i;
+            entry->last_invalidation_time = now;
+            if (entry->victim != NULL && entry->victim != least_valid && *entry->victim->valid_page_nb < config->page_nb) {
+                aged = entry->victim;
+            }
+        }
+        ASSERT_NE(nullptr, aged);
+        GET_INVERSE_BLOCK_MAPPING_ENTRY(g_device_index, aged->phy_flash_nb, aged->phy_block_nb)->last_invalidation_time = now - 1000000;
+        ASSERT_EQ(aged, PeekVictim(GC_VICTIM_COST_BENEFIT));
+
+        // every policy keeps up with a skewed workload
+        for (int policy = GC_VICTIM_GREEDY; policy < GC_VICTIM_POLICY_NB; policy++) {
+            RestartEmptyFTL();
+            config->gc_victim_policy = policy;
+            const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+            unsigned long physical_before = wa_counters[g_device_index].physical_block_write_counter;
+            unsigned long logical_before = wa_counters[g_device_index].logical_block_write_counter;
+            for (uint64_t i = 0; i < 4 * config->pages_in_ssd; i++) {
+                // 80% of the writes go to 20% of the sectors
+                uint64_t sector_nb = rand_r(&seed) % max_sector_nb;
+                if (rand_r(&seed) % 10 < 8) {
+                    sector_nb /= 5;
+                }
+                ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, sector_nb, 1, NULL));
+            }
+            printf("victim policy %d: write amplification %.2f\n", policy,
+                   (double)(wa_counters[g_device_index].physical_block_write_counter - physical_before) /
+                   (wa_counters[g_device_index].logical_block_write_counter - logical_before));
+        }
+        config->gc_victim_policy = GC_VICTIM_GREEDY;
+    }
+
+    TEST_P(GCTest, CaseWearLeveling) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+
+        // dynamic: once the write block of a plane fills up, the least erased free block follows it
+        RestartEmptyFTL();
+        inverse_block_mapping_entry *entries = manager->inverse_block_mapping_table_start;
+        config->wear_leveling_dynamic = 1;
+        empty_block_root *root = manager->empty_block_table_start;
+        ASSERT_LE(3u, root->empty_block_nb);
+        for (uint64_t i = 1; i < root->empty_block_nb; i++) {
+            entries[root->ring[(root->head + i) % root->capacity]].erase_count = 10;
+        }
+        uint64_t least_worn = root->ring[(root->head + root->empty_block_nb - 1) % root->capacity];
+        entries[least_worn].erase_count = 1;
+        uint64_t new_ppn;
+        for (uint64_t i = 0; i < config->page_nb; i++) {
+            ASSERT_EQ(FTL_SUCCESS, GET_NEW_PAGE(g_device_index, VICTIM_INCHIP, 0, &new_ppn));
+        }
+        ASSERT_EQ(least_worn, root->ring[root->head]);
+        config->wear_leveling_dynamic = 0;
+
+        // static: a block of cold data is moved once the other blocks wore out ahead of it
+        RestartEmptyFTL();
+        entries = manager->inverse_block_mapping_table_start;
+        const uint64_t lpn_nb = config->empty_table_entry_nb * config->page_nb;
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+        inverse_block_mapping_entry *cold = NULL;
+        for (uint64_t i = 0; i < config->block_mapping_entry_nb; i++) {
+            if (entries[i].victim == NULL) {
+                entries[i].erase_count = 10;
+            } else if (cold == NULL) {
+                cold = entries + i;
+            }
+        }
+        ASSERT_NE(nullptr, cold);
+        ASSERT_EQ(config->page_nb, cold->valid_page_nb);
+
+        // off, or within the threshold, nothing moves
+        ASSERT_FALSE(WEAR_LEVELING_CHECK(g_device_index, true));
+        config->wear_leveling_threshold = 10;
+        ASSERT_FALSE(WEAR_LEVELING_CHECK(g_device_index, true));
+
+        config->wear_leveling_threshold = 4;
+        uint64_t victim_nb = manager->total_victim_block_nb;
+        int64_t start = get_usec();
+        ASSERT_TRUE(WEAR_LEVELING_CHECK(g_device_index, true));
+        ASSERT_LT(start, get_usec());
+        // the erase is counted, and the block is free again
+        ASSERT_EQ(1u, cold->erase_count);
+        ASSERT_EQ(nullptr, cold->victim);
+        ASSERT_EQ(0u, cold->valid_page_nb);
+        // its pages filled up the write block of its plane instead
+        ASSERT_EQ(victim_nb, manager->total_victim_block_nb);
+        // its data is still mapped, elsewhere
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            uint64_t ppn = GET_MAPPING_INFO(g_device_index, lpn);
+            ASSERT_NE(MAPPING_TABLE_INIT_VAL, ppn);
+            ASSERT_NE((uint64_t)(cold - entries), ppn / config->page_nb);
+        }
+        config->wear_leveling_threshold = 0;
+    }
+
+    // Runs a skewed random write workload on an empty device and returns its write amplification
+    static double SkewedWriteAmplification(uint64_t write_nb) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+
+        RestartEmptyFTL();
+        unsigned long physical_before = wa_counters[g_device_index].physical_block_write_counter;
+        unsigned long logical_before = wa_counters[g_device_index].logical_block_write_counter;
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < write_nb; i++) {
+            // 90% of the writes go to 10% of the sectors
+            uint64_t sector_nb = rand_r(&seed) % max_sector_nb;
+            if (rand_r(&seed) % 10 < 9) {
+                sector_nb /= 10;
+            }
+            EXPECT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, sector_nb, 1, NULL));
+        }
+        return (double)(wa_counters[g_device_index].physical_block_write_counter - physical_before) /
+               (wa_counters[g_device_index].logical_block_write_counter - logical_before);
+    }
+
+    TEST_P(GCTest, CaseWriteStreams) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+
+        double shared_wa = SkewedWriteAmplification(4 * config->pages_in_ssd);
+
+        config->write_stream_separation = 1;
+        RestartEmptyFTL();
+        auto plane_of = [&](uint64_t ppn) {
+            uint64_t block_id = ppn / config->page_nb;
+            uint64_t plane_nb = (block_id % config->block_nb) % config->planes_per_flash;
+            return manager->empty_block_table_start + plane_nb * config->flash_nb + block_id / config->block_nb;
+        };
+
+        // a page written for the first time is cold, it is hot once rewritten
+        ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, 0, 1, NULL));
+        uint64_t cold_ppn = GET_MAPPING_INFO(g_device_index, 0);
+        ASSERT_EQ(cold_ppn / config->page_nb, plane_of(cold_ppn)->stream_block[WRITE_STREAM_COLD]);
+        ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, 0, 1, NULL));
+        uint64_t hot_ppn = GET_MAPPING_INFO(g_device_index, 0);
+        empty_block_root *root = plane_of(hot_ppn);
+        ASSERT_EQ(hot_ppn / config->page_nb, root->stream_block[WRITE_STREAM_HOT]);
+        ASSERT_NE(root->stream_block[WRITE_STREAM_HOT], root->stream_block[WRITE_STREAM_COLD]);
+
+        // the streams keep apart until a plane runs out of free blocks, and GC moves less data
+        double separated_wa = SkewedWriteAmplification(4 * config->pages_in_ssd);
+        printf("write amplification: shared %.2f, separated streams %.2f\n", shared_wa, separated_wa);
+        EXPECT_GT(shared_wa, separated_wa);
+        for (uint64_t i = 0; i < config->empty_table_entry_nb; i++) {
+            root = manager->empty_block_table_start + i;
+            for (int stream = 0; stream < WRITE_STREAM_NB; stream++) {
+                for (int other = stream + 1; other < WRITE_STREAM_NB; other++) {
+                    if (root->stream_block[stream] != NO_STREAM_BLOCK) {
+                        ASSERT_NE(root->stream_block[stream], root->stream_block[other]);
+                    }
+                }
+            }
+        }
+        config->write_stream_separation = 0;
+    }
+
+    TEST_P(GCTest, CaseIdleGC) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        const int gc_threshold_block_nb = config->gc_threshold_block_nb;
+        const uint64_t gc_low_thr_page_nb = config->gc_low_thr_page_nb;
+
+        // only the idle periods collect
+        config->gc_threshold_block_nb = 0;
+        config->gc_low_thr_page_nb = config->pages_in_ssd;
+        config->gc_idle_usec = 1000;
+        RestartEmptyFTL();
+        const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < config->pages_in_ssd; i++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, rand_r(&seed) % max_sector_nb, 1, NULL));
+        }
+        GC_NOTE_HOST_IO(g_device_index);
+        uint64_t free_page_nb = manager->total_zero_page_nb;
+        unsigned long physical = wa_counters[g_device_index].physical_block_write_counter;
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        // a gap shorter than the idle threshold is left alone
+        int64_t start = get_usec();
+        GC_IDLE(g_device_index, 500);
+        ASSERT_EQ(start + 500, get_usec());
+        ASSERT_EQ(free_page_nb, manager->total_zero_page_nb);
+
+        // a long one is used to collect, and the clock still ends with the gap
+        start = get_usec();
+        GC_IDLE(g_device_index, 10 * 1000 * 1000);
+        ASSERT_EQ(start + 10 * 1000 * 1000, get_usec());
+        ASSERT_LT(free_page_nb, manager->total_zero_page_nb);
+        ASSERT_LT(physical, wa_counters[g_device_index].physical_block_write_counter);
+        ASSERT_FALSE(gc_threads[g_device_index].victim_in_progress);
+
+        // the budget bounds the work of every gap, a victim is resumed in the next one
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        for (uint64_t i = 0; i < config->pages_in_ssd; i++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, rand_r(&seed) % max_sector_nb, 1, NULL));
+        }
+        GC_NOTE_HOST_IO(g_device_index);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+        config->gc_idle_budget_usec = 1;
+        physical = wa_counters[g_device_index].physical_block_write_counter;
+        start = get_usec();
+        GC_IDLE(g_device_index, 10 * 1000 * 1000);
+        ASSERT_EQ(start + 10 * 1000 * 1000, get_usec());
+        ASSERT_GE(physical + 1, wa_counters[g_device_index].physical_block_write_counter);
+        config->gc_idle_budget_usec = 0;
+        GC_IDLE(g_device_index, 10 * 1000 * 1000);
+        ASSERT_FALSE(gc_threads[g_device_index].victim_in_progress);
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+
+        config->gc_idle_usec = 0;
+        config->gc_low_thr_page_nb = gc_low_thr_page_nb;
+        config->gc_threshold_block_nb = gc_threshold_block_nb;
+    }
+
     TEST_P(GCTest, CaseReservedLBAs) {
         ssd_config_t *config = &devices[g_device_index];
 
-        pthread_mutex_unlock(&g_lock);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
         // "Exceed Sector number" error - reserved pages for GC
         ASSERT_EQ(FTL_FAILURE, FTL_WRITE_SECT(g_device_index, config->sectors_in_ssd, 1, NULL));
         ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, config->sectors_in_ssd - 1, 1, NULL));
-        pthread_mutex_lock(&g_lock);
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
     }
 
     TEST_P(GCTest, CasePerfGCThreadDisable) {
@@ -236,7 +657,7 @@ namespace ssd_io_emulator_tests {
         // 25% over-provisioning => 80% utilization
         const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
 
-        pthread_mutex_unlock(&g_lock);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
         unsigned int seed = 0;
         for (uint64_t i = 0; i < 10 * config->pages_in_ssd; i++) {
             uint64_t sector_nb = rand_r(&seed) % max_sector_nb;
@@ -244,12 +665,12 @@ namespace ssd_io_emulator_tests {
 
             // Simulate some "idle time" to really emphasize the benefits of background GC.
             if (i % (config->pages_in_ssd / background_gc_freq) == 0) {
-                pthread_mutex_lock(&g_lock);
+                pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
                 WaitForGC();
-                pthread_mutex_unlock(&g_lock);
+                pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
             }
         }
-        pthread_mutex_lock(&g_lock);
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
 
         _MONITOR_SYNC(g_device_index, &(log_server.stats), MONITOR_SLEEP_MAX_USEC);
         printSSDStat(&log_server.stats);
@@ -258,4 +679,76 @@ namespace ssd_io_emulator_tests {
         // a solid 1.0 write amplification. So this value seems safe enough:
         EXPECT_GT(1.2, log_server.stats.write_amplification);
     }
+
+    // GC on flash chips of two planes
+    class MultiPlaneGCTest : public GCTest {};
+
+    std::vector<SSDConf*> GetMultiPlaneTestParams() {
+        std::vector<SSDConf*> ssd_configs;
+
+        SSDConf* ssd_config = new SSDConf(parameters::sizemb::mb3);
+        ssd_config->set_planes_per_flash(2);
+        ssd_configs.push_back(ssd_config);
+
+        return ssd_configs;
+    }
+
+    INSTANTIATE_TEST_CASE_P(DiskSize, MultiPlaneGCTest, ::testing::ValuesIn(GetMultiPlaneTestParams()));
+
+    TEST_P(MultiPlaneGCTest, CaseMultiPlaneCopyback) {
+        ssd_config_t *config = &devices[g_device_index];
+        ASSERT_EQ(2u, config->planes_per_flash);
+
+        // two pages of plane 0, one stays there and one goes to plane 1
+        uint64_t sources[] = { 0, 1 };
+        uint64_t destinations[] = { 2 * config->page_nb, 3 * config->page_nb };
+        uint64_t physical_page_writes = ssds_manager[g_device_index].ssd.physical_page_writes;
+        ASSERT_EQ(FTL_FAILURE, SSD_MULTI_PLANE_COPYBACK(g_device_index, sources, destinations, 2, COPYBACK));
+        ASSERT_EQ(physical_page_writes, ssds_manager[g_device_index].ssd.physical_page_writes);
+
+        // through the controller buffer, both planes are programmed by one command
+        config->copyback_cross_plane = 1;
+        int64_t start = get_usec();
+        ASSERT_EQ(FTL_SUCCESS, SSD_MULTI_PLANE_COPYBACK(g_device_index, sources, destinations, 2, COPYBACK));
+        ASSERT_EQ(physical_page_writes + 2, ssds_manager[g_device_index].ssd.physical_page_writes);
+        SSD_REG_ACCESS(g_device_index, 0, 0, 1);
+        ASSERT_EQ(start + 2 * config->cell_read_delay + config->reg_read_delay + config->reg_write_delay + config->cell_program_delay, get_usec());
+        // a plane takes a single page of a command
+        destinations[1] = 4 * config->page_nb;
+        ASSERT_EQ(FTL_FAILURE, SSD_MULTI_PLANE_COPYBACK(g_device_index, sources, destinations, 2, COPYBACK));
+
+        // GC moves the pages of a victim two at a time, to both planes of its flash
+        config->copyback_multi_plane_page_nb = 2;
+        RestartEmptyFTL();
+        const uint64_t lpn_nb = config->pages_in_ssd / 2;
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+        uint64_t victim = GET_MAPPING_INFO(g_device_index, 0) / config->page_nb;
+        std::vector<uint64_t> moved_lpns;
+        for (uint64_t lpn = 1; lpn < lpn_nb; lpn++) {
+            if (GET_MAPPING_INFO(g_device_index, lpn) / config->page_nb == victim) {
+                moved_lpns.push_back(lpn);
+            }
+        }
+        ASSERT_EQ(config->page_nb - 1, moved_lpns.size());
+        ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, 0, 1, NULL));
+
+        unsigned long physical = wa_counters[g_device_index].physical_block_write_counter;
+        ASSERT_EQ(FTL_SUCCESS, GARBAGE_COLLECTION(g_device_index, 0, false));
+        // the pages and the erase
+        ASSERT_EQ(physical + moved_lpns.size() + 1, wa_counters[g_device_index].physical_block_write_counter);
+        ASSERT_EQ(0u, inverse_mappings_manager[g_device_index].inverse_block_mapping_table_start[victim].valid_page_nb);
+        uint64_t plane_page_nb[2] = { 0, 0 };
+        for (uint64_t lpn : moved_lpns) {
+            uint64_t block_id = GET_MAPPING_INFO(g_device_index, lpn) / config->page_nb;
+            ASSERT_EQ(victim / config->block_nb, block_id / config->block_nb);
+            plane_page_nb[(block_id % config->block_nb) % 2]++;
+        }
+        ASSERT_EQ((moved_lpns.size() + 1) / 2, plane_page_nb[(victim % config->block_nb) % 2]);
+        ASSERT_EQ(moved_lpns.size() / 2, plane_page_nb[1 - (victim % config->block_nb) % 2]);
+
+        config->copyback_multi_plane_page_nb = 1;
+        config->copyback_cross_plane = 0;
+    }
 }
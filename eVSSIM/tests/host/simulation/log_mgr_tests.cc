@@ -641,6 +641,7 @@ namespace log_mgr_tests {
             .die = 352,
             .block = 947,
             .dirty_page_nb = 10,
+            .erase_count = 3,
             .background = false,
             .metadata = LOG_META(g_device_index, start, start + 1),
         };
@@ -652,6 +653,7 @@ namespace log_mgr_tests {
         ASSERT_EQ(log.die, res.die);
         ASSERT_EQ(log.block, res.block);
         ASSERT_EQ(log.dirty_page_nb, res.dirty_page_nb);
+        ASSERT_EQ(log.erase_count, res.erase_count);
     }
     /**
      * Test writing and reading a channel switch to read log
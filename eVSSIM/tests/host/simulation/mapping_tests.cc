@@ -0,0 +1,574 @@
+/*
+ * Copyright 2025 The Open University of Israel
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "base_emulator_tests.h"
+
+namespace mapping_tests {
+
+    class MappingUnitTest : public BaseTest {
+        public:
+            virtual void SetUp() {
+                BaseTest::SetUp();
+                INIT_LOG_MANAGER(g_device_index);
+            }
+
+            virtual void TearDown() {
+                BaseTest::TearDown(false);
+                TERM_LOG_MANAGER(g_device_index);
+                TERM_SSD_CONFIG();
+            }
+
+            // Restart the FTL of the test device with a tweaked configuration
+            void ReinitFTL(void) {
+                FTL_TERM(g_device_index);
+                FTL_INIT(g_device_index);
+            }
+    };
+
+    std::vector<SSDConf*> GetTestParams() {
+        std::vector<SSDConf*> ssd_configs;
+
+        ssd_configs.push_back(new SSDConf(parameters::sizemb::mb1));
+        ssd_configs.push_back(new SSDConf(parameters::sizemb::mb4));
+
+        return ssd_configs;
+    }
+
+    INSTANTIATE_TEST_CASE_P(DiskSize, MappingUnitTest, ::testing::ValuesIn(GetTestParams()));
+
+    TEST_P(MappingUnitTest, MmapTablePersists) {
+        ssd_config_t *config = &devices[g_device_index];
+        config->mapping_table_mmap = 1;
+        config->mapping_flush_interval_sec = 100 * 3600; // only flush explicitly
+        ReinitFTL();
+
+        const uint64_t lpn_nb = config->sectors_in_ssd / config->sectors_per_page;
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(MAPPING_TABLE_INIT_VAL, GET_MAPPING_INFO(g_device_index, lpn));
+        }
+
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn += 3) {
+            ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+
+        std::vector<uint64_t> expected(lpn_nb);
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            expected[lpn] = GET_MAPPING_INFO(g_device_index, lpn);
+            ASSERT_EQ(lpn % 3 != 0, expected[lpn] == MAPPING_TABLE_INIT_VAL);
+        }
+
+        // only the touched regions are written back
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        FLUSH_MAPPING_TABLE(g_device_index);
+        uint64_t flushed = mapping_mmaps[g_device_index].flushed_region_nb;
+        ASSERT_LT(0u, flushed);
+        ASSERT_GE((lpn_nb * config->mapping_entry_size + MAPPING_DIRTY_REGION_SIZE - 1) / MAPPING_DIRTY_REGION_SIZE, flushed);
+        FLUSH_MAPPING_TABLE(g_device_index);
+        ASSERT_EQ(flushed, mapping_mmaps[g_device_index].flushed_region_nb);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        ReinitFTL();
+
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(expected[lpn], GET_MAPPING_INFO(g_device_index, lpn));
+        }
+    }
+
+    TEST_P(MappingUnitTest, CachedMappingTableEviction) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t entries_per_tpage = config->page_size / config->mapping_entry_size;
+        config->mapping_cache_entry_nb = entries_per_tpage; // a single cached translation page
+        ReinitFTL();
+
+        mapping_cache_t *cache = &mapping_caches[g_device_index];
+        ASSERT_EQ(1u, cache->slot_nb);
+
+        uint64_t ppn;
+        ASSERT_EQ(FTL_SUCCESS, GET_NEW_PAGE(g_device_index, VICTIM_OVERALL, config->empty_table_entry_nb, &ppn));
+        ASSERT_EQ(FTL_SUCCESS, UPDATE_NEW_PAGE_MAPPING(g_device_index, 0, ppn));
+        ASSERT_EQ(MAPPING_TABLE_INIT_VAL, GET_MAPPING_INFO(g_device_index, 1));
+        ASSERT_EQ(ppn, GET_MAPPING_INFO(g_device_index, 0));
+        ASSERT_EQ(1u, cache->miss_nb);
+        ASSERT_EQ(2u, cache->hit_nb);
+        ASSERT_EQ(0u, cache->writeback_nb);
+
+        if (cache->tpage_nb > 1) {
+            // the dirty translation page of lpn 0 is written back to make room
+            ASSERT_EQ(MAPPING_TABLE_INIT_VAL, GET_MAPPING_INFO(g_device_index, entries_per_tpage));
+            ASSERT_EQ(2u, cache->miss_nb);
+            ASSERT_EQ(1u, cache->writeback_nb);
+
+            // evicting a clean translation page costs no write
+            ASSERT_EQ(ppn, GET_MAPPING_INFO(g_device_index, 0));
+            ASSERT_EQ(3u, cache->miss_nb);
+            ASSERT_EQ(1u, cache->writeback_nb);
+        }
+    }
+
+    TEST_P(MappingUnitTest, CompactEntriesMatchWide) {
+        ssd_config_t *config = &devices[g_device_index];
+        ASSERT_EQ(sizeof(uint32_t), config->mapping_entry_size);
+
+        const uint64_t lpn_nb = config->sectors_in_ssd / config->sectors_per_page;
+
+        for (uint32_t entry_size : {sizeof(uint32_t), sizeof(uint64_t)}) {
+            if (entry_size != config->mapping_entry_size) {
+                // restart on a fresh device with the other entry width
+                FTL_TERM(g_device_index);
+                char *filename = GET_DATA_FILENAME(g_device_index, "mapping_table.dat");
+                remove(filename);
+                free(filename);
+                config->mapping_entry_size = entry_size;
+                FTL_INIT(g_device_index);
+            }
+
+            for (uint64_t lpn = 0; lpn < lpn_nb; lpn += 2) {
+                ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+            }
+            // overwrite some pages so the inverse table holds unmapped entries as well
+            for (uint64_t lpn = 0; lpn < lpn_nb; lpn += 6) {
+                ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+            }
+
+            pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+            uint64_t mapped_nb = 0;
+            for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+                uint64_t ppn = GET_MAPPING_INFO(g_device_index, lpn);
+                ASSERT_EQ(lpn % 2 != 0, ppn == MAPPING_TABLE_INIT_VAL);
+                if (ppn == MAPPING_TABLE_INIT_VAL)
+                    continue;
+
+                uint64_t inverse_lpn;
+                GET_INVERSE_MAPPING_INFO(g_device_index, ppn, &inverse_lpn);
+                ASSERT_EQ(lpn, inverse_lpn);
+                mapped_nb++;
+            }
+
+            uint64_t inverse_mapped_nb = 0;
+            for (uint64_t ppn = 0; ppn < config->pages_in_ssd; ppn++) {
+                uint64_t lpn;
+                GET_INVERSE_MAPPING_INFO(g_device_index, ppn, &lpn);
+                if (lpn != MAPPING_TABLE_INIT_VAL)
+                    inverse_mapped_nb++;
+            }
+            pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+            ASSERT_EQ(mapped_nb, inverse_mapped_nb);
+        }
+    }
+
+    TEST_P(MappingUnitTest, ExtentMappingSequentialRuns) {
+        ssd_config_t *config = &devices[g_device_index];
+        config->mapping_extents = 1;
+        ReinitFTL();
+
+        mapping_extents_t *me = &mapping_extents[g_device_index];
+        const uint64_t lpn_nb = config->sectors_in_ssd / config->sectors_per_page;
+        const uint64_t run_nb = std::min<uint64_t>(lpn_nb, config->page_nb * config->flash_nb);
+
+        // a sequential write is kept as one extent per run of consecutive ppns
+        // (the allocator may stripe it over the planes), lone pages as overrides
+        ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, 0, run_nb * config->sectors_per_page, NULL));
+        std::vector<uint64_t> written(run_nb);
+        for (uint64_t lpn = 0; lpn < run_nb; lpn++) {
+            written[lpn] = GET_MAPPING_INFO(g_device_index, lpn);
+        }
+        const int64_t stride = written[1] - written[0];
+        uint64_t first_run_nb = 1;
+        while (first_run_nb < run_nb && written[first_run_nb] == written[first_run_nb - 1] + stride)
+            first_run_nb++;
+        ASSERT_LT(1u, first_run_nb);
+        ASSERT_GT(run_nb, me->extent_nb * 2 + me->override_nb);
+
+        uint64_t ppn;
+        int64_t ppn_stride;
+        ASSERT_EQ(first_run_nb, GET_MAPPING_RUN(g_device_index, 0, lpn_nb, &ppn, &ppn_stride));
+        ASSERT_EQ(written[0], ppn);
+        ASSERT_EQ(stride, ppn_stride);
+        ASSERT_EQ(FTL_SUCCESS, FTL_READ_SECT(g_device_index, 0, run_nb * config->sectors_per_page, NULL));
+
+        // rewriting a page inside the first run splits it with an override
+        // (under the device lock, so the background GC can't relocate pages meanwhile)
+        if (first_run_nb > 2) {
+            pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+            const uint64_t extent_nb = me->extent_nb, override_nb = me->override_nb;
+            ASSERT_EQ(FTL_SUCCESS, _FTL_WRITE_SECT(g_device_index, (first_run_nb / 2) * config->sectors_per_page, 1, NULL));
+            ASSERT_EQ(extent_nb, me->extent_nb);
+            ASSERT_EQ(override_nb + 1, me->override_nb);
+            ASSERT_EQ(1u, GET_MAPPING_RUN(g_device_index, 0, lpn_nb, &ppn, &ppn_stride));
+            pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+        }
+
+        for (uint64_t lpn = run_nb; lpn < lpn_nb; lpn += 3) {
+            ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, 1, NULL));
+        }
+
+        std::vector<uint64_t> expected(lpn_nb);
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            expected[lpn] = GET_MAPPING_INFO(g_device_index, lpn);
+            if (expected[lpn] == MAPPING_TABLE_INIT_VAL)
+                continue;
+
+            uint64_t inverse_lpn;
+            GET_INVERSE_MAPPING_INFO(g_device_index, expected[lpn], &inverse_lpn);
+            ASSERT_EQ(lpn, inverse_lpn);
+        }
+
+        // the extents are stored as a flat table and rebuilt from it
+        ReinitFTL();
+        for (uint64_t lpn = 0; lpn < lpn_nb; lpn++) {
+            ASSERT_EQ(expected[lpn], GET_MAPPING_INFO(g_device_index, lpn));
+        }
+    }
+
+    TEST_P(MappingUnitTest, DecodePpnMatchesDivision) {
+        ssd_config_t *config = &devices[g_device_index];
+
+        for (uint64_t ppn = 0; ppn < config->pages_in_ssd; ppn++) {
+            ppn_coords_t coords;
+            DECODE_PPN(g_device_index, ppn, &coords);
+
+            const uint64_t flash = (ppn / config->page_nb) / config->block_nb;
+            const uint64_t block = (ppn / config->page_nb) % config->block_nb;
+            ASSERT_EQ(flash, coords.flash);
+            ASSERT_EQ(block, coords.block);
+            ASSERT_EQ(ppn % config->page_nb, coords.page);
+            ASSERT_EQ(block % config->planes_per_flash, coords.plane);
+            ASSERT_EQ(flash * config->planes_per_flash + block % config->planes_per_flash, coords.reg);
+            ASSERT_EQ(flash % config->channel_nb, coords.channel);
+
+            ASSERT_EQ(coords.flash, CALC_FLASH(g_device_index, ppn));
+            ASSERT_EQ(coords.block, CALC_BLOCK(g_device_index, ppn));
+            ASSERT_EQ(coords.page, CALC_PAGE(g_device_index, ppn));
+            ASSERT_EQ(coords.reg, CALC_PLANE(g_device_index, ppn));
+            ASSERT_EQ(coords.channel, CALC_CHANNEL(g_device_index, ppn));
+        }
+
+        // dividends beyond 32 bits take the slow path
+        const geometry_divisor_t *page_nb = &config->geometry.page_nb;
+        for (uint64_t n : {(uint64_t)UINT32_MAX, (uint64_t)UINT32_MAX + 1, (uint64_t)UINT64_MAX, (uint64_t)123456789012345ULL}) {
+            uint64_t rem;
+            ASSERT_EQ(n / config->page_nb, GEOMETRY_DIVMOD(page_nb, n, &rem));
+            ASSERT_EQ(n % config->page_nb, rem);
+        }
+    }
+
+    TEST_P(MappingUnitTest, EmptyBlockPoolIsFifo) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        empty_block_root *root = manager->empty_block_table_start;
+        const uint64_t block_nb = root->empty_block_nb;
+        ASSERT_EQ(config->each_empty_table_entry_nb, block_nb);
+
+        // blocks of a plane are handed out in ascending order
+        for (uint64_t i = 0; i < block_nb; i++) {
+            empty_block_entry *entry = GET_EMPTY_BLOCK(g_device_index, VICTIM_INCHIP, 0);
+            ASSERT_EQ(0u, entry->phy_flash_nb);
+            ASSERT_EQ(i * config->planes_per_flash, entry->phy_block_nb);
+            EJECT_EMPTY_BLOCK(g_device_index, 0);
+        }
+        ASSERT_EQ(0u, root->empty_block_nb);
+
+        // reclaimed blocks are reused in the order they were erased
+        const uint64_t zero_page_nb = manager->total_zero_page_nb;
+        for (uint64_t i = block_nb; i > 0; i--) {
+            ASSERT_EQ(FTL_SUCCESS, INSERT_EMPTY_BLOCK(g_device_index, 0, (i - 1) * config->planes_per_flash));
+        }
+        ASSERT_EQ(block_nb, root->empty_block_nb);
+        ASSERT_EQ(zero_page_nb + block_nb * config->page_nb, manager->total_zero_page_nb);
+        ASSERT_EQ(FTL_FAILURE, INSERT_EMPTY_BLOCK(g_device_index, 0, 0));
+
+        for (uint64_t i = block_nb; i > 0; i--) {
+            empty_block_entry *entry = GET_EMPTY_BLOCK(g_device_index, VICTIM_INCHIP, 0);
+            ASSERT_EQ((i - 1) * config->planes_per_flash, entry->phy_block_nb);
+            ASSERT_EQ(0u, entry->curr_phy_page_nb);
+            EJECT_EMPTY_BLOCK(g_device_index, 0);
+        }
+    }
+
+    TEST_P(MappingUnitTest, PageStateBitmap) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_block_mapping_entry *entry = GET_INVERSE_BLOCK_MAPPING_ENTRY(g_device_index, 0, 0);
+        const uint64_t word_nb = inverse_mappings_manager[g_device_index].page_bitmap_word_nb;
+
+        for (uint64_t page = 0; page < config->page_nb; page++) {
+            ASSERT_EQ(PAGE_ZERO, GET_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, page));
+        }
+        ASSERT_EQ(word_nb * 64, NEXT_SET_BIT(entry->valid_bitmap, word_nb, 0));
+
+        for (uint64_t page = 0; page < config->page_nb; page += 3) {
+            ASSERT_EQ(FTL_SUCCESS, UPDATE_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, page, PAGE_VALID));
+        }
+        ASSERT_EQ(FTL_SUCCESS, UPDATE_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, 0, PAGE_INVALID));
+        ASSERT_EQ(FTL_FAILURE, UPDATE_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, 0, PAGE_VALID));
+        ASSERT_EQ((config->page_nb + 2) / 3 - 1, entry->valid_page_nb);
+
+        // only the valid pages are visited
+        uint64_t expected = 3;
+        for (uint64_t page = NEXT_SET_BIT(entry->valid_bitmap, word_nb, 0); page < config->page_nb;
+                page = NEXT_SET_BIT(entry->valid_bitmap, word_nb, page + 1)) {
+            ASSERT_EQ(expected, page);
+            ASSERT_EQ(PAGE_VALID, GET_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, page));
+            expected += 3;
+        }
+        ASSERT_LE(config->page_nb, expected);
+        ASSERT_EQ(PAGE_INVALID, GET_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, 0));
+        ASSERT_EQ(PAGE_ZERO, GET_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, 1));
+
+        ASSERT_EQ(FTL_SUCCESS, UPDATE_INVERSE_BLOCK_MAPPING(g_device_index, 0, 0, EMPTY_BLOCK));
+        ASSERT_EQ(0u, entry->valid_page_nb);
+        for (uint64_t page = 0; page < config->page_nb; page++) {
+            ASSERT_EQ(PAGE_ZERO, GET_INVERSE_BLOCK_VALIDITY(g_device_index, 0, 0, page));
+        }
+    }
+
+    TEST_P(MappingUnitTest, SnapshotRestoresState) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        config->ftl_snapshot = 1;
+
+        // overwrite enough of the drive to have victims and a few GC rounds behind us
+        const uint64_t max_sector_nb = config->sectors_in_ssd * 8 / 10;
+        unsigned int seed = 0;
+        for (uint64_t i = 0; i < 2 * config->pages_in_ssd; i++) {
+            ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, rand_r(&seed) % max_sector_nb, 1, NULL));
+        }
+
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        // the background GC must not move pages between the capture and the restart
+        config->gc_threshold_block_nb = 0;
+        const uint64_t zero_page_nb = manager->total_zero_page_nb;
+        const uint64_t victim_block_nb = manager->total_victim_block_nb;
+        std::vector<uint64_t> lpns(config->pages_in_ssd);
+        for (uint64_t ppn = 0; ppn < config->pages_in_ssd; ppn++) {
+            GET_INVERSE_MAPPING_INFO(g_device_index, ppn, &lpns[ppn]);
+        }
+        std::vector<inverse_block_mapping_entry> blocks(manager->inverse_block_mapping_table_start,
+                manager->inverse_block_mapping_table_start + config->block_mapping_entry_nb);
+        std::vector<uint64_t> page_states(manager->page_state_bitmaps,
+                manager->page_state_bitmaps + config->block_mapping_entry_nb * 2 * manager->page_bitmap_word_nb);
+        std::vector<uint64_t> free_blocks;
+        for (uint64_t i = 0; i < config->empty_table_entry_nb; i++) {
+            empty_block_root *root = manager->empty_block_table_start + i;
+            free_blocks.push_back(root->empty_block_nb);
+            for (uint64_t k = 0; k < root->empty_block_nb; k++) {
+                uint64_t block = root->ring[(root->head + k) % root->capacity];
+                free_blocks.push_back(block);
+                free_blocks.push_back(manager->empty_block_entries[block].curr_phy_page_nb);
+            }
+        }
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        ReinitFTL();
+
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        ASSERT_EQ(zero_page_nb, manager->total_zero_page_nb);
+        ASSERT_EQ(victim_block_nb, manager->total_victim_block_nb);
+        ASSERT_EQ(victim_block_nb, manager->victim_block_index.victim_block_nb);
+        for (uint64_t ppn = 0; ppn < config->pages_in_ssd; ppn++) {
+            uint64_t lpn;
+            GET_INVERSE_MAPPING_INFO(g_device_index, ppn, &lpn);
+            ASSERT_EQ(lpns[ppn], lpn);
+        }
+        for (uint64_t block = 0; block < config->block_mapping_entry_nb; block++) {
+            inverse_block_mapping_entry *entry = manager->inverse_block_mapping_table_start + block;
+            ASSERT_EQ(blocks[block].valid_page_nb, entry->valid_page_nb);
+            ASSERT_EQ(blocks[block].type, entry->type);
+            ASSERT_EQ(blocks[block].victim != NULL, entry->victim != NULL);
+        }
+        for (uint64_t i = 0; i < page_states.size(); i++) {
+            ASSERT_EQ(page_states[i], manager->page_state_bitmaps[i]);
+        }
+        std::vector<uint64_t> resumed_free_blocks;
+        for (uint64_t i = 0; i < config->empty_table_entry_nb; i++) {
+            empty_block_root *root = manager->empty_block_table_start + i;
+            resumed_free_blocks.push_back(root->empty_block_nb);
+            for (uint64_t k = 0; k < root->empty_block_nb; k++) {
+                uint64_t block = root->ring[(root->head + k) % root->capacity];
+                resumed_free_blocks.push_back(block);
+                resumed_free_blocks.push_back(manager->empty_block_entries[block].curr_phy_page_nb);
+            }
+        }
+        ASSERT_EQ(free_blocks, resumed_free_blocks);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        // the resumed drive keeps working
+        for (uint64_t i = 0; i < config->pages_in_ssd; i++) {
+            ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, rand_r(&seed) % max_sector_nb, 1, NULL));
+        }
+        for (uint64_t lpn = 0; lpn < max_sector_nb / config->sectors_per_page; lpn++) {
+            uint64_t ppn = GET_MAPPING_INFO(g_device_index, lpn);
+            if (ppn != MAPPING_TABLE_INIT_VAL) {
+                uint64_t inverse_lpn;
+                GET_INVERSE_MAPPING_INFO(g_device_index, ppn, &inverse_lpn);
+                ASSERT_EQ(lpn, inverse_lpn);
+            }
+        }
+
+        // a snapshot of another format version is ignored
+        FTL_TERM(g_device_index);
+        config->ftl_snapshot = 0;
+        FTL_INIT(g_device_index);
+
+        char *filename = GET_DATA_FILENAME(g_device_index, "ftl_snapshot.dat");
+        FILE *fp = fopen(filename, "r+b");
+        ASSERT_NE((FILE *)NULL, fp);
+        uint32_t version = FTL_SNAPSHOT_VERSION + 1;
+        ASSERT_EQ(0, fseek(fp, offsetof(ftl_snapshot_header_t, version), SEEK_SET));
+        ASSERT_EQ(1u, fwrite(&version, sizeof(version), 1, fp));
+        fclose(fp);
+
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        ASSERT_EQ(FTL_FAILURE, LOAD_FTL_SNAPSHOT(g_device_index));
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+        remove(filename);
+        free(filename);
+    }
+
+    TEST_P(MappingUnitTest, FreePlaneBitmapSkipsExhaustedPlanes) {
+        ssd_config_t *config = &devices[g_device_index];
+        inverse_mapping_manager_t *manager = &inverse_mappings_manager[g_device_index];
+        empty_block_root *root = manager->empty_block_table_start;
+        ASSERT_LT(1u, config->empty_table_entry_nb);
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+
+        // drain the free blocks of the first plane
+        const uint64_t block_nb = root->empty_block_nb;
+        for (uint64_t i = 0; i < block_nb; i++) {
+            ASSERT_NE(0u, manager->free_plane_bitmap[0] & 1);
+            EJECT_EMPTY_BLOCK(g_device_index, 0);
+        }
+        ASSERT_EQ(0u, manager->free_plane_bitmap[0] & 1);
+
+        // round robin moves on to the next plane that has free blocks
+        manager->empty_block_table_index = 0;
+        empty_block_entry *entry = GET_EMPTY_BLOCK(g_device_index, VICTIM_OVERALL, config->empty_table_entry_nb);
+        ASSERT_NE((empty_block_entry *)NULL, entry);
+        ASSERT_EQ(1u, entry->phy_flash_nb);
+        ASSERT_EQ(2u % config->empty_table_entry_nb, manager->empty_block_table_index);
+
+        // and wraps to the start of the table
+        manager->empty_block_table_index = config->empty_table_entry_nb - 1;
+        entry = GET_EMPTY_BLOCK(g_device_index, VICTIM_OVERALL, config->empty_table_entry_nb);
+        ASSERT_EQ(0u, manager->empty_block_table_index);
+
+        if (config->planes_per_flash == 1) {
+            ASSERT_EQ((empty_block_entry *)NULL, GET_EMPTY_BLOCK(g_device_index, VICTIM_INCHIP, 0));
+        }
+
+        ASSERT_EQ(FTL_SUCCESS, INSERT_EMPTY_BLOCK(g_device_index, 0, 0));
+        ASSERT_NE(0u, manager->free_plane_bitmap[0] & 1);
+        entry = GET_EMPTY_BLOCK(g_device_index, VICTIM_INCHIP, 0);
+        ASSERT_EQ(0u, entry->phy_flash_nb);
+        ASSERT_EQ(0u, entry->phy_block_nb);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+    }
+
+    static void *WriteOtherDevice(void *arg) {
+        uint8_t device_index = *(uint8_t *)arg;
+        ftl_ret_val *ret = (ftl_ret_val *)malloc(sizeof(*ret));
+        *ret = FTL_WRITE_SECT(device_index, 0, 1, NULL);
+        if (*ret == FTL_SUCCESS)
+            *ret = FTL_READ_SECT(device_index, 0, 1, NULL);
+        return ret;
+    }
+
+    TEST_P(MappingUnitTest, DeviceLocksAreIndependent) {
+        uint8_t other_device = g_device_index + 1;
+        ASSERT_LT(other_device, device_count);
+        FTL_INIT(other_device);
+
+        // with this device's lock held, I/O to another device still goes through
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        pthread_t tid;
+        void *ret = NULL;
+        ASSERT_EQ(0, pthread_create(&tid, NULL, WriteOtherDevice, &other_device));
+        ASSERT_EQ(0, pthread_join(tid, &ret));
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        ASSERT_EQ(FTL_SUCCESS, *(ftl_ret_val *)ret);
+        free(ret);
+        ASSERT_EQ(1u, wa_counters[other_device].logical_block_write_counter);
+        ASSERT_EQ(0u, wa_counters[g_device_index].logical_block_write_counter);
+        ASSERT_EQ(1u, perf_checkers[other_device].written_page_nb);
+
+        FTL_TERM(other_device);
+        std::ignore = system((std::string("rm -rf data/") + std::to_string(other_device)).c_str());
+    }
+
+    struct PageReader {
+        uint64_t page_nb;
+        bool ok;
+    };
+
+    // Read the first page_nb pages back and check that each one carries its own lpn
+    static void *ReadPages(void *arg) {
+        PageReader *reader = (PageReader *)arg;
+        ssd_config_t *config = &devices[g_device_index];
+        unsigned char *data = (unsigned char *)malloc(config->page_size);
+
+        reader->ok = true;
+        for (int round = 0; round < 10; round++) {
+            for (uint64_t lpn = 0; lpn < reader->page_nb; lpn++) {
+                if (FTL_READ_SECT(g_device_index, lpn * config->sectors_per_page, config->sectors_per_page, data) != FTL_SUCCESS ||
+                    data[0] != (unsigned char)lpn || data[config->page_size - 1] != (unsigned char)lpn)
+                    reader->ok = false;
+            }
+        }
+
+        free(data);
+        return NULL;
+    }
+
+    TEST_P(MappingUnitTest, ReadsShareDeviceLock) {
+        ssd_config_t *config = &devices[g_device_index];
+        const uint64_t page_nb = 16;
+        const int reader_nb = 4;
+
+        // start from an erased image so the data writes are program compatible
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        ASSERT_EQ(FTL_SUCCESS, _FTL_CREATE(g_device_index));
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        unsigned char *data = (unsigned char *)malloc(config->page_size);
+        for (uint64_t lpn = 0; lpn < page_nb; lpn++) {
+            memset(data, (unsigned char)lpn, config->page_size);
+            ASSERT_EQ(FTL_SUCCESS, FTL_WRITE_SECT(g_device_index, lpn * config->sectors_per_page, config->sectors_per_page, data));
+        }
+        free(data);
+
+        // readers hold the device lock shared: writers stay out, other readers get in
+        pthread_rwlock_rdlock(DEVICE_LOCK(g_device_index));
+        ASSERT_EQ(EBUSY, pthread_rwlock_trywrlock(DEVICE_LOCK(g_device_index)));
+
+        pthread_t tids[reader_nb];
+        PageReader readers[reader_nb];
+        for (int i = 0; i < reader_nb; i++) {
+            readers[i].page_nb = page_nb;
+            ASSERT_EQ(0, pthread_create(&tids[i], NULL, ReadPages, &readers[i]));
+        }
+        for (int i = 0; i < reader_nb; i++) {
+            ASSERT_EQ(0, pthread_join(tids[i], NULL));
+            ASSERT_TRUE(readers[i].ok);
+        }
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+        // every read closed its request and got its latency accounted
+        pthread_mutex_lock(&perf_checkers[g_device_index].lock);
+        ASSERT_EQ(0u, perf_checkers[g_device_index].io_request_nb);
+        pthread_mutex_unlock(&perf_checkers[g_device_index].lock);
+        ASSERT_EQ(UINT32_MAX, CURRENT_IO_REQUEST_NB());
+    }
+}
@@ -7,6 +7,8 @@ extern "C" {
 #include "osd.h"
 #include "osd-util/osd-util.h"
 #include "osd-util/osd-defs.h"
+
+extern page_node *global_page_table;
 }
 extern "C" int g_init;
 extern "C" int clientSock;
@@ -203,6 +205,49 @@ namespace object_tests {
         printf("SimpleObjectCreateDelete test ended\n");
     }
 
+    static uint64_t ValidPageCount() {
+        uint64_t valid_page_nb = 0;
+        for (uint64_t i = 0; i < devices[g_device_index].block_mapping_entry_nb; i++) {
+            valid_page_nb += inverse_mappings_manager[g_device_index].inverse_block_mapping_table_start[i].valid_page_nb;
+        }
+        return valid_page_nb;
+    }
+
+    TEST_P(ObjectUnitTest, ObjectChurnSteadyState) {
+        const unsigned int object_nb = objects_in_ssd_ / 2;
+        const int round_nb = 3;
+        obj_id_t objects[object_nb];
+
+        // every round writes most of the device, so only GC lets the later ones through
+        for (int round = 0; round < round_nb; round++) {
+            for (unsigned int p = 0; p < object_nb; p++) {
+                objects[p].object_id = USEROBJECT_OID_LB + p;
+                objects[p].partition_id = USEROBJECT_PID_LB;
+                ASSERT_TRUE(FTL_OBJ_CREATE(g_device_index, objects[p], object_size_)) << "round " << round << " object " << p;
+            }
+            for (unsigned int p = 0; p < object_nb; p++) {
+                ASSERT_EQ(FTL_SUCCESS, FTL_OBJ_WRITE(g_device_index, objects[p], NULL, 0, GET_PAGE_SIZE(g_device_index)));
+            }
+
+            pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+            ASSERT_EQ((uint64_t)HASH_COUNT(global_page_table), ValidPageCount());
+            pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+
+            for (unsigned int p = 0; p < object_nb; p++) {
+                ASSERT_EQ(FTL_SUCCESS, FTL_OBJ_DELETE(g_device_index, objects[p]));
+            }
+        }
+
+        pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index));
+        ASSERT_EQ(0u, HASH_COUNT(global_page_table));
+        ASSERT_EQ(0u, ValidPageCount());
+
+        // nothing is left to copy, so GC can reclaim every full block
+        while (FTL_OBJ_GC_CHECK(g_device_index, true, false));
+        ASSERT_EQ(0u, inverse_mappings_manager[g_device_index].total_victim_block_nb);
+        pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
+    }
+
     // This UT uses the offset. let's comment it for now.
     /*
     TEST_P(ObjectUnitTest, ObjectGrowthTest) {
@@ -80,6 +80,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // physical cell read
             {
@@ -102,6 +107,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // channel switch to write
             {
@@ -124,6 +134,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // physical cell program
             {
@@ -146,6 +161,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // garbage collection
             {
@@ -168,6 +188,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // logical cell program
             // register write
@@ -191,6 +216,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // physical cell program
             {
@@ -213,6 +243,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // logical cell program
             {
@@ -235,6 +270,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // block erase
                         {
@@ -257,6 +297,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // channel switch to read
             {
@@ -279,6 +324,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // physical cell read
             {
@@ -301,6 +351,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             },
             // garbage collection
             {
@@ -323,6 +378,11 @@ namespace rt_subscriber {
                     .background_read_count = 0,
                     .background_garbage_collection_count = 0,
                     .background_block_erase_count = 0,
+                    .mapping_cache_hit_count = 0,
+                    .mapping_cache_miss_count = 0,
+                    .mapping_cache_writeback_count = 0,
+                    .wear_leveling_count = 0,
+                    .wear_leveling_page_count = 0,
             }
     };
 
@@ -381,7 +441,7 @@ namespace rt_subscriber {
         TIME_MICROSEC(end9);
         LOG_BLOCK_ERASE(logger, (BlockEraseLog) {
             .channel = 25, .die = 26, .block = 27, .dirty_page_nb = devices[g_device_index].page_nb,
-            .background = false,
+            .erase_count = 1, .background = false,
             .metadata = LOG_META(g_device_index, start, end9),
         });
         TIME_MICROSEC(end10);
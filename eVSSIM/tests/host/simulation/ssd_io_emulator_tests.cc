@@ -26,7 +26,7 @@ extern int clientSock;
 extern int errno;
 
 extern ssd_disk ssd;
-extern write_amplification_counters wa_counters;
+extern write_amplification_counters *wa_counters;
 extern RTLogStatistics* rt_log_stats;
 
 // New browser delay values
@@ -43,11 +43,11 @@ namespace ssd_io_emulator_tests {
             virtual void SetUp() {
                 BaseTest::SetUp();
                 INIT_LOG_MANAGER(g_device_index);
-                pthread_mutex_lock(&g_lock); // prevent the GC thread from running
+                pthread_rwlock_wrlock(DEVICE_LOCK(g_device_index)); // prevent the GC thread from running
             }
 
             virtual void TearDown() {
-                pthread_mutex_unlock(&g_lock);
+                pthread_rwlock_unlock(DEVICE_LOCK(g_device_index));
                 BaseTest::TearDown(false);
                 TERM_LOG_MANAGER(g_device_index);
                 TERM_SSD_CONFIG();
@@ -101,4 +101,105 @@ namespace ssd_file_ops_test
         memset(data, 0xFF, sizeof(data));
         ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
     }
+
+    class SsdFileHandleTest : public SsdFileOpsTest, public ::testing::WithParamInterface<ssd_file_mode>
+    {
+    };
+
+    TEST_P(SsdFileHandleTest, WriteReadEraseTest) {
+        ssd_file file;
+        unsigned char data[SECTOR_SIZE] = "SSD handle test";
+        unsigned char read_back[SECTOR_SIZE] = {0};
+
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_open(&file, TEST_FILE, GetParam()));
+        ASSERT_EQ(4096u, file.capacity);
+
+        ASSERT_TRUE(ssd_file_is_program_compatible(&file, SECTOR_SIZE, SECTOR_SIZE, data));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_write(&file, SECTOR_SIZE, SECTOR_SIZE, data));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_read(&file, SECTOR_SIZE, SECTOR_SIZE, read_back));
+        ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
+
+        // the data reaches the file itself, not only the handle
+        memset(read_back, 0, sizeof(read_back));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_read(TEST_FILE, SECTOR_SIZE, SECTOR_SIZE, read_back));
+        ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
+
+        memset(read_back, 0xFF, sizeof(read_back));
+        ASSERT_FALSE(ssd_file_is_program_compatible(&file, SECTOR_SIZE, SECTOR_SIZE, read_back));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_erase(&file, SECTOR_SIZE, SECTOR_SIZE));
+        ASSERT_TRUE(ssd_file_is_program_compatible(&file, SECTOR_SIZE, SECTOR_SIZE, read_back));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_read(&file, SECTOR_SIZE, SECTOR_SIZE, data));
+        ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
+
+        ssd_close(&file);
+        ASSERT_FALSE(file.is_open);
+    }
+
+    TEST_P(SsdFileHandleTest, OutOfBoundsShouldFailTest) {
+        ssd_file file;
+        unsigned char buf[SECTOR_SIZE] = {0};
+
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_open(&file, TEST_FILE, GetParam()));
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_file_write(&file, 4096, SECTOR_SIZE, buf));
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_file_read(&file, 4096 - 1, SECTOR_SIZE, buf));
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_file_erase(&file, 5000, SECTOR_SIZE));
+        ssd_close(&file);
+    }
+
+    TEST_P(SsdFileHandleTest, ClosedHandleShouldFailTest) {
+        ssd_file file;
+        unsigned char buf[SECTOR_SIZE] = {0};
+
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_open(&file, "missing_flash.img", GetParam()));
+        ASSERT_FALSE(file.is_open);
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_file_read(&file, 0, SECTOR_SIZE, buf));
+        ASSERT_EQ(SSD_FILE_OPS_ERROR, ssd_file_write(&file, 0, SECTOR_SIZE, buf));
+        ASSERT_FALSE(ssd_file_is_program_compatible(&file, 0, SECTOR_SIZE, buf));
+    }
+
+    TEST_P(SsdFileHandleTest, ProgramCompatibleEveryPositionTest) {
+        ssd_file file;
+        unsigned char data[SECTOR_SIZE];
+
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_open(&file, TEST_FILE, GetParam()));
+        memset(data, 0xA5, SECTOR_SIZE);
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_write(&file, 0, SECTOR_SIZE, data));
+
+        // a single bit flipped from 0 to 1 is found wherever it is, in the vector body or in the tail
+        for (size_t length = 1; length <= SECTOR_SIZE; length += 37) {
+            ASSERT_TRUE(ssd_file_is_program_compatible(&file, 0, length, data));
+            for (size_t i = 0; i < length; i++) {
+                data[i] = 0xA7;
+                ASSERT_FALSE(ssd_file_is_program_compatible(&file, 0, length, data)) << "length " << length << " index " << i;
+                data[i] = 0xA5;
+            }
+        }
+        ssd_close(&file);
+    }
+
+    TEST_P(SsdFileHandleTest, ProgramInPlaceTest) {
+        ssd_file file;
+        unsigned char data[SECTOR_SIZE];
+        unsigned char read_back[SECTOR_SIZE];
+
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_open(&file, TEST_FILE, GetParam()));
+        memset(data, 0x0F, SECTOR_SIZE);
+        ASSERT_TRUE(ssd_file_program_in_place(&file, 0, SECTOR_SIZE, data));
+
+        // an incompatible write leaves the content as it was
+        memset(data, 0x0F, SECTOR_SIZE);
+        data[SECTOR_SIZE - 1] = 0xF0;
+        ASSERT_FALSE(ssd_file_program_in_place(&file, 0, SECTOR_SIZE, data));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_read(&file, 0, SECTOR_SIZE, read_back));
+        memset(data, 0x0F, SECTOR_SIZE);
+        ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
+
+        memset(data, 0x05, SECTOR_SIZE);
+        ASSERT_TRUE(ssd_file_program_in_place(&file, 0, SECTOR_SIZE, data));
+        ASSERT_EQ(SSD_FILE_OPS_SUCCESS, ssd_file_read(&file, 0, SECTOR_SIZE, read_back));
+        ASSERT_EQ(memcmp(data, read_back, SECTOR_SIZE), 0);
+        ssd_close(&file);
+    }
+
+    INSTANTIATE_TEST_CASE_P(FileMode, SsdFileHandleTest, ::testing::Values(SSD_FILE_PREAD, SSD_FILE_MMAP));
 };